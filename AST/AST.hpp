@@ -1,10 +1,12 @@
 #pragma once
 
+#include "Symbol.h"
 #include "constexpr_map.hpp"
 #include "utility.hpp"
 #include "variant_magic.hpp"
 
 #include <cassert>
+#include <cstdlib>
 #include <memory>
 #include <string>
 #include <utility>
@@ -75,6 +77,7 @@ constexpr auto check_map = []() { // magic: compile-time check
 } // namespace static_check
 
 // ------------------------------ AST Nodes --------------------------------
+// nodes refer to their children by plain pointers, all of them are owned by an `ASTArena`
 
 /// Forward Declaration
 struct Expr; // generic node
@@ -82,7 +85,7 @@ struct Expr; // generic node
 // dummy null expr node
 struct Null {};
 
-using CompoundExpr = std::vector<std::shared_ptr<Expr>>;
+using CompoundExpr = std::vector<Expr *>;
 
 struct ConstVar : public std::variant<bool, char, int, float, double, std::string> {
     using Base = std::variant<bool, char, int, float, double, std::string>;
@@ -103,43 +106,68 @@ struct ConstVar : public std::variant<bool, char, int, float, double, std::strin
     }
 };
 
-using NameRef = std::string;
+/// value of the text of a `Constant` token
+inline ConstVar parseConstant(std::string const &const_text) {
+    if (const_text.front() == '\'') {
+        if (const_text[1] != '\\') { // non-escape
+            return ConstVar{const_text[1]};
+        } else { // escapes
+            char hint = const_text[2];
+            if (hint == 'n') {
+                return ConstVar{'\n'};
+            } else if (hint == 't') {
+                return ConstVar{'\t'};
+            } else if (hint == '\\') {
+                return ConstVar{'\\'};
+            } else {
+                throw_err("Unsupported escape sequence '\\{}'!", hint);
+            }
+        }
+    } else if (const_text.find('.') == std::string::npos) {
+        return ConstVar{atoi(const_text.c_str())};
+    } else {
+        return ConstVar{atof(const_text.c_str())};
+    }
+}
+
+// names and type names are interned, compared by id
+using NameRef = Symbol;
 
 struct Variable {
-    std::string m_var_type;
+    Symbol m_var_type;
     enum StorageSpec m_storage;
     NameRef m_var_name;
-    std::shared_ptr<Expr> m_var_init; // ConstVar
+    Expr *m_var_init = nullptr; // ConstVar
     // int m_array_size;   // if variable is not array, then size = 0
 };
 
-struct InitExpr : public std::vector<std::shared_ptr<Expr>> {
+struct InitExpr : public std::vector<Expr *> {
     // vector of Variables
-    using Base = std::vector<std::shared_ptr<Expr>>;
+    using Base = std::vector<Expr *>;
     using Base::Base;
     using Base::operator=;
 };
 
 struct Unary {
-    std::shared_ptr<Expr> m_operand;
+    Expr *m_operand = nullptr;
     enum Operators m_operator;
 };
 
 struct Binary {
-    std::shared_ptr<Expr> m_operand1;
-    std::shared_ptr<Expr> m_operand2;
+    Expr *m_operand1 = nullptr;
+    Expr *m_operand2 = nullptr;
     enum Operators m_operator;
 };
 
 struct IfElse {
-    std::shared_ptr<Expr> m_condi;
-    std::shared_ptr<Expr> m_if;
-    std::shared_ptr<Expr> m_else;
+    Expr *m_condi = nullptr;
+    Expr *m_if = nullptr;
+    Expr *m_else = nullptr;
 };
 
 struct WhileLoop {
-    std::shared_ptr<Expr> m_condi;
-    std::shared_ptr<Expr> m_loop_body;
+    Expr *m_condi = nullptr;
+    Expr *m_loop_body = nullptr;
 };
 
 struct Break {};
@@ -154,34 +182,34 @@ struct Continue {};
  *
  */
 struct ForLoop {
-    std::shared_ptr<Expr> m_init;      // init
-    std::shared_ptr<Expr> m_condi;     // condition
-    std::shared_ptr<Expr> m_iter;      // iter
-    std::shared_ptr<Expr> m_loop_body; // loop body
+    Expr *m_init = nullptr;      // init
+    Expr *m_condi = nullptr;     // condition
+    Expr *m_iter = nullptr;      // iter
+    Expr *m_loop_body = nullptr; // loop body
 };
 
 struct Return {
-    std::shared_ptr<Expr> m_expr;
+    Expr *m_expr = nullptr;
 };
 
 struct FuncCall {
-    std::vector<std::shared_ptr<Expr>> m_para_list;
+    std::vector<Expr *> m_para_list;
     NameRef m_func_name;
 };
 
 struct FuncProto {
     enum StorageSpec m_storage;
     NameRef m_name;
-    std::vector<std::shared_ptr<Expr>> m_para_list; // should put `Variable` here
-    std::string m_return_type;
+    std::vector<Expr *> m_para_list; // should put `Variable` here
+    Symbol m_return_type;
 
-    [[nodiscard]] std::string_view getName() const { return m_name; }
+    [[nodiscard]] Symbol getName() const { return m_name; }
 };
 
 struct FuncDef {
-    std::shared_ptr<Expr> m_proto;
-    std::shared_ptr<Expr> m_body;
-    [[nodiscard]] std::string_view getName() const;
+    Expr *m_proto = nullptr;
+    Expr *m_body = nullptr;
+    [[nodiscard]] Symbol getName() const;
 };
 
 namespace impl { // Magic Base
@@ -195,9 +223,7 @@ struct Expr : public impl::Base {
     using impl::Base::Base;      // inhert ctors
     using impl::Base::operator=; // inhert
 
-    // force move when copied
-    // NOTE: empty warpper, so &Expr == &Base
-    Expr(Expr const &other) : impl::Base(std::move(*((impl::Base *) &other))) {}
+    // copies are shallow: children are pointers, shared with the original
 
     template <typename T>
     [[nodiscard]] constexpr bool is() const {
@@ -213,10 +239,14 @@ struct Expr : public impl::Base {
     }
 };
 
+/// alternative index of `T` in `Expr`, for flat encodings of nodes
+template <typename T>
+constexpr uint8_t expr_kind = variant_index<T, impl::Base>;
+
 // ------------------- Inline Methods Implementation ---------------------
 
 /// workaround forward declaration of Expr
 
-inline std::string_view FuncDef::getName() const {
+inline Symbol FuncDef::getName() const {
     return m_proto->as<FuncProto>().getName();
 }
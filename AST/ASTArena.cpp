@@ -0,0 +1,24 @@
+#include "ASTArena.h"
+
+#include <algorithm>
+#include <memory>
+#include <new>
+
+ASTArena::~ASTArena() {
+    for (size_t i = 0; i < m_blocks.size(); ++i) {
+        const auto &block = m_blocks[i];
+        std::destroy_n(block.nodes, i + 1 == m_blocks.size() ? m_used : block.capacity);
+        ::operator delete(block.nodes);
+    }
+}
+
+void ASTArena::grow() {
+    // small sources get a small arena, big ones few allocations
+    size_t capacity = m_blocks.empty() ? first_block_nodes
+                                       : std::min(m_capacity * 2, max_block_nodes);
+    auto *nodes = static_cast<Expr *>(::operator new(capacity * sizeof(Expr)));
+    m_blocks.push_back(Block{.nodes = nodes, .capacity = capacity});
+    m_used = 0;
+    m_capacity = capacity;
+    m_bytes += capacity * sizeof(Expr);
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include "AST.hpp"
+
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+/**
+ * Owns the `Expr` nodes of a compilation. Nodes are bump-allocated in blocks of growing size and
+ * refer to each other by plain pointers, so building a tree is a pointer increment per node and
+ * nodes made one after another sit next to each other, as do the statements of a function.
+ *
+ * Everything goes away with the arena: node destructors run block by block (strings and vectors
+ * in the nodes still free their own memory), then the blocks are freed. Nothing is reclaimed
+ * before that, nodes dropped from a tree just stay unused.
+ */
+class ASTArena {
+public:
+    ASTArena() = default;
+    ~ASTArena();
+
+    ASTArena(ASTArena const &) = delete;
+    ASTArena &operator=(ASTArena const &) = delete;
+
+    /// a node holding `node`, which lives as long as the arena
+    template <typename T>
+    Expr *make(T &&node) {
+        if (m_used == m_capacity) grow();
+        Expr *ret = new (m_blocks.back().nodes + m_used) Expr(std::forward<T>(node));
+        ++m_used;
+        ++m_count;
+        return ret;
+    }
+
+    /// nodes made so far
+    [[nodiscard]] size_t nodes() const { return m_count; }
+    /// bytes of blocks allocated for them
+    [[nodiscard]] size_t bytes() const { return m_bytes; }
+    /// allocations made for them, one per block
+    [[nodiscard]] size_t blocks() const { return m_blocks.size(); }
+
+private:
+    static constexpr size_t first_block_nodes = 64;
+    static constexpr size_t max_block_nodes = 4096;
+
+    struct Block {
+        Expr *nodes;
+        size_t capacity;
+    };
+
+    void grow();
+
+    std::vector<Block> m_blocks;
+    size_t m_used = 0;     // nodes made in the last block
+    size_t m_capacity = 0; // of the last block
+    size_t m_count = 0;
+    size_t m_bytes = 0;
+};
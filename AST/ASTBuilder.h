@@ -1,12 +1,13 @@
 #pragma once
 #include "AST.hpp"
+#include "ASTArena.h"
 #include "CParserBaseVisitor.h"
 #include <string>
 using namespace antlrcpp;
 using namespace std;
 
 inline auto expr_cast(std::any any) {
-    return any_cast<shared_ptr<Expr>>(any);
+    return any_cast<Expr *>(any);
 }
 
 class ASTBuilder : public CParserBaseVisitor {
@@ -14,9 +15,9 @@ private:
     using TerminalNode = antlr4::tree::TerminalNode;
     using ParseTreeType = antlr4::tree::ParseTreeType;
 
-    std::pair<std::string, enum StorageSpec>
+    std::pair<Symbol, enum StorageSpec>
     parseDeclSpecs(std::vector<CParser::Decl_specContext *> const &specs) {
-        std::string type;
+        Symbol type;
         enum StorageSpec storage_spec = StorageSpec::NONE;
 
         for (const auto &spec : specs) {
@@ -38,7 +39,7 @@ private:
                 if (!type.empty()) {
                     throw_err("Cannot combine with previous '{}' declaration specifier", type);
                 }
-                type = any_cast<std::string>(visit(spec->type_spec()));
+                type = any_cast<Symbol>(visit(spec->type_spec()));
             } else {
                 // something wrong?
                 assert(false);
@@ -46,45 +47,32 @@ private:
             }
         }
 
-        return make_pair(move(type), storage_spec);
+        return make_pair(type, storage_spec);
     }
 
+    template <typename T>
+    Expr *make(T &&node) {
+        return m_arena.make(std::forward<T>(node));
+    }
+
+    ASTArena &m_arena;
+
 public:
+    /// nodes are made in `arena`
+    explicit ASTBuilder(ASTArena &arena) : m_arena(arena) {}
+
     // Top level declarations, vector of `FuncDef` or `InitExpr`
-    std::vector<std::shared_ptr<Expr>> m_decls;
+    std::vector<Expr *> m_decls;
     bool is_global = true;
 
     std::any visitTerminal(TerminalNode *pTerminal) override {
         assert(TerminalNode::is(pTerminal) && "It's not terminal, why?"); // sanity check
-        string const_text = pTerminal->getText();
-
-        if (const_text.front() == '\'') {
-            if (const_text[1] != '\\') { // non-escape
-                return ConstVar{const_text[1]};
-            } else { // escapes
-                char hint = const_text[2];
-                if (hint == 'n') {
-                    return ConstVar{'\n'};
-                } else if (hint == 't') {
-                    return ConstVar{'\t'};
-                } else if (hint == '\\') {
-                    return ConstVar{'\\'};
-                } else {
-                    throw_err("Unsupported escape sequence '\\{}'!", hint);
-                }
-            }
-        } else if (const_text.find('.') == std::string::npos) {
-            return ConstVar{atoi(const_text.c_str())};
-        } else {
-            return ConstVar{atof(const_text.c_str())};
-        }
-
-        return defaultResult();
+        return parseConstant(pTerminal->getText());
     }
 
     std::any visitVar_decl(CParser::Var_declContext *ctx) override {
         // initial node
-        auto ret = make_shared<Expr>(InitExpr{});
+        auto ret = make(InitExpr{});
         auto &curr_node = ret->as<InitExpr>(); // InitExpr curr_node;
 
         auto &&[type, storage_spec] = parseDeclSpecs(ctx->decl_spec());
@@ -97,17 +85,17 @@ public:
         const auto &simple_var_decls = ctx->simple_var_decl();
 
         for (auto simple_var : simple_var_decls) {
-            auto var = expr_cast(visit(simple_var))->as<Variable>();
-            var.m_var_type = type;
-            var.m_storage = storage_spec;
-            curr_node.push_back(make_shared<Expr>(move(var)));
+            auto *var = expr_cast(visit(simple_var));
+            var->as<Variable>().m_var_type = type;
+            var->as<Variable>().m_storage = storage_spec;
+            curr_node.push_back(var);
         }
 
         if (is_global) {
-            m_decls.push_back(move(ret));
+            m_decls.push_back(ret);
             return {};
         } else {
-            return move(ret);
+            return ret;
         }
     }
 
@@ -129,21 +117,21 @@ public:
 
     std::any visitType_spec(CParser::Type_specContext *ctx) override {
         if (ctx->Char()) {
-            return "char"s;
+            return builtin::Char;
         } else if (ctx->Int()) {
-            return "int"s;
+            return builtin::Int;
         } else if (ctx->Long()) {
-            return "long"s;
+            return Symbol{"long"};
         } else if (ctx->Float()) {
-            return "float"s;
+            return builtin::Float;
         } else if (ctx->Double()) {
-            return "double"s;
+            return builtin::Double;
         } else if (ctx->Short()) {
-            return "short"s;
+            return Symbol{"short"};
         } else if (ctx->Void()) {
-            return "void"s;
+            return builtin::Void;
         } else if (ctx->Identifier()) {
-            return ctx->Identifier()->getText();
+            return Symbol{ctx->Identifier()->getText()};
         } else {
             // error
             assert(false);
@@ -154,24 +142,24 @@ public:
     std::any visitFunc_def(CParser::Func_defContext *ctx) override {
         is_global = false;
 
-        auto ret = make_shared<Expr>(FuncDef{
+        auto ret = make(FuncDef{
             .m_proto = expr_cast(visit(ctx->func_proto())),
             .m_body = expr_cast(visit(ctx->comp_stmt())),
         });
 
         m_decls.push_back(ret);
         is_global = true;
-        return move(ret);
+        return ret;
     }
 
     std::any visitFunc_decl(CParser::Func_declContext *ctx) override {
         auto ret = expr_cast(visit(ctx->func_proto()));
         if (is_global) {
-            m_decls.push_back(move(ret));
+            m_decls.push_back(ret);
             return {};
         }
 
-        return move(ret);
+        return ret;
     }
 
     std::any visitFunc_proto(CParser::Func_protoContext *ctx) override {
@@ -181,55 +169,54 @@ public:
             storage_spec = StorageSpec::EXTERN;
         }
 
-        return make_shared<Expr>(FuncProto{
+        return make(FuncProto{
             .m_storage = storage_spec,
             .m_name = ctx->Identifier()->toString(),
-            .m_para_list = any_cast<std::vector<std::shared_ptr<Expr>>>(visit(ctx->params())),
+            .m_para_list = any_cast<std::vector<Expr *>>(visit(ctx->params())),
             .m_return_type = move(type),
         });
     }
 
     std::any visitParams(CParser::ParamsContext *ctx) override {
-        std::vector<std::shared_ptr<Expr>> ret;
+        std::vector<Expr *> ret;
 
         if (ctx->param_list()) {
-            ret = any_cast<std::vector<std::shared_ptr<Expr>>>(visit(ctx->param_list()));
+            ret = any_cast<std::vector<Expr *>>(visit(ctx->param_list()));
         } else if (ctx->Void()) {
-            ret.emplace_back(
-                make_shared<Expr>(Variable{.m_var_type = "void", .m_var_name = "<void>"}));
+            ret.emplace_back(make(Variable{.m_var_type = builtin::Void, .m_var_name = "<void>"}));
         }
         return ret;
     }
 
     std::any visitParam_list(CParser::Param_listContext *ctx) override {
-        std::vector<std::shared_ptr<Expr>> ret;
+        std::vector<Expr *> ret;
         ret.reserve(ctx->param().size());
         for (const auto &params = ctx->param(); const auto &param : params) {
-            ret.push_back(any_cast<shared_ptr<Expr>>(visit(param)));
+            ret.push_back(expr_cast(visit(param)));
         }
 
         return ret;
     }
 
     std::any visitParam(CParser::ParamContext *ctx) override {
-        return make_shared<Expr>(Variable{
-            .m_var_type = any_cast<std::string>(visit(ctx->type_spec())),
+        return make(Variable{
+            .m_var_type = any_cast<Symbol>(visit(ctx->type_spec())),
             .m_var_name = ctx->Identifier()->toString(),
         });
     }
 
     std::any visitNo_array_decl(CParser::No_array_declContext *ctx) override {
-        return make_shared<Expr>(Variable{
+        return make(Variable{
             .m_var_name = ctx->Identifier()->toString(),
             .m_var_init = ctx->Assign()
-                              ? make_shared<Expr>(any_cast<ConstVar>(visit(ctx->Constant())))
+                              ? make(any_cast<ConstVar>(visit(ctx->Constant())))
                               : nullptr,
         });
     }
 
     std::any visitComp_stmt(CParser::Comp_stmtContext *ctx) override {
         // init node
-        auto ret = make_shared<Expr>(CompoundExpr{});
+        auto ret = make(CompoundExpr{});
         auto &curr_node = ret->as<CompoundExpr>();
 
         for (const auto &stmts = ctx->stmt(); const auto &stmt : stmts) {
@@ -240,7 +227,7 @@ public:
     }
 
     std::any visitSelec_stmt(CParser::Selec_stmtContext *ctx) override {
-        return make_shared<Expr>(IfElse{
+        return make(IfElse{
             .m_condi = expr_cast(visit(ctx->expr())),                         // condition
             .m_if = expr_cast(visit(ctx->stmt(0))),                           // if path
             .m_else = ctx->Else() ? expr_cast(visit(ctx->stmt(1))) : nullptr, // else path
@@ -248,14 +235,14 @@ public:
     }
 
     std::any visitWhile_loop(CParser::While_loopContext *ctx) override {
-        return make_shared<Expr>(WhileLoop{
+        return make(WhileLoop{
             .m_condi = expr_cast(visit(ctx->expr())),
             .m_loop_body = expr_cast(visit(ctx->stmt())),
         });
     }
 
     std::any visitFor_loop(CParser::For_loopContext *ctx) override {
-        auto ret = make_shared<Expr>(ForLoop{});
+        auto ret = make(ForLoop{});
         auto &curr_node = ret->as<ForLoop>();
 
         if (ctx->for_init()) curr_node.m_init = expr_cast(visit(ctx->for_init()));
@@ -270,7 +257,7 @@ public:
     }
 
     std::any visitReturn_stmt(CParser::Return_stmtContext *ctx) override {
-        auto ret = make_shared<Expr>(Return{});
+        auto ret = make(Return{});
         auto &curr_node = ret->as<Return>();
 
         if (ctx->expr() != nullptr) {
@@ -281,7 +268,7 @@ public:
     }
 
     std::any visitAssign_expr(CParser::Assign_exprContext *ctx) override {
-        return make_shared<Expr>(Binary{
+        return make(Binary{
             .m_operand1 = expr_cast(visit(ctx->var())),
             .m_operand2 = expr_cast(visit(ctx->expr())),
             .m_operator = any_cast<enum Operators>(visit(ctx->assign())),
@@ -289,10 +276,10 @@ public:
     }
 
     std::any visitUnary_expr(CParser::Unary_exprContext *ctx) override {
-        if (ctx->oror_expr()) {
-            return visit(ctx->oror_expr());
+        if (ctx->binary_expr()) {
+            return visit(ctx->binary_expr());
         } else {
-            auto ret = make_shared<Expr>(Unary{});
+            auto ret = make(Unary{});
             auto &curr_node = ret->as<Unary>();
 
             curr_node.m_operand = expr_cast(visit(ctx->unary_expr()));
@@ -320,7 +307,7 @@ public:
     }
 
     std::any visitVar(CParser::VarContext *ctx) override {
-        auto ret = make_shared<Expr>(NameRef{});
+        auto ret = make(NameRef{});
         auto &curr_node = ret->as<NameRef>();
 
         curr_node = ctx->Identifier()->getText();
@@ -348,173 +335,45 @@ public:
         return ret;
     }
 
-    std::any visitOror_expr(CParser::Oror_exprContext *ctx) override {
-        if (ctx->oror_expr()) {
-            // has operator
-            auto ret = make_shared<Expr>(Binary{});
-            auto &curr_node = ret->as<Binary>();
-
-            // operator
-            curr_node.m_operator = OrOr;
-            // operand 2
-            curr_node.m_operand2 = expr_cast(visit(ctx->andand_expr()));
-            // operand 1
-            curr_node.m_operand1 = expr_cast(visit(ctx->oror_expr()));
-
-            return ret;
-        } else {
-            return visit(ctx->andand_expr());
-        }
-    }
-
-    std::any visitAndand_expr(CParser::Andand_exprContext *ctx) override {
-        if (ctx->andand_expr()) {
-            // has operator
-            auto ret = make_shared<Expr>(Binary{});
-            auto &curr_node = ret->as<Binary>();
-
-            // operator
-            curr_node.m_operator = AndAnd;
-            // operand 2
-            curr_node.m_operand2 = expr_cast(visit(ctx->equal_expr()));
-            // operand 1
-            curr_node.m_operand1 = expr_cast(visit(ctx->andand_expr()));
-
-            return ret;
-        } else {
-            return visit(ctx->equal_expr());
-        }
-    }
-
-    std::any visitEqual_expr(CParser::Equal_exprContext *ctx) override {
-        if (ctx->equal_expr()) {
-            // has operator
-            auto ret = make_shared<Expr>(Binary{});
-            auto &curr_node = ret->as<Binary>();
-
-            // operator
-            if (ctx->Equal()) {
-                curr_node.m_operator = Equal;
-            } else if (ctx->NotEqual()) {
-                curr_node.m_operator = NotEqual;
-            } else {
-                // error
-                assert(false);
-                unreachable();
-            }
-
-            // operand 2
-            curr_node.m_operand2 = expr_cast(visit(ctx->compare_expr()));
-            // operand 1
-            curr_node.m_operand1 = expr_cast(visit(ctx->equal_expr()));
-
-            return ret;
-        } else {
-            return visit(ctx->compare_expr());
-        }
-    }
-
-    std::any visitCompare_expr(CParser::Compare_exprContext *ctx) override {
-        if (ctx->compare_expr()) {
-            // has operator
-            auto ret = make_shared<Expr>(Binary{});
-            auto &curr_node = ret->as<Binary>();
-
-            // operator
-            curr_node.m_operator = any_cast<enum Operators>(visit(ctx->relop()));
-            // operand 2
-            curr_node.m_operand2 = expr_cast(visit(ctx->add_expr()));
-            // operand 1
-            curr_node.m_operand1 = expr_cast(visit(ctx->compare_expr()));
-
-            return ret;
-        } else {
-            return visit(ctx->add_expr());
-        }
-    }
-
-    std::any visitRelop(CParser::RelopContext *ctx) override {
-        enum Operators ret;
-        if (ctx->Less()) {
-            ret = Less;
-        } else if (ctx->LessEqual()) {
-            ret = LessEqual;
-        } else if (ctx->Greater()) {
-            ret = Greater;
-        } else if (ctx->GreaterEqual()) {
-            ret = GreaterEqual;
-        } else {
+    std::any visitBinary(CParser::BinaryContext *ctx) override {
+        auto ret = make(Binary{});
+        auto &curr_node = ret->as<Binary>();
+
+        // operator
+        switch (ctx->op->getType()) {
+        case CParser::Mul: curr_node.m_operator = Mul; break;
+        case CParser::Div: curr_node.m_operator = Div; break;
+        case CParser::Mod: curr_node.m_operator = Mod; break;
+        case CParser::Plus: curr_node.m_operator = Plus; break;
+        case CParser::Minus: curr_node.m_operator = Minus; break;
+        case CParser::Less: curr_node.m_operator = Less; break;
+        case CParser::LessEqual: curr_node.m_operator = LessEqual; break;
+        case CParser::Greater: curr_node.m_operator = Greater; break;
+        case CParser::GreaterEqual: curr_node.m_operator = GreaterEqual; break;
+        case CParser::Equal: curr_node.m_operator = Equal; break;
+        case CParser::NotEqual: curr_node.m_operator = NotEqual; break;
+        case CParser::AndAnd: curr_node.m_operator = AndAnd; break;
+        case CParser::OrOr: curr_node.m_operator = OrOr; break;
+        default:
             // error
             assert(false);
             unreachable();
         }
+        // operand 2
+        curr_node.m_operand2 = expr_cast(visit(ctx->binary_expr(1)));
+        // operand 1
+        curr_node.m_operand1 = expr_cast(visit(ctx->binary_expr(0)));
 
         return ret;
     }
 
-    std::any visitAdd_expr(CParser::Add_exprContext *ctx) override {
-        if (ctx->add_expr()) {
-            // has operator
-            auto ret = make_shared<Expr>(Binary{});
-            auto &curr_node = ret->as<Binary>();
-
-            // operator
-            if (ctx->Plus()) {
-                curr_node.m_operator = Plus;
-            } else if (ctx->Minus()) {
-                curr_node.m_operator = Minus;
-            } else {
-                // error
-                assert(false);
-                unreachable();
-            }
-            // operand 2
-            curr_node.m_operand2 = expr_cast(visit(ctx->term()));
-            // operand 1
-            curr_node.m_operand1 = expr_cast(visit(ctx->add_expr()));
-
-            return ret;
-        } else {
-            return visit(ctx->term());
-        }
-    }
-
-    std::any visitTerm(CParser::TermContext *ctx) override {
-        if (ctx->term()) {
-            // has operator
-            auto ret = make_shared<Expr>(Binary{});
-            auto &curr_node = ret->as<Binary>();
-
-            // operator
-            if (ctx->Mul()) {
-                curr_node.m_operator = Mul;
-            } else if (ctx->Div()) {
-                curr_node.m_operator = Div;
-            } else if (ctx->Mod()) {
-                curr_node.m_operator = Mod;
-            } else {
-                // error
-                assert(false);
-                unreachable();
-            }
-            // operand 2
-            curr_node.m_operand2 = expr_cast(visit(ctx->factor()));
-            // operand 1
-            curr_node.m_operand1 = expr_cast(visit(ctx->term()));
-
-            return ret;
-        } else {
-            return visit(ctx->factor());
-        }
-    }
-
     std::any visitConst_factor(CParser::Const_factorContext *ctx) override {
         auto const_var = any_cast<ConstVar>(visit(ctx->Constant()));
-        return make_shared<Expr>(const_var);
+        return make(const_var);
     }
 
     std::any visitCall(CParser::CallContext *ctx) override {
-        auto ret = make_shared<Expr>(FuncCall{});
+        auto ret = make(FuncCall{});
         auto &curr_node = ret->as<FuncCall>();
 
         curr_node.m_func_name = ctx->Identifier()->getText();
@@ -532,7 +391,7 @@ public:
         if (auto expr = ctx->expr()) {
             return visit(expr);
         } else {
-            return make_shared<Expr>(Null{});
+            return make(Null{});
         }
     }
 
@@ -546,13 +405,13 @@ public:
     }
 
     std::any visitBreak_stmt(CParser::Break_stmtContext *ctx) override {
-        auto ret = make_shared<Expr>(Break{});
+        auto ret = make(Break{});
         auto &curr_node = ret->as<Break>();
         return ret;
     }
 
     std::any visitContinue_stmt(CParser::Continue_stmtContext *ctx) override {
-        auto ret = make_shared<Expr>(Continue{});
+        auto ret = make(Continue{});
         auto &curr_node = ret->as<Continue>();
         return ret;
     }
@@ -1,160 +1,224 @@
 #include "ASTPrinter.h"
 #include "AST.hpp"
-#include "OptHandler.h"
+#include "GraphRenderer.h"
 #include "utility.hpp"
 #include <algorithm>
 #include <cstring>
 #include <fmt/core.h>
-#include <fmt/os.h>
 
-// Directly print graphviz without python script
+#define print2buf(fmt_str, ...) fmt::format_to(back_inserter(buffer), fmt_str, ##__VA_ARGS__)
+
+using namespace std;
+
+static string dot_escape(string_view label) {
+    string escaped;
+    for (char ch : label) {
+        if (ch == '"' || ch == '\\') escaped += '\\';
+        escaped += ch;
+    }
+    return escaped;
+}
 
-// void ASTPrinter::edge_formatter(const Expr& e) {
+static string const_to_str(ConstVar const &var) {
+    if (var.is<char>()) {
+        auto ch = var.as<char>();
+        if (ch == '\n') return "<NewLine>";
+        if (ch == '\t') return "<Tab>";
+        return string(1, ch);
+    } else if (var.is<int>()) {
+        return fmt::format("{}", var.as<int>());
+    } else if (var.is<float>()) {
+        return fmt::format("{}", var.as<float>());
+    } else if (var.is<double>()) {
+        return fmt::format("{}", var.as<double>());
+    } else if (var.is<string>()) {
+        return fmt::format("\"{}\"", var.as<string>());
+    }
+    return var.as<bool>() ? "true" : "false"; // folded conditions, or from a saved AST
+}
 
-// }
+ASTPrinter::ASTPrinter(Expr const *ast, bool debug_sexpr)
+    : m_ast{span{&ast, 1}}, m_root{m_ast.roots()[0]}, debug_sexpr{debug_sexpr} {}
 
-// void ASTPrinter::gv_formatter() {
-//     fmt::format_to(std::back_inserter(buffer), "digraph {{ ");
-//     edge_formatter(AST);
-//     fmt::format_to(std::back_inserter(buffer), "}}");
-// }
+void ASTPrinter::sexp_fmt(NodeId node) {
+    if (node == CompactAST::no_node) return;
+    const auto &ast = m_ast;
+    auto child = [&](unsigned i) { return ast.child(node, i); };
+    auto children = [&]() {
+        for (auto id : ast.children(node)) sexp_fmt(id);
+    };
+    auto storage = static_cast<StorageSpec>(ast.tag(node));
+    auto op = static_cast<Operators>(ast.tag(node));
 
-#define print2buf(fmt_str, ...) fmt::format_to(back_inserter(buffer), fmt_str, ##__VA_ARGS__)
+    switch (ast.kind(node)) {
+    case expr_kind<ConstVar>: print2buf(" {}", const_to_str(ast.constant(node))); break;
+    case expr_kind<Variable>:
+        assert(!ast.name(node).empty() && "Var with no name OR default empty Expr");
+        print2buf(" (var:{}", ast.name(node));
+        if (storage != StorageSpec::NONE) print2buf(" storage:{}", storage_to_str[storage]);
+        print2buf(" type:{}", ast.type(node));
+        sexp_fmt(child(0));
+        print2buf(")");
+        break;
+    case expr_kind<InitExpr>:
+        print2buf(" (init_expr");
+        children();
+        print2buf(")");
+        break;
+    case expr_kind<Unary>:
+        print2buf(" (unary:{}", op_to_str[op]);
+        sexp_fmt(child(0));
+        print2buf(")");
+        break;
+    case expr_kind<Binary>:
+        print2buf(" (binary:{}", op_to_str[op]);
+        sexp_fmt(child(0));
+        sexp_fmt(child(1));
+        print2buf(")");
+        break;
+    case expr_kind<IfElse>:
+        print2buf(" (if-block");
+        sexp_fmt(child(0));
+        sexp_fmt(child(1));
+        sexp_fmt(child(2));
+        print2buf(")");
+        break;
+    case expr_kind<WhileLoop>:
+        print2buf(" (while");
+        sexp_fmt(child(0));
+        sexp_fmt(child(1));
+        print2buf(")");
+        break;
+    case expr_kind<Return>:
+        print2buf(" (return");
+        if (child(0) == CompactAST::no_node) {
+            print2buf(" [NULL]");
+        } else {
+            sexp_fmt(child(0));
+        }
+        print2buf(")");
+        break;
+    case expr_kind<FuncCall>:
+        print2buf(" (call:{}", ast.name(node));
+        children();
+        print2buf(")");
+        break;
+    case expr_kind<FuncProto>:
+        print2buf(" (proto:{}", ast.name(node));
+        print2buf(" storage:{}", storage_to_str[storage]);
+        print2buf(" ret_type:{}", ast.type(node));
+        children();
+        print2buf(")");
+        break;
+    case expr_kind<FuncDef>:
+        print2buf(" (func:{}", ast.name(child(0)));
+        sexp_fmt(child(0));
+        sexp_fmt(child(1));
+        print2buf(")");
+        break;
+    case expr_kind<NameRef>: print2buf(" name_ref:{}", ast.name(node)); break;
+    case expr_kind<CompoundExpr>:
+        print2buf(" (compound");
+        children();
+        print2buf(")");
+        break;
+    case expr_kind<Break>: print2buf(" [BREAK]"); break;
+    case expr_kind<Continue>: print2buf(" [CONTINUE]"); break;
+    case expr_kind<ForLoop>:
+        print2buf(" (for");
+        for (unsigned i = 0; i < 4; ++i) sexp_fmt(child(i));
+        print2buf(")");
+        break;
+    default: print2buf(" [NULL]"); break;
+    }
+}
 
-using namespace std;
+// inner nodes as `<kind:name>`, attributes and leaves boxed, as the old python script drew them
+size_t ASTPrinter::dot_node(string_view label) {
+    print2buf("{} [label=\"<{}>\" shape=\"none\"]; ", node_count, dot_escape(label));
+    return node_count++;
+}
+
+size_t ASTPrinter::dot_leaf(string_view label) {
+    print2buf("{} [label=\"{}\" shape=\"box\"]; ", node_count, dot_escape(label));
+    return node_count++;
+}
+
+void ASTPrinter::dot_edge(size_t from, size_t to) {
+    print2buf("{} -> {} [arrowhead=\"none\"]; ", from, to);
+}
+
+size_t ASTPrinter::dot_fmt(NodeId node) {
+    const auto &ast = m_ast;
+    auto child = [&](unsigned i) { return ast.child(node, i); };
+    auto edges = [this](size_t id, auto const &children) {
+        for (auto child : children) {
+            if (child != CompactAST::no_node) dot_edge(id, dot_fmt(child));
+        }
+        return id;
+    };
+    auto node_with = [&](string_view label, initializer_list<NodeId> children) {
+        return edges(dot_node(label), children);
+    };
+    auto storage = static_cast<StorageSpec>(ast.tag(node));
+    auto op = static_cast<Operators>(ast.tag(node));
 
-extern OptHandler cli_inputs;
+    switch (ast.kind(node)) {
+    case expr_kind<ConstVar>: return dot_leaf(const_to_str(ast.constant(node)));
+    case expr_kind<Variable>: {
+        assert(!ast.name(node).empty() && "Var with no name OR default empty Expr");
+        auto id = dot_node(fmt::format("var:{}", ast.name(node)));
+        if (storage != StorageSpec::NONE) {
+            dot_edge(id, dot_leaf(fmt::format("storage:{}", storage_to_str[storage])));
+        }
+        dot_edge(id, dot_leaf(fmt::format("type:{}", ast.type(node))));
+        return edges(id, initializer_list<NodeId>{child(0)});
+    }
+    case expr_kind<InitExpr>: return edges(dot_node("init_expr"), ast.children(node));
+    case expr_kind<Unary>: return node_with(fmt::format("unary:{}", op_to_str[op]), {child(0)});
+    case expr_kind<Binary>:
+        return node_with(fmt::format("binary:{}", op_to_str[op]), {child(0), child(1)});
+    case expr_kind<IfElse>: return node_with("if-block", {child(0), child(1), child(2)});
+    case expr_kind<WhileLoop>: return node_with("while", {child(0), child(1)});
+    case expr_kind<Return>: {
+        auto id = dot_node("return");
+        dot_edge(id, child(0) != CompactAST::no_node ? dot_fmt(child(0)) : dot_leaf("[NULL]"));
+        return id;
+    }
+    case expr_kind<FuncCall>:
+        return edges(dot_node(fmt::format("call:{}", ast.name(node))), ast.children(node));
+    case expr_kind<FuncProto>: {
+        auto id = dot_node(fmt::format("proto:{}", ast.name(node)));
+        dot_edge(id, dot_leaf(fmt::format("storage:{}", storage_to_str[storage])));
+        dot_edge(id, dot_leaf(fmt::format("ret_type:{}", ast.type(node))));
+        return edges(id, ast.children(node));
+    }
+    case expr_kind<FuncDef>:
+        return node_with(fmt::format("func:{}", ast.name(child(0))), {child(0), child(1)});
+    case expr_kind<NameRef>: return dot_leaf(fmt::format("name_ref:{}", ast.name(node)));
+    case expr_kind<CompoundExpr>: return edges(dot_node("compound"), ast.children(node));
+    case expr_kind<Break>: return dot_leaf("[BREAK]");
+    case expr_kind<Continue>: return dot_leaf("[CONTINUE]");
+    case expr_kind<ForLoop>: return node_with("for", {child(0), child(1), child(2), child(3)});
+    default: return dot_leaf("[NULL]");
+    }
+}
 
-void ASTPrinter::sexp_fmt(const Expr &e) {
-    match(
-        e,
-        [this](ConstVar const &var) {
-            if (var.is<char>()) {
-                auto ch = var.as<char>();
-                if (ch == '\n') {
-                    print2buf(" <NewLine>");
-                } else if (ch == '\t') {
-                    print2buf(" <Tab>");
-                } else {
-                    print2buf(" {}", var.as<char>());
-                }
-            } else if (var.is<int>()) {
-                print2buf(" {}", var.as<int>());
-            } else if (var.is<float>()) {
-                print2buf(" {}", var.as<float>());
-            } else if (var.is<double>()) {
-                print2buf(" {}", var.as<double>());
-            } else if (var.is<string>()) {
-                print2buf(" \"{}\"", var.as<string>());
-            } else {
-                assert(false && "Unknown type, how?");
-                unreachable();
-            }
-        },
-        [this](Variable const &var) {
-            assert(!var.m_var_name.empty() && "Var with no name OR default empty Expr");
-            print2buf(" (var:{}", var.m_var_name);
-            if (var.m_storage != StorageSpec::NONE) {
-                print2buf(" storage:{}", storage_to_str[var.m_storage]);
-            }
-            print2buf(" type:{}", var.m_var_type);
-            if (var.m_var_init) sexp_fmt(*var.m_var_init);
-            print2buf(")");
-        },
-        [this](InitExpr const &inits) {
-            print2buf(" (init_expr");
-            for (const auto &pVar : inits) {
-                sexp_fmt(*pVar);
-            }
-            print2buf(")");
-        },
-        [this](Unary const &ua) {
-            print2buf(" (unary:{}", op_to_str[ua.m_operator]);
-            sexp_fmt(*ua.m_operand);
-            print2buf(")");
-        },
-        [this](Binary const &bin) {
-            print2buf(" (binary:{}", op_to_str[bin.m_operator]);
-            sexp_fmt(*bin.m_operand1);
-            sexp_fmt(*bin.m_operand2);
-            print2buf(")");
-        },
-        [this](IfElse const &branch) {
-            print2buf(" (if-block");
-            sexp_fmt(*branch.m_condi);
-            sexp_fmt(*branch.m_if);
-            if (branch.m_else) {
-                sexp_fmt(*branch.m_else);
-            }
-            print2buf(")");
-        },
-        [this](WhileLoop const &loop) {
-            print2buf(" (while");
-            sexp_fmt(*loop.m_condi);
-            sexp_fmt(*loop.m_loop_body);
-            print2buf(")");
-        },
-        [this](Return const &ret) {
-            print2buf(" (return");
-            if (ret.m_expr == nullptr) {
-                print2buf(" [NULL]");
-            } else {
-                sexp_fmt(*ret.m_expr);
-            }
-            print2buf(")");
-        },
-        [this](FuncCall const &call) {
-            print2buf(" (call:{}", call.m_func_name);
-            for (const auto &p_para : call.m_para_list) {
-                sexp_fmt(*p_para);
-            }
-            print2buf(")");
-        },
-        [this](FuncProto const &proto) {
-            print2buf(" (proto:{}", proto.m_name);
-            print2buf(" storage:{}", storage_to_str[proto.m_storage]);
-            print2buf(" ret_type:{}", proto.m_return_type);
-            for (const auto &p_para : proto.m_para_list) {
-                sexp_fmt(*p_para);
-            }
-            print2buf(")");
-        },
-        [this](FuncDef const &func) {
-            print2buf(" (func:{}", func.getName());
-            sexp_fmt(*func.m_proto);
-            sexp_fmt(*func.m_body);
-            print2buf(")");
-        },
-        [this](NameRef const &name) { print2buf(" name_ref:{}", name); },
-        [this](CompoundExpr const &comp) {
-            print2buf(" (compound");
-            for (const auto &expr : comp) {
-                sexp_fmt(*expr);
-            }
-            print2buf(")");
-        },
-        [this](Break const &) { print2buf(" [BREAK]"); },
-        [this](Continue const &) { print2buf(" [CONTINUE]"); },
-        [this](ForLoop const &loop) {
-            print2buf(" (for");
-            if (loop.m_init) sexp_fmt(*loop.m_init);
-            if (loop.m_condi) sexp_fmt(*loop.m_condi);
-            if (loop.m_iter) sexp_fmt(*loop.m_iter);
-            sexp_fmt(*loop.m_loop_body);
-            print2buf(")");
-        },
-        [this](Null const &) { print2buf(" [NULL]"); });
+string ASTPrinter::ToDot() {
+    buffer.clear();
+    node_count = 0;
+    print2buf("digraph {{ ");
+    dot_fmt(m_root);
+    print2buf("}}");
+    return fmt::to_string(buffer);
 }
 
-void ASTPrinter::ToPNG(fs::path const &exe_path, fs::path const &filename) {
-    sexp_fmt(*AST);
-    std::string out = fmt::format("echo \"{}\n{}\" | python {}/sexp_to_png.py",
-                                  fmt::to_string(buffer),
-                                  filename.c_str(),
-                                  exe_path.parent_path().c_str());
-    if (cli_inputs.debugSExpr) {
+void ASTPrinter::ToPNG(fs::path const &filename) {
+    if (debug_sexpr) {
+        buffer.clear();
+        sexp_fmt(m_root);
         dbg_print("{}\n", fmt::to_string(buffer));
     }
 
-    system(out.c_str());
-}
\ No newline at end of file
+    GraphRenderer::instance().submit(ToDot(), filename.native() + ".png");
+}
@@ -1,21 +1,40 @@
 #pragma once
 
+#include "CompactAST.h"
+
 #include <filesystem>
 #include <fmt/format.h>
 
 namespace fs = std::filesystem;
 
-struct Expr;
-
+/// draws a tree from its flat form, see `CompactAST`
 class ASTPrinter {
 public:
-    std::shared_ptr<Expr> AST;
-    void ToPNG(fs::path const &exe_path, fs::path const &filename);
-    // void ToPNG(const char *exe_path, const std::string &filename);
+    /// render the tree into `<filename>.png` in the background, see `GraphRenderer`
+    void ToPNG(fs::path const &filename);
+    [[nodiscard]] std::string ToDot();
 
-    ASTPrinter(std::shared_ptr<Expr> ast) : AST{std::move(ast)} {}
+    /// the tree of `root` in `ast`
+    ASTPrinter(CompactAST ast, CompactAST::NodeId root, bool debug_sexpr = false)
+        : m_ast{std::move(ast)}, m_root{root}, debug_sexpr{debug_sexpr} {}
+    /// the tree `ast`, flattened first
+    ASTPrinter(Expr const *ast, bool debug_sexpr = false);
 
 private:
-    void sexp_fmt(const Expr &e);
-    fmt::memory_buffer buffer; // buf for graphviz file output
+    using NodeId = CompactAST::NodeId;
+
+    // nothing for `no_node`
+    void sexp_fmt(NodeId node);
+
+    // graphviz output, returns the id of the node printed for `node`
+    size_t dot_fmt(NodeId node);
+    size_t dot_node(std::string_view label);
+    size_t dot_leaf(std::string_view label);
+    void dot_edge(size_t from, size_t to);
+
+    CompactAST m_ast;
+    NodeId m_root;
+    bool debug_sexpr; // also dump S-expression to stderr
+    fmt::memory_buffer buffer; // buf for S-expression or graphviz output
+    size_t node_count = 0;
 };
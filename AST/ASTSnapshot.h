@@ -0,0 +1,44 @@
+#pragma once
+
+#include "AST.hpp"
+#include "ASTArena.h"
+
+#include <memory>
+#include <utility>
+#include <vector>
+
+/**
+ * A version of the top level declarations of a translation unit that nothing changes anymore, so
+ * any number of threads may read it at once, e.g. `ASTPrinter` next to `IRGenerator`. Copies are
+ * cheap: they share the declarations and keep the arenas of their nodes alive.
+ *
+ * Passes such as `simplifyAST` don't change a snapshot either. They make new nodes for whatever
+ * they change, in an arena of their own, and reuse the rest; `derive` pins both for the result.
+ */
+class ASTSnapshot {
+public:
+    using Arenas = std::vector<std::shared_ptr<ASTArena const>>;
+
+    ASTSnapshot() : ASTSnapshot({}, {}) {}
+    /// `decls`, whose nodes are all in `arenas`
+    ASTSnapshot(std::vector<Expr const *> decls, Arenas arenas)
+        : m_data(std::make_shared<Data const>(Data{std::move(decls), std::move(arenas)})) {}
+
+    /// a new version made of `decls`, whose nodes are in this version or in `arena`
+    [[nodiscard]] ASTSnapshot derive(std::vector<Expr const *> decls,
+                                     std::shared_ptr<ASTArena const> arena) const {
+        auto arenas = m_data->arenas;
+        arenas.push_back(std::move(arena));
+        return {std::move(decls), std::move(arenas)};
+    }
+
+    [[nodiscard]] std::vector<Expr const *> const &decls() const { return m_data->decls; }
+
+private:
+    struct Data {
+        std::vector<Expr const *> decls;
+        Arenas arenas;
+    };
+
+    std::shared_ptr<Data const> m_data;
+};
@@ -0,0 +1,32 @@
+#include "ByteCharStream.h"
+
+using namespace antlr4;
+
+void ByteCharStream::consume() {
+    if (m_pos >= m_data.size()) {
+        throw IllegalStateException("cannot consume EOF");
+    }
+    ++m_pos;
+}
+
+size_t ByteCharStream::LA(ssize_t i) {
+    if (i == 0) return 0; // undefined
+
+    // LA(1) is the current char, LA(-1) the previous one
+    ssize_t pos = static_cast<ssize_t>(m_pos) + (i > 0 ? i - 1 : i);
+    if (pos < 0 || pos >= static_cast<ssize_t>(m_data.size())) return IntStream::EOF;
+    return static_cast<unsigned char>(m_data[pos]);
+}
+
+std::string ByteCharStream::getSourceName() const {
+    return m_source_name.empty() ? IntStream::UNKNOWN_SOURCE_NAME : m_source_name;
+}
+
+std::string ByteCharStream::getText(const misc::Interval &interval) {
+    if (interval.a < 0 || interval.b < interval.a) return {};
+
+    size_t start = interval.a;
+    size_t stop = std::min<size_t>(interval.b, m_data.size() - 1);
+    if (start >= m_data.size()) return {};
+    return std::string(m_data.substr(start, stop - start + 1));
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include "antlr4-runtime.h"
+
+#include <string>
+#include <string_view>
+
+/**
+ * Zero-copy `CharStream` over a byte buffer owned by someone else (e.g. a mmap'd source file).
+ *
+ * `ANTLRInputStream` decodes its whole input into a UTF-32 copy up front; this stream hands bytes
+ * to the lexer as they are instead. Sources are expected to be ASCII, other bytes are passed
+ * through one by one and only ever end up in comments or literals.
+ */
+class ByteCharStream : public antlr4::CharStream {
+public:
+    explicit ByteCharStream(std::string_view data, std::string source_name = "")
+        : m_data(data), m_source_name(std::move(source_name)) {}
+
+    void consume() override;
+    size_t LA(ssize_t i) override;
+    ssize_t mark() override { return -1; } // whole buffer stays available, nothing to mark
+    void release(ssize_t marker) override {}
+    size_t index() override { return m_pos; }
+    void seek(size_t index) override { m_pos = std::min(index, m_data.size()); }
+    size_t size() override { return m_data.size(); }
+    std::string getSourceName() const override;
+
+    std::string getText(const antlr4::misc::Interval &interval) override;
+    std::string toString() const override { return std::string(m_data); }
+
+private:
+    std::string_view m_data;
+    std::string m_source_name;
+    size_t m_pos = 0;
+};
@@ -167,7 +167,7 @@ expr: var assign expr 	# assign_expr
 	| unary_expr	# not_assign_expr // no need to override
 	;
 
-unary_expr: unary_operator unary_expr | oror_expr;
+unary_expr: unary_operator unary_expr | binary_expr;
 
 unary_operator: Not | Plus | Minus;
 
@@ -175,30 +175,19 @@ var: Identifier;
 
 assign: Assign | PlusAssign | MinusAssign | MulAssign | DivAssign | ModAssign;
 
-oror_expr: oror_expr OrOr andand_expr | andand_expr;
-
-andand_expr: andand_expr AndAnd equal_expr | equal_expr;
-
-equal_expr: equal_expr (Equal | NotEqual) compare_expr | compare_expr;
-
-compare_expr: compare_expr relop add_expr | add_expr;
-
-relop:
-	Less
-	| LessEqual
-	| Greater
-	| GreaterEqual
-	;
-
-add_expr: add_expr (Plus | Minus) term | term;
-
-term: term (Mul | Div | Mod) factor | factor;
-
-factor: 
-	LeftParen expr RightParen 	# paren_factor
-	| var 						# var_factor
-	| call 						# call_factor	// no need to override
-	| Constant					# const_factor
+// all binary operators in one left recursive rule, ANTLR turns it into a precedence climbing loop.
+// the alternatives are from the tightest binding to the loosest, all left associative
+binary_expr:
+	binary_expr op = (Mul | Div | Mod) binary_expr								# binary
+	| binary_expr op = (Plus | Minus) binary_expr								# binary
+	| binary_expr op = (Less | LessEqual | Greater | GreaterEqual) binary_expr	# binary
+	| binary_expr op = (Equal | NotEqual) binary_expr							# binary
+	| binary_expr op = AndAnd binary_expr										# binary
+	| binary_expr op = OrOr binary_expr											# binary
+	| LeftParen expr RightParen													# paren_factor
+	| var																		# var_factor
+	| call																		# call_factor	// no need to override
+	| Constant																	# const_factor
 	;
 
 call: Identifier LeftParen args RightParen;
@@ -0,0 +1,597 @@
+#include "CompactAST.h"
+#include "variant_magic.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cassert>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <unordered_map>
+#include <utility>
+
+namespace {
+
+// ------------ File layout -------------------
+//
+// a `Header`, then the arrays in the order of `Section`, each starting at a multiple of
+// `section_alignment` so that a file mapped into memory can be used in place. In the byte order of
+// the host, like PCHs. Names are stored as text and interned when viewed
+
+enum Section {
+    Kinds,
+    Tags,
+    Operands,
+    Lists,
+    Roots,
+    Strings,
+    StringBytes,
+    Names,
+    NameBytes,
+    n_sections,
+};
+
+constexpr std::array<char, 8> ast_magic{'t', 'i', 'n', 'y', 'a', 's', 't', '\0'};
+constexpr uint32_t ast_version = 1;
+constexpr size_t section_alignment = 8;
+
+// the numbering of kinds, tags and operands is part of the format
+static_assert(std::variant_size_v<impl::Base> == 17 && std::variant_size_v<ConstVar::Base> == 6 &&
+                  enum_op_count == 22 && enum_storage_count == 4,
+              "nodes changed, bump `ast_version`");
+
+struct Header {
+    std::array<char, 8> magic;
+    uint32_t version;
+    std::array<uint32_t, n_sections> counts; // records in each section
+};
+
+constexpr std::array<size_t, n_sections> record_size{
+    1,                    // kind
+    1,                    // tag
+    4 * sizeof(uint32_t), // operands
+    sizeof(uint32_t),     // node
+    sizeof(uint32_t),     // node
+    2 * sizeof(uint32_t), // offset and size in `StringBytes`
+    1,
+    2 * sizeof(uint32_t), // offset and size in `NameBytes`
+    1,
+};
+
+constexpr size_t alignUp(size_t offset) {
+    return (offset + section_alignment - 1) / section_alignment * section_alignment;
+}
+
+/// where the sections of a file with `header` are
+struct Layout {
+    explicit Layout(Header const &header) : counts(header.counts) {
+        size_t offset = sizeof(Header);
+        for (int section = 0; section < n_sections; ++section) {
+            offsets[section] = offset = alignUp(offset);
+            offset += size_t{counts[section]} * record_size[section];
+        }
+        offsets[n_sections] = offset;
+    }
+
+    /// the records of `section` in `bytes`, in place
+    template <typename T>
+    std::span<const T> records(std::string_view bytes, Section section) const {
+        assert(sizeof(T) == record_size[section]);
+        return {reinterpret_cast<const T *>(bytes.data() + offsets[section]), counts[section]};
+    }
+
+    /// the bytes of `section` in `bytes`
+    std::string_view text(std::string_view bytes, Section section) const {
+        return bytes.substr(offsets[section], counts[section]);
+    }
+
+    std::array<uint32_t, n_sections> counts;
+    std::array<size_t, n_sections + 1> offsets; // and the end of the last section
+};
+
+} // namespace
+
+// ------------ Building -------------------
+
+struct CompactAST::Storage {
+    std::vector<uint8_t> kinds;
+    std::vector<uint8_t> tags;
+    std::vector<NodeOperands> operands;
+    std::vector<NodeId> lists;
+    std::vector<NodeId> roots;
+    std::vector<StringRecord> strings;
+    std::string string_bytes;
+    std::vector<Symbol> symbols;
+    std::vector<uint64_t> file; // a copy of the bytes given to `view`, if they were misaligned
+};
+
+namespace {
+
+/// the value of a `ConstVar` node, `text` is its string if it has one
+ConstVar decodeConstant(uint8_t tag, CompactAST::NodeOperands const &operands,
+                        std::string_view text) {
+    switch (tag) {
+    case variant_index<bool, ConstVar::Base>: return ConstVar{operands[0] != 0};
+    case variant_index<char, ConstVar::Base>: return ConstVar{static_cast<char>(operands[0])};
+    case variant_index<int, ConstVar::Base>: return ConstVar{static_cast<int>(operands[0])};
+    case variant_index<float, ConstVar::Base>:
+        return ConstVar{std::bit_cast<float>(operands[0])};
+    case variant_index<double, ConstVar::Base>:
+        return ConstVar{std::bit_cast<double>(uint64_t{operands[1]} << 32 | operands[0])};
+    default: return ConstVar{std::string{text}};
+    }
+}
+
+} // namespace
+
+CompactAST::CompactAST(std::shared_ptr<Storage const> storage)
+    : m_storage(std::move(storage)), m_kinds(m_storage->kinds), m_tags(m_storage->tags),
+      m_operands(m_storage->operands), m_lists(m_storage->lists), m_roots(m_storage->roots),
+      m_strings(m_storage->strings), m_string_bytes(m_storage->string_bytes),
+      m_symbols(m_storage->symbols) {}
+
+CompactAST::Builder::Builder() : m_storage(std::make_shared<Storage>()) {}
+
+CompactAST::Builder::Builder(CompactAST const &base) : Builder() {
+    m_storage->kinds.reserve(base.size());
+    m_storage->tags.reserve(base.size());
+    m_storage->operands.reserve(base.size());
+    m_storage->lists.reserve(base.m_lists.size());
+    m_storage->symbols.assign(base.m_symbols.begin(), base.m_symbols.end());
+    for (uint32_t i = 0; i < base.m_symbols.size(); ++i) {
+        m_names.try_emplace(base.m_symbols[i].id(), i);
+    }
+    m_storage->strings.assign(base.m_strings.begin(), base.m_strings.end());
+    m_storage->string_bytes = base.m_string_bytes;
+    for (uint32_t i = 0; i < base.m_strings.size(); ++i) {
+        m_strings.try_emplace(std::string{base.string(i)}, i);
+    }
+}
+
+CompactAST::NodeId CompactAST::Builder::add(uint8_t kind, uint8_t tag,
+                                            NodeOperands const &operands) {
+    m_storage->kinds.push_back(kind);
+    m_storage->tags.push_back(tag);
+    m_storage->operands.push_back(operands);
+    return m_storage->operands.size() - 1;
+}
+
+CompactAST::NodeId CompactAST::Builder::add(ConstVar const &value) {
+    NodeOperands operands = no_operands;
+    if (value.is<std::string>()) {
+        operands[2] = string(value.as<std::string>());
+    } else if (value.is<double>()) {
+        auto bits = std::bit_cast<uint64_t>(value.as<double>());
+        operands[0] = bits;
+        operands[1] = bits >> 32;
+    } else if (value.is<float>()) {
+        operands[0] = std::bit_cast<uint32_t>(value.as<float>());
+    } else if (value.is<int>()) {
+        operands[0] = value.as<int>();
+    } else if (value.is<char>()) {
+        operands[0] = static_cast<unsigned char>(value.as<char>());
+    } else {
+        operands[0] = value.as<bool>();
+    }
+    return add(expr_kind<ConstVar>, value.index(), operands);
+}
+
+uint32_t CompactAST::Builder::list(std::span<const NodeId> nodes) {
+    auto &lists = m_storage->lists;
+    uint32_t begin = lists.size();
+    lists.insert(lists.end(), nodes.begin(), nodes.end());
+    return begin;
+}
+
+uint32_t CompactAST::Builder::name(Symbol symbol) {
+    auto [it, inserted] = m_names.try_emplace(symbol.id(), m_storage->symbols.size());
+    if (inserted) m_storage->symbols.push_back(symbol);
+    return it->second;
+}
+
+uint32_t CompactAST::Builder::string(std::string_view text) {
+    auto [it, inserted] = m_strings.try_emplace(std::string{text}, m_storage->strings.size());
+    if (inserted) {
+        m_storage->strings.push_back({static_cast<uint32_t>(m_storage->string_bytes.size()),
+                                      static_cast<uint32_t>(text.size())});
+        m_storage->string_bytes += text;
+    }
+    return it->second;
+}
+
+void CompactAST::Builder::root(NodeId node) { m_storage->roots.push_back(node); }
+
+uint8_t CompactAST::Builder::kind(NodeId node) const { return m_storage->kinds[node]; }
+
+ConstVar CompactAST::Builder::constant(NodeId node) const {
+    assert(is<ConstVar>(node));
+    const auto &operands = m_storage->operands[node];
+    std::string_view text;
+    if (m_storage->tags[node] == variant_index<std::string, ConstVar::Base>) {
+        auto [offset, length] = m_storage->strings[operands[2]];
+        text = std::string_view{m_storage->string_bytes}.substr(offset, length);
+    }
+    return decodeConstant(m_storage->tags[node], operands, text);
+}
+
+CompactAST::Builder::Mark CompactAST::Builder::mark() const {
+    return {.nodes = m_storage->kinds.size(), .lists = m_storage->lists.size()};
+}
+
+void CompactAST::Builder::rollback(Mark mark) {
+    m_storage->kinds.resize(mark.nodes);
+    m_storage->tags.resize(mark.nodes);
+    m_storage->operands.resize(mark.nodes);
+    m_storage->lists.resize(mark.lists);
+}
+
+CompactAST CompactAST::Builder::finish() {
+    CompactAST ast{std::exchange(m_storage, std::make_shared<Storage>())};
+    m_strings.clear();
+    m_names.clear();
+    return ast;
+}
+
+// ------------ Flattening -------------------
+
+class CompactAST::Flattener {
+public:
+    NodeId flatten(Expr const *expr);
+
+    Builder m_out;
+
+private:
+    uint32_t flattenList(std::vector<Expr *> const &exprs);
+};
+
+CompactAST::CompactAST(std::span<Expr const *const> trees) {
+    Flattener flattener;
+    for (const auto *tree : trees) flattener.m_out.root(flattener.flatten(tree));
+    *this = flattener.m_out.finish();
+}
+
+CompactAST::NodeId CompactAST::Flattener::flatten(Expr const *expr) {
+    if (!expr) return no_node;
+    if (expr->is<ConstVar>()) return m_out.add(expr->as<ConstVar>());
+
+    uint8_t tag = 0;
+    NodeOperands operands = no_operands;
+    auto list = [&](std::vector<Expr *> const &exprs) {
+        operands[0] = flattenList(exprs);
+        operands[1] = exprs.size();
+    };
+    match(
+        *expr,
+        [&](Variable const &var) {
+            tag = var.m_storage;
+            operands[0] = flatten(var.m_var_init);
+            operands[2] = m_out.name(var.m_var_name);
+            operands[3] = m_out.name(var.m_var_type);
+        },
+        [&](InitExpr const &vars) { list(vars); },
+        [&](Unary const &unary) {
+            tag = unary.m_operator;
+            operands[0] = flatten(unary.m_operand);
+        },
+        [&](Binary const &binary) {
+            tag = binary.m_operator;
+            operands[0] = flatten(binary.m_operand1);
+            operands[1] = flatten(binary.m_operand2);
+        },
+        [&](IfElse const &if_else) {
+            operands[0] = flatten(if_else.m_condi);
+            operands[1] = flatten(if_else.m_if);
+            operands[2] = flatten(if_else.m_else);
+        },
+        [&](WhileLoop const &loop) {
+            operands[0] = flatten(loop.m_condi);
+            operands[1] = flatten(loop.m_loop_body);
+        },
+        [&](Return const &ret) { operands[0] = flatten(ret.m_expr); },
+        [&](FuncCall const &call) {
+            list(call.m_para_list);
+            operands[2] = m_out.name(call.m_func_name);
+        },
+        [&](FuncProto const &proto) {
+            tag = proto.m_storage;
+            list(proto.m_para_list);
+            operands[2] = m_out.name(proto.m_name);
+            operands[3] = m_out.name(proto.m_return_type);
+        },
+        [&](FuncDef const &def) {
+            operands[0] = flatten(def.m_proto);
+            operands[1] = flatten(def.m_body);
+        },
+        [&](CompoundExpr const &exprs) { list(exprs); },
+        [&](NameRef const &ref) { operands[2] = m_out.name(ref); },
+        [&](ForLoop const &loop) {
+            operands[0] = flatten(loop.m_init);
+            operands[1] = flatten(loop.m_condi);
+            operands[2] = flatten(loop.m_iter);
+            operands[3] = flatten(loop.m_loop_body);
+        },
+        [](auto const &) {}); // `Continue`, `Break` and `Null` have nothing but their kind
+
+    return m_out.add(expr->index(), tag, operands);
+}
+
+uint32_t CompactAST::Flattener::flattenList(std::vector<Expr *> const &exprs) {
+    // children are flattened before the list, which must be contiguous
+    std::vector<NodeId> nodes;
+    nodes.reserve(exprs.size());
+    for (const auto *expr : exprs) nodes.push_back(flatten(expr));
+    return m_out.list(nodes);
+}
+
+// ------------ Saving and viewing -------------------
+
+std::string CompactAST::serialize() const {
+    std::string name_bytes;
+    std::vector<StringRecord> names;
+    names.reserve(m_symbols.size());
+    for (auto symbol : m_symbols) {
+        names.push_back({static_cast<uint32_t>(name_bytes.size()),
+                         static_cast<uint32_t>(symbol.str().size())});
+        name_bytes += symbol.str();
+    }
+
+    Header header{.magic = ast_magic, .version = ast_version, .counts{}};
+    header.counts[Kinds] = m_kinds.size();
+    header.counts[Tags] = m_tags.size();
+    header.counts[Operands] = m_operands.size();
+    header.counts[Lists] = m_lists.size();
+    header.counts[Roots] = m_roots.size();
+    header.counts[Strings] = m_strings.size();
+    header.counts[StringBytes] = m_string_bytes.size();
+    header.counts[Names] = names.size();
+    header.counts[NameBytes] = name_bytes.size();
+    Layout layout{header};
+
+    std::string out(layout.offsets[n_sections], '\0');
+    auto section = [&](Section index, auto const &records) {
+        std::memcpy(out.data() + layout.offsets[index], records.data(),
+                    records.size() * sizeof(records[0]));
+    };
+    std::memcpy(out.data(), &header, sizeof(header));
+    section(Kinds, m_kinds);
+    section(Tags, m_tags);
+    section(Operands, m_operands);
+    section(Lists, m_lists);
+    section(Roots, m_roots);
+    section(Strings, m_strings);
+    section(StringBytes, m_string_bytes);
+    section(Names, names);
+    section(NameBytes, name_bytes);
+    return out;
+}
+
+void CompactAST::save(std::string const &path) const {
+    auto bytes = serialize();
+    // written aside and renamed, so that compilations reading the old file never see half of it
+    std::string tmp_path = path + ".tmp";
+    {
+        std::ofstream out{tmp_path, std::ios_base::binary | std::ios_base::trunc};
+        out.write(bytes.data(), static_cast<std::streamsize>(bytes.size()));
+        if (!out) throw_err<std::runtime_error>("cannot write '{}'", tmp_path);
+    }
+    std::filesystem::rename(tmp_path, path);
+}
+
+CompactAST CompactAST::view(std::string_view bytes, std::string_view name) {
+    Header header;
+    if (bytes.size() < sizeof(header)) {
+        throw_err<std::runtime_error>("'{}' is not a saved AST", name);
+    }
+    std::memcpy(&header, bytes.data(), sizeof(header));
+    if (header.magic != ast_magic) throw_err<std::runtime_error>("'{}' is not a saved AST", name);
+    if (header.version != ast_version) {
+        throw_err<std::runtime_error>("AST '{}' was saved by another version of tinycc", name);
+    }
+    Layout layout{header};
+    if (layout.offsets[n_sections] != bytes.size()) {
+        throw_err<std::runtime_error>("corrupt AST '{}'", name);
+    }
+
+    auto storage = std::make_shared<Storage>();
+    if (reinterpret_cast<uintptr_t>(bytes.data()) % section_alignment != 0) {
+        // e.g. from a `std::string`, mapped files are aligned to pages
+        storage->file.resize(bytes.size() / sizeof(uint64_t) + 1);
+        std::memcpy(storage->file.data(), bytes.data(), bytes.size());
+        bytes = {reinterpret_cast<const char *>(storage->file.data()), bytes.size()};
+    }
+
+    CompactAST ast;
+    ast.m_kinds = layout.records<uint8_t>(bytes, Kinds);
+    ast.m_tags = layout.records<uint8_t>(bytes, Tags);
+    ast.m_operands = layout.records<NodeOperands>(bytes, Operands);
+    ast.m_lists = layout.records<NodeId>(bytes, Lists);
+    ast.m_roots = layout.records<NodeId>(bytes, Roots);
+    ast.m_strings = layout.records<StringRecord>(bytes, Strings);
+    ast.m_string_bytes = layout.text(bytes, StringBytes);
+
+    // names are the only per-process part
+    auto names = layout.records<StringRecord>(bytes, Names);
+    std::string_view name_bytes = layout.text(bytes, NameBytes);
+    storage->symbols.reserve(names.size());
+    for (auto [offset, length] : names) {
+        if (offset > name_bytes.size() || length > name_bytes.size() - offset) {
+            throw_err<std::runtime_error>("corrupt AST '{}'", name);
+        }
+        storage->symbols.emplace_back(name_bytes.substr(offset, length));
+    }
+    ast.m_symbols = storage->symbols;
+    ast.m_storage = std::move(storage);
+
+    if (!ast.valid()) throw_err<std::runtime_error>("corrupt AST '{}'", name);
+    return ast;
+}
+
+bool CompactAST::valid() const {
+    if (m_tags.size() != size() || m_operands.size() != size()) return false;
+    for (auto [offset, length] : m_strings) {
+        if (offset > m_string_bytes.size() || length > m_string_bytes.size() - offset) return false;
+    }
+
+    // children come before their parents, so expanding a tree ends, and each is taken by its only
+    // parent or as a root, so it is expanded once. Passes and codegen don't check trees, so the
+    // children they dereference must be there, of the kinds they expect
+    std::vector<uint8_t> taken(size());
+    auto take = [&](NodeId id) { return !std::exchange(taken[id], true); };
+    auto of_kind = [&](NodeId id, int kind) { return kind < 0 || m_kinds[id] == kind; };
+    auto declaration = [&](NodeId id) {
+        return m_kinds[id] == expr_kind<FuncDef> || m_kinds[id] == expr_kind<InitExpr> ||
+               m_kinds[id] == expr_kind<FuncProto>;
+    };
+    for (NodeId node = 0; node < size(); ++node) {
+        const auto &operands = m_operands[node];
+        auto child = [&](unsigned i, int kind = -1) {
+            return operands[i] == no_node ||
+                   (operands[i] < node && take(operands[i]) && of_kind(operands[i], kind));
+        };
+        auto required = [&](unsigned i, int kind = -1) {
+            return operands[i] != no_node && child(i, kind);
+        };
+        auto name = [&](unsigned i) {
+            return operands[i] < m_symbols.size() && !m_symbols[operands[i]].empty();
+        };
+        auto list = [&](int kind = -1) {
+            if (operands[0] > m_lists.size() || operands[1] > m_lists.size() - operands[0]) {
+                return false;
+            }
+            auto first = m_lists.begin() + operands[0];
+            return std::all_of(first, first + operands[1], [&](NodeId id) {
+                return id < node && take(id) && of_kind(id, kind);
+            });
+        };
+        auto tag = m_tags[node];
+        bool assignment = tag >= PlusAssign && tag <= Assign; // of a `Binary`, to a name
+
+        bool ok = false;
+        switch (m_kinds[node]) {
+        case expr_kind<Variable>:
+            ok = tag < enum_storage_count && child(0, expr_kind<ConstVar>) && name(2) && name(3);
+            break;
+        case expr_kind<ConstVar>:
+            ok = tag < std::variant_size_v<ConstVar::Base> &&
+                 (tag != variant_index<std::string, ConstVar::Base> ||
+                  operands[2] < m_strings.size());
+            break;
+        case expr_kind<InitExpr>: ok = list(expr_kind<Variable>); break;
+        case expr_kind<CompoundExpr>: ok = list(); break;
+        case expr_kind<Unary>: ok = tag < enum_op_count && required(0); break;
+        case expr_kind<Binary>:
+            ok = tag < enum_op_count && required(0, assignment ? expr_kind<NameRef> : -1) &&
+                 required(1);
+            break;
+        case expr_kind<IfElse>: ok = required(0) && required(1) && child(2); break;
+        case expr_kind<WhileLoop>: ok = required(0) && required(1); break;
+        case expr_kind<Return>: ok = child(0); break;
+        case expr_kind<FuncCall>: ok = list() && name(2); break;
+        case expr_kind<FuncProto>:
+            ok = tag < enum_storage_count && list(expr_kind<Variable>) && name(2) && name(3);
+            break;
+        case expr_kind<FuncDef>:
+            ok = required(0, expr_kind<FuncProto>) && required(1, expr_kind<CompoundExpr>);
+            break;
+        case expr_kind<NameRef>: ok = name(2); break;
+        case expr_kind<ForLoop>: ok = child(0) && child(1) && child(2) && required(3); break;
+        case expr_kind<Continue>:
+        case expr_kind<Break>:
+        case expr_kind<Null>: ok = true; break;
+        default: break;
+        }
+        if (!ok) return false;
+    }
+    return std::all_of(m_roots.begin(), m_roots.end(), [&](NodeId root) {
+        return root < size() && take(root) && declaration(root);
+    });
+}
+
+// ------------ Reading -------------------
+
+std::string_view CompactAST::string(uint32_t index) const {
+    assert(index < m_strings.size() && "node has no string here");
+    return m_string_bytes.substr(m_strings[index][0], m_strings[index][1]);
+}
+
+size_t CompactAST::bytes() const {
+    return m_kinds.size() + m_tags.size() + m_operands.size_bytes() + m_lists.size_bytes() +
+           m_roots.size_bytes() + m_strings.size_bytes() + m_string_bytes.size() +
+           m_symbols.size_bytes();
+}
+
+ConstVar CompactAST::constant(NodeId node) const {
+    assert(is<ConstVar>(node));
+    const auto &operands = m_operands[node];
+    bool has_text = m_tags[node] == variant_index<std::string, ConstVar::Base>;
+    return decodeConstant(m_tags[node], operands, has_text ? string(operands[2]) : "");
+}
+
+std::vector<Expr *> CompactAST::expand(ASTArena &arena) const {
+    std::vector<Expr *> trees;
+    trees.reserve(m_roots.size());
+    for (auto root : m_roots) trees.push_back(expand(arena, root));
+    return trees;
+}
+
+Expr *CompactAST::expand(ASTArena &arena, NodeId node) const {
+    if (node == no_node) return nullptr;
+
+    auto child = [&](unsigned i) { return expand(arena, m_operands[node][i]); };
+    auto list = [&]() {
+        std::vector<Expr *> exprs;
+        exprs.reserve(m_operands[node][1]);
+        for (auto id : children(node)) exprs.push_back(expand(arena, id));
+        return exprs;
+    };
+    auto op = static_cast<Operators>(m_tags[node]);
+    auto storage = static_cast<StorageSpec>(m_tags[node]);
+
+    switch (m_kinds[node]) {
+    case expr_kind<Variable>:
+        return arena.make(Variable{
+            .m_var_type = type(node),
+            .m_storage = storage,
+            .m_var_name = name(node),
+            .m_var_init = child(0),
+        });
+    case expr_kind<ConstVar>: return arena.make(constant(node));
+    case expr_kind<InitExpr>: {
+        InitExpr vars;
+        vars.Base::operator=(list());
+        return arena.make(std::move(vars));
+    }
+    case expr_kind<Unary>: return arena.make(Unary{.m_operand = child(0), .m_operator = op});
+    case expr_kind<Binary>:
+        return arena.make(Binary{.m_operand1 = child(0), .m_operand2 = child(1), .m_operator = op});
+    case expr_kind<IfElse>:
+        return arena.make(IfElse{.m_condi = child(0), .m_if = child(1), .m_else = child(2)});
+    case expr_kind<WhileLoop>:
+        return arena.make(WhileLoop{.m_condi = child(0), .m_loop_body = child(1)});
+    case expr_kind<Return>: return arena.make(Return{.m_expr = child(0)});
+    case expr_kind<FuncCall>:
+        return arena.make(FuncCall{.m_para_list = list(), .m_func_name = name(node)});
+    case expr_kind<FuncProto>:
+        return arena.make(FuncProto{
+            .m_storage = storage,
+            .m_name = name(node),
+            .m_para_list = list(),
+            .m_return_type = type(node),
+        });
+    case expr_kind<FuncDef>:
+        return arena.make(FuncDef{.m_proto = child(0), .m_body = child(1)});
+    case expr_kind<CompoundExpr>: return arena.make(list());
+    case expr_kind<NameRef>: return arena.make(name(node));
+    case expr_kind<Continue>: return arena.make(Continue{});
+    case expr_kind<Break>: return arena.make(Break{});
+    case expr_kind<ForLoop>:
+        return arena.make(ForLoop{
+            .m_init = child(0),
+            .m_condi = child(1),
+            .m_iter = child(2),
+            .m_loop_body = child(3),
+        });
+    default: return arena.make(Null{});
+    }
+}
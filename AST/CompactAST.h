@@ -0,0 +1,179 @@
+#pragma once
+
+#include "AST.hpp"
+#include "ASTArena.h"
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * The top level declarations of a translation unit in a handful of flat arrays: a node is its
+ * kind, a tag and four 32-bit operands (18 bytes, where an `Expr` takes `sizeof(Expr)`). Nodes
+ * are numbered children first, lists of children are ranges of one shared array, names are
+ * numbered per tree and string constants are stored once, in one buffer.
+ *
+ * It is how `.ast` files and PCHs store trees, `simplifyAST` and `ASTPrinter` work on it as it is;
+ * codegen works on `Expr` trees, which `expand` makes. A `Builder` makes the arrays node by node.
+ *
+ * Operands per kind, a missing child is `no_node`:
+ *
+ * | kind                       | 0                | 1          | 2       | 3           |
+ * |----------------------------|------------------|------------|---------|-------------|
+ * | `Variable`                 | init             |            | name    | type        |
+ * | `ConstVar`                 | low bits         | high bits  | string  |             |
+ * | `InitExpr`, `CompoundExpr` | first child      | children   |         |             |
+ * | `Unary`                    | operand          |            |         |             |
+ * | `Binary`                   | lhs              | rhs        |         |             |
+ * | `IfElse`                   | condition        | then       | else    |             |
+ * | `WhileLoop`                | condition        | body       |         |             |
+ * | `Return`                   | value            |            |         |             |
+ * | `FuncCall`                 | first argument   | arguments  | name    |             |
+ * | `FuncProto`                | first parameter  | parameters | name    | return type |
+ * | `FuncDef`                  | proto            | body       |         |             |
+ * | `NameRef`                  |                  |            | name    |             |
+ * | `ForLoop`                  | init             | condition  | iter    | body        |
+ *
+ * The tag is the `Operators` of a `Unary` or `Binary`, the `StorageSpec` of a `Variable` or
+ * `FuncProto` and the alternative of a `ConstVar`.
+ *
+ * None of this depends on where the arrays are, so `save` writes them to a file as they are and
+ * `view` uses them right from the bytes of the file, e.g. mapped into memory. Precompiled headers
+ * embed the same bytes. Copies share the arrays, which are only read.
+ */
+class CompactAST {
+public:
+    using NodeId = uint32_t;
+    static constexpr NodeId no_node = UINT32_MAX;
+
+    using NodeOperands = std::array<uint32_t, 4>;
+    static constexpr NodeOperands no_operands{no_node, no_node, no_node, no_node};
+
+    class Builder;
+
+    CompactAST() = default;
+    /// flatten `trees`, they are left as they are
+    explicit CompactAST(std::span<Expr const *const> trees);
+
+    /// the arrays as `save` writes them, for `view`
+    [[nodiscard]] std::string serialize() const;
+    /// write the arrays into `path`, for `view`
+    void save(std::string const &path) const;
+    /// the trees saved into `bytes`, which must outlive the result and its copies. Nothing is
+    /// copied but the names, interned once each; the nodes are checked in one pass, down to the
+    /// children and kinds that passes and codegen rely on: a corrupt or foreign file throws.
+    /// `name` is the file, for errors
+    [[nodiscard]] static CompactAST view(std::string_view bytes, std::string_view name);
+
+    /// the trees again, made in `arena`
+    [[nodiscard]] std::vector<Expr *> expand(ASTArena &arena) const;
+    /// the tree of `node`, made in `arena`
+    [[nodiscard]] Expr *expand(ASTArena &arena, NodeId node) const;
+
+    [[nodiscard]] std::span<const NodeId> roots() const { return m_roots; }
+    /// number of nodes
+    [[nodiscard]] size_t size() const { return m_kinds.size(); }
+    /// memory taken by the arrays
+    [[nodiscard]] size_t bytes() const;
+
+    [[nodiscard]] uint8_t kind(NodeId node) const { return m_kinds[node]; }
+    template <typename T>
+    [[nodiscard]] bool is(NodeId node) const {
+        return m_kinds[node] == expr_kind<T>;
+    }
+    [[nodiscard]] uint8_t tag(NodeId node) const { return m_tags[node]; }
+    /// the child in operand `i`, see the table above
+    [[nodiscard]] NodeId child(NodeId node, unsigned i) const { return m_operands[node][i]; }
+    /// children of an `InitExpr` or `CompoundExpr`, arguments of a `FuncCall` and parameters of a
+    /// `FuncProto`
+    [[nodiscard]] std::span<const NodeId> children(NodeId node) const {
+        const auto &operands = m_operands[node];
+        return m_lists.subspan(operands[0], operands[1]);
+    }
+    /// name of a `Variable`, `FuncCall`, `FuncProto` or `NameRef`
+    [[nodiscard]] Symbol name(NodeId node) const { return m_symbols[m_operands[node][2]]; }
+    /// type of a `Variable`, return type of a `FuncProto`
+    [[nodiscard]] Symbol type(NodeId node) const { return m_symbols[m_operands[node][3]]; }
+    /// value of a `ConstVar`
+    [[nodiscard]] ConstVar constant(NodeId node) const;
+
+    /// operands of `node`, see the table above
+    [[nodiscard]] NodeOperands const &operands(NodeId node) const { return m_operands[node]; }
+
+private:
+    using StringRecord = std::array<uint32_t, 2>; // offset and size in `m_string_bytes`
+
+    struct Storage; // arrays that aren't viewed
+    class Flattener;
+
+    explicit CompactAST(std::shared_ptr<Storage const> storage);
+
+    [[nodiscard]] std::string_view string(uint32_t index) const;
+    [[nodiscard]] bool valid() const;
+
+    std::shared_ptr<Storage const> m_storage;
+
+    // views of `m_storage` or the bytes of `view`
+    std::span<const uint8_t> m_kinds;
+    std::span<const uint8_t> m_tags;
+    std::span<const NodeOperands> m_operands;
+    std::span<const NodeId> m_lists; // children of list nodes, contiguous per node
+    std::span<const NodeId> m_roots;
+    std::span<const StringRecord> m_strings;
+    std::string_view m_string_bytes;
+    std::span<const Symbol> m_symbols; // names by their number
+};
+
+/**
+ * Makes a `CompactAST`, children first: `add` a node once its children are added. A pass on the
+ * flat form writes the new version of the trees into one, and rolls back the nodes it folds.
+ */
+class CompactAST::Builder {
+public:
+    Builder();
+    /// starts with the names and strings of `base`, so nodes copied from it keep their operands
+    explicit Builder(CompactAST const &base);
+
+    /// a node of `kind`, see the table of `CompactAST` for `operands`
+    NodeId add(uint8_t kind, uint8_t tag = 0, NodeOperands const &operands = no_operands);
+    /// a `ConstVar` of `value`
+    NodeId add(ConstVar const &value);
+    /// operand 0 of a node with the children `nodes`, which must be added
+    uint32_t list(std::span<const NodeId> nodes);
+    /// operand 2 of a node named `symbol`, or 3 of one typed `symbol`
+    uint32_t name(Symbol symbol);
+    /// operand 2 of a string `ConstVar`, each text is stored once
+    uint32_t string(std::string_view text);
+    /// `node` is the next tree of the result
+    void root(NodeId node);
+
+    [[nodiscard]] uint8_t kind(NodeId node) const;
+    template <typename T>
+    [[nodiscard]] bool is(NodeId node) const {
+        return kind(node) == expr_kind<T>;
+    }
+    /// value of a `ConstVar`
+    [[nodiscard]] ConstVar constant(NodeId node) const;
+
+    /// the nodes and lists added so far
+    struct Mark {
+        size_t nodes;
+        size_t lists;
+    };
+    [[nodiscard]] Mark mark() const;
+    /// drop what was added since `mark`, strings and names are kept
+    void rollback(Mark mark);
+
+    /// the trees given to `root`, the builder is left empty
+    [[nodiscard]] CompactAST finish();
+
+private:
+    std::shared_ptr<Storage> m_storage;
+    std::unordered_map<std::string, uint32_t> m_strings;
+    std::unordered_map<uint32_t, uint32_t> m_names; // by `Symbol::id()`
+};
@@ -0,0 +1,497 @@
+#include "FastLexer.h"
+#include "ByteCharStream.h"
+#include "CLexer.h"
+#include "utility.hpp"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <iostream>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#define TINYCC_LEXER_SIMD
+#endif
+
+using namespace antlr4;
+using antlrcpp::CLexer;
+
+namespace {
+
+// ------------ Vector primitives -------------------
+
+#if defined(__AVX2__)
+using Vec = __m256i;
+constexpr size_t vec_width = 32;
+inline Vec load(const char *p) { return _mm256_loadu_si256(reinterpret_cast<const Vec *>(p)); }
+inline Vec splat(char c) { return _mm256_set1_epi8(c); }
+inline Vec eq(Vec a, Vec b) { return _mm256_cmpeq_epi8(a, b); }
+inline Vec gt(Vec a, Vec b) { return _mm256_cmpgt_epi8(a, b); }
+inline Vec any(Vec a, Vec b) { return _mm256_or_si256(a, b); }
+inline Vec both(Vec a, Vec b) { return _mm256_and_si256(a, b); }
+inline uint32_t bitmask(Vec v) { return static_cast<uint32_t>(_mm256_movemask_epi8(v)); }
+#elif defined(__SSE2__)
+using Vec = __m128i;
+constexpr size_t vec_width = 16;
+inline Vec load(const char *p) { return _mm_loadu_si128(reinterpret_cast<const Vec *>(p)); }
+inline Vec splat(char c) { return _mm_set1_epi8(c); }
+inline Vec eq(Vec a, Vec b) { return _mm_cmpeq_epi8(a, b); }
+inline Vec gt(Vec a, Vec b) { return _mm_cmpgt_epi8(a, b); }
+inline Vec any(Vec a, Vec b) { return _mm_or_si128(a, b); }
+inline Vec both(Vec a, Vec b) { return _mm_and_si128(a, b); }
+inline uint32_t bitmask(Vec v) { return static_cast<uint32_t>(_mm_movemask_epi8(v)); }
+#endif
+
+#ifdef TINYCC_LEXER_SIMD
+constexpr uint32_t full_mask = vec_width == 32 ? ~0u : (1u << vec_width) - 1;
+
+// bytes compare signed, so non-ASCII bytes are negative and never in an ASCII range
+inline Vec inRange(Vec v, char lo, char hi) {
+    return both(gt(v, splat(lo - 1)), gt(splat(hi + 1), v));
+}
+#endif
+
+// ------------ Byte classes -------------------
+// each class tests a single byte, and 16/32 of them at once when built with SIMD
+
+struct LineEnd {
+    static bool match(unsigned char c) { return c == '\n' || c == '\r'; }
+#ifdef TINYCC_LEXER_SIMD
+    static Vec match(Vec v) { return any(eq(v, splat('\n')), eq(v, splat('\r'))); }
+#endif
+};
+
+struct Blank { // Whitespace and Newline, both skipped
+    static bool match(unsigned char c) { return c == ' ' || c == '\t' || c == '\n' || c == '\r'; }
+#ifdef TINYCC_LEXER_SIMD
+    static Vec match(Vec v) {
+        return any(any(eq(v, splat(' ')), eq(v, splat('\t'))), LineEnd::match(v));
+    }
+#endif
+};
+
+struct Digit {
+    static bool match(unsigned char c) { return c >= '0' && c <= '9'; }
+#ifdef TINYCC_LEXER_SIMD
+    static Vec match(Vec v) { return inRange(v, '0', '9'); }
+#endif
+};
+
+struct IdentChar { // IdentifierNondigit | Digit
+    static bool match(unsigned char c) {
+        return Digit::match(c) || c == '_' || ((c | 0x20) >= 'a' && (c | 0x20) <= 'z');
+    }
+#ifdef TINYCC_LEXER_SIMD
+    static Vec match(Vec v) {
+        Vec lower = any(v, splat(0x20));
+        return any(any(inRange(v, '0', '9'), eq(v, splat('_'))), inRange(lower, 'a', 'z'));
+    }
+#endif
+};
+
+struct Star { // candidates for the end of a block comment
+    static bool match(unsigned char c) { return c == '*'; }
+#ifdef TINYCC_LEXER_SIMD
+    static Vec match(Vec v) { return eq(v, splat('*')); }
+#endif
+};
+
+template <char Quote>
+struct LiteralStop { // bytes a character constant or string literal can't simply run over
+    static bool match(unsigned char c) { return c == Quote || c == '\\' || LineEnd::match(c); }
+#ifdef TINYCC_LEXER_SIMD
+    static Vec match(Vec v) {
+        return any(any(eq(v, splat(Quote)), eq(v, splat('\\'))), LineEnd::match(v));
+    }
+#endif
+};
+
+/// first position in [p, end) whose byte is not in `Class`
+template <class Class>
+const char *skipWhile(const char *p, const char *end) {
+#ifdef TINYCC_LEXER_SIMD
+    for (; static_cast<size_t>(end - p) >= vec_width; p += vec_width) {
+        uint32_t miss = ~bitmask(Class::match(load(p))) & full_mask;
+        if (miss) return p + std::countr_zero(miss);
+    }
+#endif
+    while (p != end && Class::match(*p)) ++p;
+    return p;
+}
+
+/// first position in [p, end) whose byte is in `Class`
+template <class Class>
+const char *skipUntil(const char *p, const char *end) {
+#ifdef TINYCC_LEXER_SIMD
+    for (; static_cast<size_t>(end - p) >= vec_width; p += vec_width) {
+        uint32_t hit = bitmask(Class::match(load(p)));
+        if (hit) return p + std::countr_zero(hit);
+    }
+#endif
+    while (p != end && !Class::match(*p)) ++p;
+    return p;
+}
+
+// ------------ Keywords -------------------
+
+struct Keyword {
+    std::string_view text;
+    uint16_t kind;
+};
+
+constexpr std::array keywords{
+    Keyword{"char", CLexer::Char},         Keyword{"double", CLexer::Double},
+    Keyword{"int", CLexer::Int},           Keyword{"long", CLexer::Long},
+    Keyword{"float", CLexer::Float},       Keyword{"short", CLexer::Short},
+    Keyword{"void", CLexer::Void},         Keyword{"struct", CLexer::Struct},
+    Keyword{"break", CLexer::Break},       Keyword{"case", CLexer::Case},
+    Keyword{"continue", CLexer::Continue}, Keyword{"default", CLexer::Default},
+    Keyword{"do", CLexer::Do},             Keyword{"else", CLexer::Else},
+    Keyword{"for", CLexer::For},           Keyword{"if", CLexer::If},
+    Keyword{"return", CLexer::Return},     Keyword{"switch", CLexer::Switch},
+    Keyword{"while", CLexer::While},       Keyword{"sizeof", CLexer::Sizeof},
+    Keyword{"typedef", CLexer::Typedef},   Keyword{"extern", CLexer::Extern},
+    Keyword{"static", CLexer::Static},
+};
+
+constexpr size_t keyword_table_bits = 6;
+constexpr size_t max_keyword_length = 8;
+
+// multiply-shift over the first two bytes, the last byte and the length, `word.size() >= 2`
+constexpr uint32_t keywordHash(std::string_view word, uint32_t seed) {
+    uint32_t key = uint32_t(uint8_t(word[0])) | uint32_t(uint8_t(word[1])) << 8 |
+                   uint32_t(uint8_t(word.back())) << 16 | uint32_t(word.size()) << 24;
+    return (key * seed) >> (32 - keyword_table_bits);
+}
+
+// smallest odd seed that maps all keywords to different slots
+consteval uint32_t keywordSeed() {
+    for (uint32_t seed = 1;; seed += 2) {
+        std::array<bool, 1 << keyword_table_bits> used{};
+        bool collides = false;
+        for (const auto &keyword : keywords) {
+            auto &slot = used[keywordHash(keyword.text, seed)];
+            collides |= slot;
+            slot = true;
+        }
+        if (!collides) return seed;
+    }
+}
+
+constexpr uint32_t keyword_seed = keywordSeed();
+
+constexpr auto keyword_table = [] {
+    std::array<Keyword, 1 << keyword_table_bits> table{};
+    for (const auto &keyword : keywords) table[keywordHash(keyword.text, keyword_seed)] = keyword;
+    return table;
+}();
+
+/// `Identifier` or the keyword `word` spells, keywords win ties as they come first in `CLexer.g4`
+uint16_t identifierKind(std::string_view word) {
+    if (word.size() < 2 || word.size() > max_keyword_length) return CLexer::Identifier;
+    const auto &slot = keyword_table[keywordHash(word, keyword_seed)];
+    return slot.text == word ? slot.kind : uint16_t{CLexer::Identifier};
+}
+
+bool isSimpleEscape(int c) {
+    switch (c) {
+    case '\'': case '"': case '?': case 'a': case 'b': case 'f':
+    case 'n': case 'r': case 't': case 'v': case '\\': return true;
+    default: return false;
+    }
+}
+
+} // namespace
+
+// ------------ Implementation of `FastLexer` -------------------
+
+std::vector<FastToken> FastLexer::lex(size_t from, size_t until) {
+    const char *const begin = m_source.data();
+    const char *const end = begin + m_source.size();
+
+    // next byte, or -1 at EOF
+    auto peek = [end](const char *p) -> int {
+        return p < end ? static_cast<unsigned char>(*p) : -1;
+    };
+
+    std::vector<FastToken> tokens;
+    tokens.reserve((std::min(until, m_source.size()) - from) / 4);
+
+    const char *p = begin + from;
+    while ((p = skipWhile<Blank>(p, end)) != end) {
+        const char *start = p;
+        uint16_t kind = 0; // stays 0 for skipped input
+
+        // like `CLexer`, the text up to and including the byte no rule can continue with is
+        // reported and dropped
+        auto fail = [&](const char *at) {
+            reportError(start, at);
+            p = at < end ? at + 1 : end;
+        };
+        // the longest match is either `single` or, followed by `next`, `twice`
+        auto pick = [&](char next, uint16_t twice, uint16_t single) {
+            bool matched = peek(p + 1) == next;
+            p += matched ? 2 : 1;
+            kind = matched ? twice : single;
+        };
+
+        switch (*p) {
+        case '0': case '1': case '2': case '3': case '4':
+        case '5': case '6': case '7': case '8': case '9':
+            p = skipWhile<Digit>(p + 1, end);
+            if (peek(p) == '.') {
+                p = skipWhile<Digit>(p + 1, end);
+                kind = CLexer::Constant;
+            } else {
+                // "0" is a DecimalConstant, longer runs with leading zeros only match DigitSequence
+                kind = p - start == 1 || *start != '0' ? CLexer::Constant : CLexer::DigitSequence;
+            }
+            break;
+        case '.':
+            if (Digit::match(peek(p + 1))) {
+                p = skipWhile<Digit>(p + 1, end);
+                kind = CLexer::Constant;
+            } else {
+                ++p;
+                kind = CLexer::Dot;
+            }
+            break;
+        case '\'': { // CharacterConstant
+            const char *q = p + 1;
+            while (true) {
+                q = skipUntil<LiteralStop<'\''>>(q, end);
+                if (q == end || LineEnd::match(*q)) break;
+                if (*q == '\'') {
+                    if (q != p + 1) kind = CLexer::Constant; // CCharSequence can't be empty
+                    break;
+                }
+                if (!isSimpleEscape(peek(q + 1))) {
+                    ++q;
+                    break;
+                }
+                q += 2;
+            }
+            if (kind) p = q + 1;
+            else fail(q);
+            break;
+        }
+        case '"': { // StringLiteral
+            const char *q = p + 1;
+            while (true) {
+                q = skipUntil<LiteralStop<'"'>>(q, end);
+                if (q == end || LineEnd::match(*q)) break;
+                if (*q == '"') {
+                    kind = CLexer::StringLiteral;
+                    break;
+                }
+                int escaped = peek(q + 1);
+                if (isSimpleEscape(escaped) || escaped == '\n') {
+                    q += 2;
+                } else if (escaped == '\r') {
+                    if (peek(q + 2) != '\n') {
+                        q += 2;
+                        break;
+                    }
+                    q += 3;
+                } else {
+                    ++q;
+                    break;
+                }
+            }
+            if (kind) p = q + 1;
+            else fail(q);
+            break;
+        }
+        case '#': { // IncludeDirective, skipped
+            auto skipSpaces = [&](const char *q) {
+                while (peek(q) == ' ' || peek(q) == '\t') ++q;
+                return q;
+            };
+            const char *q = skipSpaces(p + 1);
+            constexpr std::string_view include = "include";
+            size_t matched = 0;
+            while (matched < include.size() && peek(q + matched) == include[matched]) ++matched;
+            if (matched < include.size()) {
+                fail(q + matched);
+                break;
+            }
+            q = skipSpaces(q + include.size());
+            int open = peek(q);
+            if (open != '"' && open != '<') {
+                fail(q);
+                break;
+            }
+            // the path runs to the line end, the last non-blank byte before it must close it
+            const char *path = q + 1;
+            const char *eol = skipUntil<LineEnd>(path, end);
+            const char *last = eol;
+            while (last != path && (last[-1] == ' ' || last[-1] == '\t')) --last;
+            if (eol == end || last == path || last[-1] != (open == '"' ? '"' : '>')) {
+                fail(eol);
+                break;
+            }
+            p = eol + (*eol == '\r' && peek(eol + 1) == '\n' ? 2 : 1);
+            break;
+        }
+        case '/':
+            if (peek(p + 1) == '/') { // LineComment
+                p = skipUntil<LineEnd>(p + 2, end);
+            } else if (peek(p + 1) == '*') { // BlockComment
+                const char *q = p + 2;
+                while ((q = skipUntil<Star>(q, end)) != end && peek(q + 1) != '/') ++q;
+                if (q != end) {
+                    p = q + 2;
+                } else { // unterminated, falls back to the longest match: `/`
+                    ++p;
+                    kind = CLexer::Div;
+                }
+            } else {
+                pick('=', CLexer::DivAssign, CLexer::Div);
+            }
+            break;
+        case '<': pick('=', CLexer::LessEqual, CLexer::Less); break;
+        case '>': pick('=', CLexer::GreaterEqual, CLexer::Greater); break;
+        case '+': pick('=', CLexer::PlusAssign, CLexer::Plus); break;
+        case '-': pick('=', CLexer::MinusAssign, CLexer::Minus); break;
+        case '*': pick('=', CLexer::MulAssign, CLexer::Mul); break;
+        case '%': pick('=', CLexer::ModAssign, CLexer::Mod); break;
+        case '!': pick('=', CLexer::NotEqual, CLexer::Not); break;
+        case '=': pick('=', CLexer::Equal, CLexer::Assign); break;
+        case '&':
+            if (peek(p + 1) == '&') pick('&', CLexer::AndAnd, 0);
+            else fail(p + 1);
+            break;
+        case '|':
+            if (peek(p + 1) == '|') pick('|', CLexer::OrOr, 0);
+            else fail(p + 1);
+            break;
+        case '(': ++p, kind = CLexer::LeftParen; break;
+        case ')': ++p, kind = CLexer::RightParen; break;
+        case '[': ++p, kind = CLexer::LeftBracket; break;
+        case ']': ++p, kind = CLexer::RightBracket; break;
+        case '{': ++p, kind = CLexer::LeftBrace; break;
+        case '}': ++p, kind = CLexer::RightBrace; break;
+        case '?': ++p, kind = CLexer::Question; break;
+        case ':': ++p, kind = CLexer::Colon; break;
+        case ';': ++p, kind = CLexer::Semi; break;
+        case ',': ++p, kind = CLexer::Comma; break;
+        default:
+            if (IdentChar::match(*p) && !Digit::match(*p)) {
+                p = skipWhile<IdentChar>(p + 1, end);
+                kind = identifierKind({start, static_cast<size_t>(p - start)});
+            } else {
+                fail(p);
+            }
+        }
+
+        if (kind) {
+            std::string_view text{start, static_cast<size_t>(p - start)};
+            tokens.push_back(FastToken{
+                .offset = static_cast<uint32_t>(start - begin),
+                .length = static_cast<uint32_t>(text.size()),
+                .kind = kind,
+                .symbol = kind == CLexer::Identifier ? Symbol{text} : Symbol{},
+            });
+            if (static_cast<size_t>(start - begin) >= until) break;
+        }
+    }
+    return tokens;
+}
+
+void FastLexer::reportError(const char *start, const char *stop) const {
+    // same message and position as `CLexer` through `ConsoleErrorListener`
+    std::string_view before{m_source.data(), static_cast<size_t>(start - m_source.data())};
+    size_t line = std::count(before.begin(), before.end(), '\n') + 1;
+    size_t line_start = before.rfind('\n');
+    size_t column = line_start == std::string_view::npos ? before.size()
+                                                          : before.size() - line_start - 1;
+
+    std::string text;
+    for (const char *p = start; p <= stop; ++p) {
+        if (p == m_source.data() + m_source.size()) break;
+        switch (*p) {
+        case '\n': text += "\\n"; break;
+        case '\r': text += "\\r"; break;
+        case '\t': text += "\\t"; break;
+        default: text += *p;
+        }
+    }
+    std::cerr << fmt::format("line {}:{} token recognition error at: '{}'\n", line, column, text);
+}
+
+void FastLexer::verify(std::string_view source, std::vector<FastToken> const &tokens,
+                       std::string const &source_name) {
+    ByteCharStream input(source, source_name);
+    CLexer lexer(&input);
+    lexer.removeErrorListeners(); // `lex()` has reported them already
+
+    for (size_t i = 0;; ++i) {
+        auto expected = lexer.nextToken();
+        bool at_eof = expected->getType() == Token::EOF;
+        if (at_eof && i == tokens.size()) return;
+
+        const FastToken *actual = i < tokens.size() ? &tokens[i] : nullptr;
+        if (at_eof || !actual || actual->kind != expected->getType() ||
+            actual->offset != expected->getStartIndex() ||
+            actual->offset + actual->length != expected->getStopIndex() + 1) {
+            auto describe = [&](size_t kind, std::string_view text) {
+                return fmt::format("{} '{}'", lexer.getVocabulary().getSymbolicName(kind), text);
+            };
+            throw_err<std::runtime_error>(
+                "{}:{}:{}: fast lexer gives {} where CLexer gives {}",
+                source_name,
+                expected->getLine(),
+                expected->getCharPositionInLine(),
+                actual ? describe(actual->kind, source.substr(actual->offset, actual->length))
+                       : "<EOF>",
+                at_eof ? "<EOF>" : describe(expected->getType(), expected->getText()));
+        }
+    }
+}
+
+// ------------ Implementation of `FastTokenSource` -------------------
+
+FastTokenSource::FastTokenSource(std::vector<FastToken> tokens, std::string_view source,
+                                 CharStream &input)
+    : m_tokens(std::move(tokens)), m_source(source), m_input(input) {}
+
+std::unique_ptr<Token> FastTokenSource::nextToken() {
+    std::pair<TokenSource *, CharStream *> source{this, &m_input};
+    if (m_next == m_tokens.size()) {
+        advanceTo(m_source.size());
+        return getTokenFactory()->create(source,
+                                         Token::EOF,
+                                         "",
+                                         Token::DEFAULT_CHANNEL,
+                                         m_source.size(),
+                                         m_source.size() - 1,
+                                         m_line,
+                                         m_column);
+    }
+
+    const FastToken &token = m_tokens[m_next++];
+    advanceTo(token.offset);
+    return getTokenFactory()->create(source,
+                                     token.kind,
+                                     "", // taken from `m_input` when asked for
+                                     Token::DEFAULT_CHANNEL,
+                                     token.offset,
+                                     token.offset + token.length - 1,
+                                     m_line,
+                                     m_column);
+}
+
+TokenFactory<CommonToken> *FastTokenSource::getTokenFactory() {
+    return CommonTokenFactory::DEFAULT.get();
+}
+
+void FastTokenSource::advanceTo(size_t offset) {
+    for (; m_offset < offset; ++m_offset) {
+        if (m_source[m_offset] == '\n') {
+            ++m_line;
+            m_column = 0;
+        } else {
+            ++m_column;
+        }
+    }
+}
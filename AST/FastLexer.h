@@ -0,0 +1,75 @@
+#pragma once
+
+#include "Symbol.h"
+#include "antlr4-runtime.h"
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/// a token of `FastLexer`, `kind` is the `CLexer` token type
+struct FastToken {
+    uint32_t offset;
+    uint32_t length;
+    uint16_t kind;
+    Symbol symbol = {}; // of an `Identifier`
+};
+
+/**
+ * Hand-written lexer producing the same tokens as the ANTLR `CLexer` (see `CLexer.g4`), without an
+ * ATN simulation or a heap-allocated token per token.
+ *
+ * Whitespace, comments, identifier and digit runs are scanned 16 (SSE2) or 32 (AVX2, if tinycc is
+ * built with it) bytes at a time, keywords are found through a perfect hash built at compile time.
+ * Characters no rule matches are reported like `CLexer` does and skipped. Identifiers are interned
+ * on the way, so the parser gets their `Symbol` with the token.
+ */
+class FastLexer {
+public:
+    explicit FastLexer(std::string_view source, std::string source_name = "")
+        : m_source(source), m_source_name(std::move(source_name)) {}
+
+    std::vector<FastToken> lex() { return lex(0, m_source.size()); }
+    /// tokens from byte `from` on, which must not be inside a token or comment. Lexing stops after
+    /// the first token starting at or past `until`, so the caller can tell whether it is in sync
+    /// with tokens lexed before
+    std::vector<FastToken> lex(size_t from, size_t until);
+
+    /// lex `source` with `CLexer` too and throw at the first token that differs from `tokens`
+    static void verify(std::string_view source, std::vector<FastToken> const &tokens,
+                       std::string const &source_name);
+
+private:
+    // report `[start, stop]` as `CLexer` would, `stop` is where no rule could go on
+    void reportError(const char *start, const char *stop) const;
+
+    std::string_view m_source;
+    std::string m_source_name;
+};
+
+/// feeds `FastLexer` tokens to an ANTLR parser, `CommonToken`s are only made as the parser asks
+class FastTokenSource : public antlr4::TokenSource {
+public:
+    /// `input` streams `source`
+    FastTokenSource(std::vector<FastToken> tokens, std::string_view source,
+                    antlr4::CharStream &input);
+
+    std::unique_ptr<antlr4::Token> nextToken() override;
+    size_t getLine() const override { return m_line; }
+    size_t getCharPositionInLine() override { return m_column; }
+    antlr4::CharStream *getInputStream() override { return &m_input; }
+    std::string getSourceName() override { return m_input.getSourceName(); }
+    antlr4::TokenFactory<antlr4::CommonToken> *getTokenFactory() override;
+
+private:
+    void advanceTo(size_t offset);
+
+    std::vector<FastToken> m_tokens;
+    std::string_view m_source; // to track lines
+    antlr4::CharStream &m_input;
+    size_t m_next = 0;       // next token to hand out
+    size_t m_offset = 0;     // `m_line` and `m_column` are of this offset
+    size_t m_line = 1;
+    size_t m_column = 0;
+};
@@ -0,0 +1,474 @@
+#include "FastParser.h"
+#include "CLexer.h"
+
+#include <algorithm>
+#include <optional>
+
+using antlrcpp::CLexer;
+using antlr4::Token;
+
+namespace {
+
+struct BinaryOp {
+    enum Operators op;
+    int precedence; // higher binds tighter, all of them are left associative
+};
+
+// the `binary` alternatives of `binary_expr` in `CParser.g4`
+std::optional<BinaryOp> binaryOp(size_t kind) {
+    switch (kind) {
+    case CLexer::OrOr: return BinaryOp{OrOr, 1};
+    case CLexer::AndAnd: return BinaryOp{AndAnd, 2};
+    case CLexer::Equal: return BinaryOp{Equal, 3};
+    case CLexer::NotEqual: return BinaryOp{NotEqual, 3};
+    case CLexer::Less: return BinaryOp{Less, 4};
+    case CLexer::LessEqual: return BinaryOp{LessEqual, 4};
+    case CLexer::Greater: return BinaryOp{Greater, 4};
+    case CLexer::GreaterEqual: return BinaryOp{GreaterEqual, 4};
+    case CLexer::Plus: return BinaryOp{Plus, 5};
+    case CLexer::Minus: return BinaryOp{Minus, 5};
+    case CLexer::Mul: return BinaryOp{Mul, 6};
+    case CLexer::Div: return BinaryOp{Div, 6};
+    case CLexer::Mod: return BinaryOp{Mod, 6};
+    default: return std::nullopt;
+    }
+}
+
+std::optional<enum Operators> assignOp(size_t kind) {
+    switch (kind) {
+    case CLexer::Assign: return Assign;
+    case CLexer::PlusAssign: return PlusAssign;
+    case CLexer::MinusAssign: return MinusAssign;
+    case CLexer::MulAssign: return MulAssign;
+    case CLexer::DivAssign: return DivAssign;
+    case CLexer::ModAssign: return ModAssign;
+    default: return std::nullopt;
+    }
+}
+
+std::optional<enum Operators> unaryOp(size_t kind) {
+    switch (kind) {
+    case CLexer::Not: return Not;
+    case CLexer::Plus: return Plus;
+    case CLexer::Minus: return Minus;
+    default: return std::nullopt;
+    }
+}
+
+std::optional<enum StorageSpec> storageSpec(size_t kind) {
+    switch (kind) {
+    case CLexer::Typedef: return StorageSpec::TYPEDEF;
+    case CLexer::Extern: return StorageSpec::EXTERN;
+    case CLexer::Static: return StorageSpec::STATIC;
+    default: return std::nullopt;
+    }
+}
+
+// `type_spec` but `Identifier`
+bool isTypeKeyword(size_t kind) {
+    switch (kind) {
+    case CLexer::Char:
+    case CLexer::Int:
+    case CLexer::Long:
+    case CLexer::Float:
+    case CLexer::Short:
+    case CLexer::Double:
+    case CLexer::Void:
+    case CLexer::Struct: return true;
+    default: return false;
+    }
+}
+
+} // namespace
+
+// ------------ Lookahead -------------------
+
+size_t FastParser::peek(size_t n) const {
+    if (m_pos + n < m_tokens.size()) return m_tokens[m_pos + n].kind;
+    m_peeked_eof = true;
+    return Token::EOF;
+}
+
+std::string_view FastParser::text(size_t n) const {
+    if (m_pos + n >= m_tokens.size()) return "<EOF>";
+    const auto &token = m_tokens[m_pos + n];
+    return m_source.substr(token.offset, token.length);
+}
+
+Symbol FastParser::symbol(size_t n) const {
+    if (m_pos + n >= m_tokens.size()) return {};
+    return m_tokens[m_pos + n].symbol;
+}
+
+bool FastParser::isDeclSpec(size_t n) const {
+    size_t kind = peek(n);
+    if (storageSpec(kind) || isTypeKeyword(kind)) return true;
+    // a type name is followed by what is declared, or by more specifiers
+    size_t next = peek(n + 1);
+    return kind == CLexer::Identifier &&
+           (next == CLexer::Identifier || storageSpec(next) || isTypeKeyword(next));
+}
+
+bool FastParser::startsVarDecl() const {
+    if (isDeclSpec(0)) return true;
+
+    // `var_decl` without specifiers, e.g. `a = 1, b;`. if it is a single variable, `CParser`
+    // predicts `expr` instead, as it comes first
+    bool has_comma = false;
+    for (size_t n = 0;; ++n) {
+        if (peek(n) != CLexer::Identifier) return false;
+        if (peek(n + 1) == CLexer::Assign && peek(n + 2) == CLexer::Constant) n += 2;
+        if (peek(n + 1) != CLexer::Comma) return has_comma && peek(n + 1) == CLexer::Semi;
+        has_comma = true;
+        ++n;
+    }
+}
+
+bool FastParser::accept(size_t kind) {
+    if (peek() != kind) return false;
+    ++m_pos;
+    return true;
+}
+
+void FastParser::expect(size_t kind, std::string_view what) {
+    if (peek() != kind) error(what);
+    ++m_pos;
+}
+
+void FastParser::error(std::string_view what) const {
+    size_t offset = m_pos < m_tokens.size() ? m_tokens[m_pos].offset : m_source.size();
+    std::string_view before = m_source.substr(0, offset);
+    size_t line = std::count(before.begin(), before.end(), '\n') + 1;
+    size_t line_start = before.rfind('\n');
+    size_t column = line_start == std::string_view::npos ? offset : offset - line_start - 1;
+    throw_err<std::runtime_error>("line {}:{} expected {} at '{}'", line, column, what, text());
+}
+
+// ------------ Declarations -------------------
+
+std::vector<Expr *> FastParser::parse() {
+    std::vector<Expr *> decls;
+    while (m_pos < m_tokens.size()) parseDecl(decls);
+    return decls;
+}
+
+std::vector<Expr *> FastParser::parse(std::vector<DeclSpan> &spans) {
+    std::vector<Expr *> decls;
+    while (m_pos < m_tokens.size()) {
+        size_t begin = m_tokens[m_pos].offset;
+        parseDecl(decls);
+        const auto &last = m_tokens[m_pos - 1];
+        spans.push_back(DeclSpan{.begin = begin, .end = last.offset + last.length});
+    }
+    return decls;
+}
+
+void FastParser::parseDecl(std::vector<Expr *> &decls) {
+    size_t n = 0;
+    while (isDeclSpec(n)) n += peek(n) == CLexer::Struct ? 2 : 1;
+
+    if (peek(n) != CLexer::Identifier || peek(n + 1) != CLexer::LeftParen) {
+        decls.push_back(parseVarDecl(true));
+        expect(CLexer::Semi, "';'");
+        return;
+    }
+
+    auto proto = parseFuncProto();
+    if (accept(CLexer::Semi)) {
+        decls.push_back(proto);
+        return;
+    }
+    if (peek() != CLexer::LeftBrace) error("'{' or ';'");
+
+    decls.push_back(m_arena.make(FuncDef{
+        .m_proto = proto,
+        .m_body = parseCompStmt(),
+    }));
+}
+
+std::pair<Symbol, enum StorageSpec> FastParser::parseDeclSpecs() {
+    Symbol type;
+    enum StorageSpec storage_spec = StorageSpec::NONE;
+
+    while (isDeclSpec(0)) {
+        if (auto temp = storageSpec(peek())) { // same checks as `ASTBuilder::parseDeclSpecs`
+            ++m_pos;
+            if (storage_spec == StorageSpec::NONE) {
+                storage_spec = *temp;
+                continue;
+            }
+
+            if (storage_spec == *temp) {
+                fmt::print("warning: Duplicate '{}' declaration specifier\n",
+                           storage_to_str[*temp]);
+            } else {
+                throw_err("Cannot combine with previous '{}' declaration specifier",
+                          storage_to_str[storage_spec]);
+            }
+        } else {
+            if (!type.empty()) {
+                throw_err("Cannot combine with previous '{}' declaration specifier", type);
+            }
+            type = parseTypeSpec();
+        }
+    }
+
+    return {type, storage_spec};
+}
+
+Symbol FastParser::parseTypeSpec() {
+    Symbol name = symbol();
+    switch (peek()) {
+    case CLexer::Struct: // a struct type is known by its name alone
+        ++m_pos;
+        name = symbol();
+        expect(CLexer::Identifier, "struct name");
+        return name;
+    case CLexer::Char: ++m_pos; return builtin::Char;
+    case CLexer::Int: ++m_pos; return builtin::Int;
+    case CLexer::Float: ++m_pos; return builtin::Float;
+    case CLexer::Double: ++m_pos; return builtin::Double;
+    case CLexer::Void: ++m_pos; return builtin::Void;
+    case CLexer::Long:
+    case CLexer::Short: name = text(); [[fallthrough]];
+    case CLexer::Identifier: ++m_pos; return name;
+    default: error("type");
+    }
+}
+
+Expr *FastParser::parseVarDecl(bool is_global) {
+    auto ret = m_arena.make(InitExpr{});
+    auto &curr_node = ret->as<InitExpr>();
+
+    auto [type, storage_spec] = parseDeclSpecs();
+    if (storage_spec == StorageSpec::NONE && is_global) {
+        // global var default to extern
+        storage_spec = StorageSpec::EXTERN;
+    }
+
+    do {
+        Symbol name = symbol();
+        expect(CLexer::Identifier, "identifier");
+
+        Expr *init = nullptr;
+        if (accept(CLexer::Assign)) {
+            std::string value{text()};
+            expect(CLexer::Constant, "constant");
+            init = m_arena.make(parseConstant(value));
+        }
+
+        curr_node.push_back(m_arena.make(Variable{
+            .m_var_type = type,
+            .m_storage = storage_spec,
+            .m_var_name = name,
+            .m_var_init = init,
+        }));
+    } while (accept(CLexer::Comma));
+
+    return ret;
+}
+
+Expr *FastParser::parseFuncProto() {
+    auto [type, storage_spec] = parseDeclSpecs();
+    if (storage_spec == StorageSpec::NONE) {
+        // func storage default to extern
+        storage_spec = StorageSpec::EXTERN;
+    }
+
+    Symbol name = symbol();
+    expect(CLexer::Identifier, "function name");
+    expect(CLexer::LeftParen, "'('");
+
+    std::vector<Expr *> params;
+    if (peek() == CLexer::Void && peek(1) == CLexer::RightParen) {
+        ++m_pos;
+        params.push_back(
+            m_arena.make(Variable{.m_var_type = builtin::Void, .m_var_name = "<void>"}));
+    } else if (peek() != CLexer::RightParen) {
+        do {
+            params.push_back(parseParam());
+        } while (accept(CLexer::Comma));
+    }
+    expect(CLexer::RightParen, "')'");
+
+    return m_arena.make(FuncProto{
+        .m_storage = storage_spec,
+        .m_name = name,
+        .m_para_list = std::move(params),
+        .m_return_type = type,
+    });
+}
+
+Expr *FastParser::parseParam() {
+    Symbol type = parseTypeSpec();
+    Symbol name = symbol();
+    expect(CLexer::Identifier, "parameter name");
+    if (accept(CLexer::LeftBracket)) { // arrays are passed like their elements for now
+        expect(CLexer::RightBracket, "']'");
+    }
+    return m_arena.make(Variable{
+        .m_var_type = type,
+        .m_var_name = name,
+    });
+}
+
+// ------------ Statements -------------------
+
+Expr *FastParser::parseStmt() {
+    switch (peek()) {
+    case CLexer::LeftBrace: return parseCompStmt();
+    case CLexer::If: {
+        ++m_pos;
+        expect(CLexer::LeftParen, "'('");
+        auto ret = m_arena.make(IfElse{});
+        auto &curr_node = ret->as<IfElse>();
+        curr_node.m_condi = parseExpr();
+        expect(CLexer::RightParen, "')'");
+        curr_node.m_if = parseStmt();
+        if (accept(CLexer::Else)) { // dangling else goes to the innermost if
+            curr_node.m_else = parseStmt();
+        }
+        return ret;
+    }
+    case CLexer::While: {
+        ++m_pos;
+        expect(CLexer::LeftParen, "'('");
+        auto ret = m_arena.make(WhileLoop{});
+        auto &curr_node = ret->as<WhileLoop>();
+        curr_node.m_condi = parseExpr();
+        expect(CLexer::RightParen, "')'");
+        curr_node.m_loop_body = parseStmt();
+        return ret;
+    }
+    case CLexer::For: return parseForLoop();
+    case CLexer::Return: {
+        ++m_pos;
+        auto ret = m_arena.make(Return{});
+        if (peek() != CLexer::Semi) ret->as<Return>().m_expr = parseExpr();
+        expect(CLexer::Semi, "';'");
+        return ret;
+    }
+    case CLexer::Break:
+        ++m_pos;
+        expect(CLexer::Semi, "';'");
+        return m_arena.make(Break{});
+    case CLexer::Continue:
+        ++m_pos;
+        expect(CLexer::Semi, "';'");
+        return m_arena.make(Continue{});
+    case CLexer::Semi: ++m_pos; return m_arena.make(Null{});
+    default: {
+        auto ret = startsVarDecl() ? parseVarDecl(false) : parseExpr();
+        expect(CLexer::Semi, "';'");
+        return ret;
+    }
+    }
+}
+
+Expr *FastParser::parseCompStmt() {
+    expect(CLexer::LeftBrace, "'{'");
+    auto ret = m_arena.make(CompoundExpr{});
+    auto &curr_node = ret->as<CompoundExpr>();
+    while (peek() != CLexer::RightBrace) {
+        if (peek() == Token::EOF) error("'}'");
+        curr_node.push_back(parseStmt());
+    }
+    ++m_pos;
+    return ret;
+}
+
+Expr *FastParser::parseForLoop() {
+    expect(CLexer::For, "'for'");
+    expect(CLexer::LeftParen, "'('");
+    auto ret = m_arena.make(ForLoop{});
+    auto &curr_node = ret->as<ForLoop>();
+
+    if (peek() != CLexer::Semi) {
+        curr_node.m_init = startsVarDecl() ? parseVarDecl(false) : parseExpr();
+    }
+    expect(CLexer::Semi, "';'");
+    if (peek() != CLexer::Semi) curr_node.m_condi = parseExpr();
+    expect(CLexer::Semi, "';'");
+    if (peek() != CLexer::RightParen) curr_node.m_iter = parseExpr();
+    expect(CLexer::RightParen, "')'");
+
+    curr_node.m_loop_body = parseStmt();
+    return ret;
+}
+
+// ------------ Expressions -------------------
+
+Expr *FastParser::parseExpr() {
+    // only a plain variable can be assigned to, assignments are right associative
+    if (auto op = assignOp(peek(1)); op && peek() == CLexer::Identifier) {
+        auto var = m_arena.make(NameRef{symbol()});
+        m_pos += 2;
+        return m_arena.make(Binary{
+            .m_operand1 = var,
+            .m_operand2 = parseExpr(),
+            .m_operator = *op,
+        });
+    }
+    return parseUnary();
+}
+
+Expr *FastParser::parseUnary() {
+    // as in `CParser.g4`, unary operators bind looser than any binary one: `-a + b` is `-(a + b)`
+    if (auto op = unaryOp(peek())) {
+        ++m_pos;
+        return m_arena.make(Unary{
+            .m_operand = parseUnary(),
+            .m_operator = *op,
+        });
+    }
+    return parseBinary(1);
+}
+
+Expr *FastParser::parseBinary(int min_precedence) {
+    auto lhs = parseFactor();
+    for (auto op = binaryOp(peek()); op && op->precedence >= min_precedence;
+         op = binaryOp(peek())) {
+        ++m_pos;
+        auto rhs = parseBinary(op->precedence + 1);
+        lhs = m_arena.make(Binary{
+            .m_operand1 = lhs,
+            .m_operand2 = rhs,
+            .m_operator = op->op,
+        });
+    }
+    return lhs;
+}
+
+Expr *FastParser::parseFactor() {
+    switch (peek()) {
+    case CLexer::LeftParen: {
+        ++m_pos;
+        auto ret = parseExpr();
+        expect(CLexer::RightParen, "')'");
+        return ret;
+    }
+    case CLexer::Constant: {
+        auto ret = m_arena.make(parseConstant(std::string{text()}));
+        ++m_pos;
+        return ret;
+    }
+    case CLexer::Identifier: {
+        Symbol name = symbol();
+        ++m_pos;
+        if (peek() != CLexer::LeftParen) return m_arena.make(NameRef{name});
+
+        ++m_pos;
+        auto ret = m_arena.make(FuncCall{});
+        auto &curr_node = ret->as<FuncCall>();
+        curr_node.m_func_name = name;
+        if (peek() != CLexer::RightParen) {
+            do {
+                curr_node.m_para_list.push_back(parseExpr());
+            } while (accept(CLexer::Comma));
+        }
+        expect(CLexer::RightParen, "')'");
+        return ret;
+    }
+    default: error("expression");
+    }
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include "AST.hpp"
+#include "ASTArena.h"
+#include "FastLexer.h"
+
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/// source bytes `[begin, end)` a top level declaration is parsed from, comments around excluded
+struct DeclSpan {
+    size_t begin;
+    size_t end;
+};
+
+/**
+ * Recursive descent parser for the language of `CParser.g4`, building `Expr` nodes straight from
+ * `FastLexer` tokens: no parse tree, no `std::any`.
+ *
+ * Binary operators are parsed by a precedence climbing loop, like ANTLR does for `binary_expr`.
+ * Where the grammar is ambiguous, the alternative ANTLR predicts is taken, so the AST is the one
+ * `ASTBuilder` makes. Unlike `CParser`, parsing stops at the first syntax error.
+ */
+class FastParser {
+public:
+    /// nodes are made in `arena`
+    FastParser(std::string_view source, std::vector<FastToken> tokens, ASTArena &arena)
+        : m_source(source), m_tokens(std::move(tokens)), m_arena(arena) {}
+
+    /// top level declarations, same as `ASTBuilder::m_decls` after visiting `CParser::prog()`
+    std::vector<Expr *> parse();
+    /// same as `parse()`, with the span of each declaration appended to `spans`
+    std::vector<Expr *> parse(std::vector<DeclSpan> &spans);
+
+    /// whether any decision looked past the last token, i.e. whether the parse or the error could
+    /// be different if more tokens followed
+    [[nodiscard]] bool peekedEOF() const { return m_peeked_eof; }
+
+private:
+    // declarations
+    void parseDecl(std::vector<Expr *> &decls);
+    std::pair<Symbol, enum StorageSpec> parseDeclSpecs();
+    Symbol parseTypeSpec();
+    Expr *parseVarDecl(bool is_global); // InitExpr
+    Expr *parseFuncProto();
+    Expr *parseParam();
+
+    // statements
+    Expr *parseStmt();
+    Expr *parseCompStmt();
+    Expr *parseForLoop();
+
+    // expressions
+    Expr *parseExpr();
+    Expr *parseUnary();
+    Expr *parseBinary(int min_precedence);
+    Expr *parseFactor();
+
+    // lookahead
+    [[nodiscard]] size_t peek(size_t n = 0) const;
+    [[nodiscard]] bool isDeclSpec(size_t n) const;
+    [[nodiscard]] bool startsVarDecl() const;
+
+    [[nodiscard]] std::string_view text(size_t n = 0) const;
+    [[nodiscard]] Symbol symbol(size_t n = 0) const; // of an `Identifier`
+    bool accept(size_t kind); // consume the next token if it is of `kind`
+    void expect(size_t kind, std::string_view what);
+    [[noreturn]] void error(std::string_view what) const;
+
+    std::string_view m_source;
+    std::vector<FastToken> m_tokens;
+    ASTArena &m_arena;
+    size_t m_pos = 0; // next token
+    mutable bool m_peeked_eof = false;
+};
@@ -0,0 +1,115 @@
+#include "IncrementalParser.h"
+#include "FastLexer.h"
+
+#include <algorithm>
+#include <iterator>
+#include <stdexcept>
+
+DeclUpdate IncrementalParser::edit(TextEdit const &edit) {
+    if (edit.offset > m_source.size() || edit.length > m_source.size() - edit.offset) {
+        throw_err<std::out_of_range>("edit of [{}, {}) is out of the source of {} bytes",
+                                     edit.offset,
+                                     edit.offset + edit.length,
+                                     m_source.size());
+    }
+    size_t edit_end = edit.offset + edit.length;
+    m_source.replace(edit.offset, edit.length, edit.text);
+
+    // declarations before `first` end before the edit, those from `last` on begin after it. the
+    // ones it only touches change too if it extends their first or last token
+    auto first_it = std::lower_bound(
+        m_spans.begin(), m_spans.end(), edit.offset,
+        [](DeclSpan const &span, size_t offset) { return span.end < offset; });
+    auto last_it = std::upper_bound(
+        first_it, m_spans.end(), edit_end,
+        [](size_t offset, DeclSpan const &span) { return offset < span.begin; });
+    size_t first = first_it - m_spans.begin();
+    size_t last = last_it - m_spans.begin();
+
+    for (auto it = last_it; it != m_spans.end(); ++it) {
+        it->begin = it->begin - edit.length + edit.text.size();
+        it->end = it->end - edit.length + edit.text.size();
+    }
+
+    if (m_stale) {
+        first = std::min(first, m_stale_first);
+        last = std::max(last, m_stale_last);
+    }
+    m_stale = true;
+    m_stale_first = first;
+    m_stale_last = last;
+    return parse();
+}
+
+DeclUpdate IncrementalParser::parse() {
+    if (!m_stale) return DeclUpdate{.first = 0, .last = 0, .removed = {}, .removed_arenas = {}};
+    return reparse(m_stale_first, m_stale_last);
+}
+
+DeclUpdate IncrementalParser::reparse(size_t first, size_t last) {
+    size_t from = first ? m_spans[first - 1].end : 0;
+
+    // a declaration may only be complete with tokens of the next ones, e.g. after deleting a `;`.
+    // the region grows until the parser no longer looks past its end, or reaches the source end
+    for (size_t more = 1;; more *= 2) {
+        bool has_next = last < m_spans.size();
+        size_t until = has_next ? m_spans[last].begin : m_source.size();
+
+        auto tokens = FastLexer{m_source, m_source_name}.lex(from, until);
+        if (has_next) {
+            // the next declaration must start where it did, or the edit changed how the rest of
+            // the source lexes, e.g. by opening a comment
+            if (tokens.empty() || tokens.back().offset != until) return reparse(0, m_spans.size());
+            tokens.pop_back();
+        }
+
+        auto arena = std::make_shared<ASTArena>();
+        FastParser parser{m_source, std::move(tokens), *arena};
+        std::vector<DeclSpan> spans;
+        std::vector<Expr *> decls;
+        try {
+            decls = parser.parse(spans);
+        } catch (...) {
+            if (has_next && parser.peekedEOF()) {
+                last = std::min(last + more, m_spans.size());
+                continue;
+            }
+            // old declarations stay until the region parses, with spans of the whole region to
+            // keep `m_spans` sorted
+            std::fill(m_spans.begin() + first, m_spans.begin() + last, DeclSpan{from, until});
+            m_stale_first = first;
+            m_stale_last = last;
+            throw;
+        }
+        if (has_next && parser.peekedEOF()) {
+            last = std::min(last + more, m_spans.size());
+            continue;
+        }
+
+        DeclUpdate update{
+            .first = first,
+            .last = first + decls.size(),
+            .removed{m_decls.begin() + first, m_decls.begin() + last},
+            .removed_arenas{std::make_move_iterator(m_arenas.begin() + first),
+                            std::make_move_iterator(m_arenas.begin() + last)},
+        };
+        m_decls.erase(m_decls.begin() + first, m_decls.begin() + last);
+        m_decls.insert(m_decls.begin() + first, decls.begin(), decls.end());
+        m_arenas.erase(m_arenas.begin() + first, m_arenas.begin() + last);
+        m_arenas.insert(m_arenas.begin() + first, decls.size(), arena);
+        m_spans.erase(m_spans.begin() + first, m_spans.begin() + last);
+        m_spans.insert(m_spans.begin() + first, spans.begin(), spans.end());
+
+        m_stale = false;
+        return update;
+    }
+}
+
+ASTSnapshot IncrementalParser::snapshot() const {
+    // declarations of a re-parse are next to each other, so are the copies of its arena
+    ASTSnapshot::Arenas arenas;
+    for (const auto &arena : m_arenas) {
+        if (arenas.empty() || arenas.back() != arena) arenas.push_back(arena);
+    }
+    return {{m_decls.begin(), m_decls.end()}, std::move(arenas)};
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include "AST.hpp"
+#include "ASTArena.h"
+#include "ASTSnapshot.h"
+#include "FastParser.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+/// replace `length` bytes at `offset` of the source by `text`
+struct TextEdit {
+    size_t offset;
+    size_t length;
+    std::string text;
+};
+
+/// top level declarations changed by an edit: `removed` were replaced by `decls()[first, last)`
+struct DeclUpdate {
+    size_t first;
+    size_t last;
+    std::vector<Expr *> removed;
+    std::vector<std::shared_ptr<ASTArena>> removed_arenas; // keep `removed` alive
+};
+
+/**
+ * Keeps the top level declarations of a source file being edited, e.g. in an editor. An edit
+ * re-lexes and re-parses only the declarations it touches, through `FastLexer` and `FastParser`,
+ * and splices the new ones in, so its cost doesn't grow with the size of the file.
+ *
+ * If the touched declarations don't parse, the error is thrown and the old ones are kept: they are
+ * re-parsed along with whatever the next edit touches, until they parse again.
+ *
+ * The declarations of each re-parse are made in an arena of their own, which is freed once none
+ * of them is left, so memory doesn't grow with the number of edits.
+ */
+class IncrementalParser {
+public:
+    /// nothing is parsed until the first `parse()` or `edit()`
+    explicit IncrementalParser(std::string source, std::string source_name = "")
+        : m_source(std::move(source)), m_source_name(std::move(source_name)) {}
+
+    /// parse what hasn't been parsed successfully yet, throws at the first syntax error
+    DeclUpdate parse();
+    /// apply `edit` to the source, then `parse()`
+    DeclUpdate edit(TextEdit const &edit);
+
+    [[nodiscard]] std::string const &source() const { return m_source; }
+    [[nodiscard]] std::vector<Expr *> const &decls() const { return m_decls; }
+    /// the current declarations, unaffected by later edits
+    [[nodiscard]] ASTSnapshot snapshot() const;
+
+private:
+    /// re-parse the source between `m_decls[first - 1]` and `m_decls[last]`
+    DeclUpdate reparse(size_t first, size_t last);
+
+    std::string m_source;
+    std::string m_source_name;
+    std::vector<Expr *> m_decls;
+    std::vector<std::shared_ptr<ASTArena>> m_arenas; // of `m_decls`
+    std::vector<DeclSpan> m_spans;                   // of `m_decls` in `m_source`
+
+    // `m_decls[m_stale_first, m_stale_last)` and the source around them are yet to be parsed
+    bool m_stale = true;
+    size_t m_stale_first = 0;
+    size_t m_stale_last = 0;
+};
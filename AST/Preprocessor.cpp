@@ -0,0 +1,957 @@
+#include "Preprocessor.h"
+#include "utility.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <fstream>
+#include <functional>
+#include <iterator>
+#include <stdexcept>
+#include <utility>
+
+namespace {
+
+bool isIdentStart(char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_';
+}
+
+bool isIdentChar(char c) {
+    return isIdentStart(c) || (c >= '0' && c <= '9');
+}
+
+bool isDigit(char c) {
+    return c >= '0' && c <= '9';
+}
+
+// longest first, so the first match is the longest
+constexpr std::string_view punctuators[] = {
+    "...", "<<=", ">>=", "##", "->", "++", "--", "<<", ">>", "<=", ">=", "==", "!=", "&&",
+    "||",  "+=",  "-=",  "*=", "/=", "%=", "&=", "|=", "^=", "#",  "(",  ")",  "[",  "]",
+    "{",   "}",   ".",   ",",  ";",  ":",  "?",  "+",  "-",  "*",  "/",  "%",  "&",  "|",
+    "^",   "~",   "!",   "<",  ">",  "=",
+};
+
+/// preprocessing tokens of `text`, which must outlive them
+std::vector<PPToken> lexTokens(std::string_view text, std::string_view path) {
+    std::vector<PPToken> tokens;
+    tokens.reserve(text.size() / 4);
+
+    size_t i = 0, line_begin = 0;
+    uint32_t line = 1;
+    bool line_start = true, space = false;
+
+    // skip a line continuation at `i`, if any
+    auto continuation = [&] {
+        size_t n = text.substr(i, 2) == "\\\n" ? 2 : text.substr(i, 3) == "\\\r\n" ? 3 : 0;
+        if (!n) return false;
+        i += n;
+        ++line;
+        line_begin = i;
+        return true;
+    };
+
+    while (i < text.size()) {
+        char c = text[i];
+        if (c == '\n') {
+            ++i;
+            ++line;
+            line_begin = i;
+            line_start = true;
+            space = false;
+            continue;
+        }
+        if (c == ' ' || c == '\t' || c == '\r' || c == '\f' || c == '\v') {
+            ++i;
+            space = true;
+            continue;
+        }
+        if (continuation()) {
+            space = true;
+            continue;
+        }
+        if (text.substr(i, 2) == "//") {
+            i = std::min(text.find('\n', i), text.size());
+            space = true;
+            continue;
+        }
+        if (text.substr(i, 2) == "/*") { // a comment is a space, even over several lines
+            size_t end = text.find("*/", i + 2);
+            if (end == std::string_view::npos) {
+                throw_err<std::runtime_error>("{}:{}:{}: unterminated comment",
+                                              path,
+                                              line,
+                                              i - line_begin + 1);
+            }
+            for (; i < end + 2; ++i) {
+                if (text[i] == '\n') ++line, line_begin = i + 1;
+            }
+            space = true;
+            continue;
+        }
+
+        size_t start = i;
+        PPToken::Kind kind;
+        if (isIdentStart(c)) {
+            while (i < text.size() && isIdentChar(text[i])) ++i;
+            kind = PPToken::Identifier;
+        } else if (isDigit(c) || (c == '.' && i + 1 < text.size() && isDigit(text[i + 1]))) {
+            // pp-number: digits, letters, `_`, `.` and signs after an exponent
+            for (++i; i < text.size(); ++i) {
+                char prev = text[i - 1];
+                if (isIdentChar(text[i]) || text[i] == '.') continue;
+                if ((text[i] == '+' || text[i] == '-') &&
+                    (prev == 'e' || prev == 'E' || prev == 'p' || prev == 'P')) {
+                    continue;
+                }
+                break;
+            }
+            kind = PPToken::Number;
+        } else if (c == '"' || c == '\'') {
+            size_t end = i + 1;
+            while (end < text.size() && text[end] != c && text[end] != '\n') {
+                end += text[end] == '\\' && end + 1 < text.size() ? 2 : 1;
+            }
+            if (end < text.size() && text[end] == c) { // unterminated ones are left to the lexer
+                i = end + 1;
+                kind = c == '"' ? PPToken::String : PPToken::Char;
+            } else {
+                i = start + 1;
+                kind = PPToken::Other;
+            }
+        } else {
+            auto punct = std::find_if(std::begin(punctuators), std::end(punctuators),
+                                      [&](auto p) { return text.substr(i, p.size()) == p; });
+            i += punct == std::end(punctuators) ? 1 : punct->size();
+            kind = punct == std::end(punctuators) ? PPToken::Other : PPToken::Punct;
+        }
+
+        tokens.push_back(PPToken{
+            .text = text.substr(start, i - start),
+            .line = line,
+            .column = static_cast<uint32_t>(start - line_begin),
+            .kind = kind,
+            .line_start = line_start,
+            .space_before = space,
+        });
+        line_start = false;
+        space = false;
+    }
+    return tokens;
+}
+
+/// name of the directive at `tokens[i]`, empty if there is none
+std::string_view directiveAt(std::vector<PPToken> const &tokens, size_t i) {
+    if (!tokens[i].line_start || tokens[i].text != "#") return {};
+    if (i + 1 == tokens.size() || tokens[i + 1].line_start) return {};
+    return tokens[i + 1].text;
+}
+
+/// macro of the include guard around all of `tokens`, empty if there is none
+std::string includeGuard(std::vector<PPToken> const &tokens) {
+    if (tokens.empty()) return {};
+
+    // `#ifndef X` or `#if !defined X` or `#if !defined(X)`, alone on its line
+    std::string_view guard;
+    size_t i = 2;
+    auto at = [&](size_t n) -> std::string_view {
+        return n < tokens.size() && !tokens[n].line_start ? tokens[n].text : "";
+    };
+    if (directiveAt(tokens, 0) == "ifndef" && tokens.size() > 2 && !tokens[2].line_start) {
+        guard = tokens[2].text;
+        i = 3;
+    } else if (directiveAt(tokens, 0) == "if" && at(2) == "!" && at(3) == "defined") {
+        bool paren = at(4) == "(";
+        guard = at(4 + paren);
+        i = 5 + paren;
+        if (paren && at(i++) != ")") return {};
+    }
+    if (guard.empty() || !isIdentStart(guard.front()) || !at(i).empty()) return {};
+
+    // the `#endif` closing it must be the last directive, with nothing after it
+    size_t depth = 0;
+    for (; i < tokens.size(); ++i) {
+        auto name = directiveAt(tokens, i);
+        if (name == "if" || name == "ifdef" || name == "ifndef") {
+            ++depth;
+        } else if ((name == "elif" || name == "else") && depth == 0) {
+            return {};
+        } else if (name == "endif") {
+            if (depth-- > 0) continue;
+            for (i += 2; i < tokens.size(); ++i) {
+                if (tokens[i].line_start) return {};
+            }
+            return std::string{guard};
+        }
+    }
+    return {};
+}
+
+bool contains(const HideSet *set, std::string_view name) {
+    for (; set; set = set->next) {
+        if (set->name == name) return true;
+    }
+    return false;
+}
+
+/// value of a `Char` token in `#if`, escapes beyond the simple ones are taken literally
+intmax_t charValue(std::string_view text) {
+    if (text.size() < 3 || text[1] != '\\') return static_cast<unsigned char>(text[1]);
+    switch (text[2]) {
+    case 'n': return '\n';
+    case 't': return '\t';
+    case 'r': return '\r';
+    case '0': return '\0';
+    case 'a': return '\a';
+    case 'b': return '\b';
+    case 'f': return '\f';
+    case 'v': return '\v';
+    default: return static_cast<unsigned char>(text[2]);
+    }
+}
+
+/// evaluates the expression of an `#if`, after `defined` and macros are replaced
+class IfExpr {
+public:
+    using ErrorFn = std::function<void(PPToken const &, std::string_view)>;
+
+    IfExpr(std::vector<PPToken> const &tokens, ErrorFn error)
+        : m_tokens(tokens), m_error(std::move(error)) {}
+
+    intmax_t evaluate() {
+        intmax_t value = parseConditional();
+        if (m_pos < m_tokens.size()) fail("missing binary operator");
+        return value;
+    }
+
+private:
+    intmax_t parseConditional() {
+        intmax_t condition = parseBinary(1);
+        if (!accept("?")) return condition;
+        intmax_t then = parseConditional();
+        if (!accept(":")) fail("expected ':' in conditional expression");
+        intmax_t otherwise = parseConditional();
+        return condition ? then : otherwise;
+    }
+
+    static int precedence(std::string_view op) {
+        if (op == "||") return 1;
+        if (op == "&&") return 2;
+        if (op == "|") return 3;
+        if (op == "^") return 4;
+        if (op == "&") return 5;
+        if (op == "==" || op == "!=") return 6;
+        if (op == "<" || op == ">" || op == "<=" || op == ">=") return 7;
+        if (op == "<<" || op == ">>") return 8;
+        if (op == "+" || op == "-") return 9;
+        if (op == "*" || op == "/" || op == "%") return 10;
+        return 0;
+    }
+
+    intmax_t parseBinary(int min_precedence) {
+        intmax_t lhs = parseUnary();
+        while (m_pos < m_tokens.size()) {
+            const auto &op = m_tokens[m_pos];
+            int prec = op.kind == PPToken::Punct ? precedence(op.text) : 0;
+            if (prec < min_precedence || prec == 0) break;
+            ++m_pos;
+            intmax_t rhs = parseBinary(prec + 1);
+            lhs = apply(op, lhs, rhs);
+        }
+        return lhs;
+    }
+
+    intmax_t apply(PPToken const &op, intmax_t lhs, intmax_t rhs) {
+        auto text = op.text;
+        if ((text == "/" || text == "%") && rhs == 0) m_error(op, "division by zero in #if");
+        if (text == "||") return lhs || rhs;
+        if (text == "&&") return lhs && rhs;
+        if (text == "|") return lhs | rhs;
+        if (text == "^") return lhs ^ rhs;
+        if (text == "&") return lhs & rhs;
+        if (text == "==") return lhs == rhs;
+        if (text == "!=") return lhs != rhs;
+        if (text == "<") return lhs < rhs;
+        if (text == ">") return lhs > rhs;
+        if (text == "<=") return lhs <= rhs;
+        if (text == ">=") return lhs >= rhs;
+        if (text == "<<") return lhs << rhs;
+        if (text == ">>") return lhs >> rhs;
+        if (text == "+") return lhs + rhs;
+        if (text == "-") return lhs - rhs;
+        if (text == "*") return lhs * rhs;
+        if (text == "/") return lhs / rhs;
+        return lhs % rhs;
+    }
+
+    intmax_t parseUnary() {
+        if (accept("+")) return parseUnary();
+        if (accept("-")) return -parseUnary();
+        if (accept("!")) return !parseUnary();
+        if (accept("~")) return ~parseUnary();
+        if (accept("(")) {
+            intmax_t value = parseConditional();
+            if (!accept(")")) fail("missing ')' in expression");
+            return value;
+        }
+        if (m_pos == m_tokens.size()) fail("expected value in expression");
+
+        const auto &token = m_tokens[m_pos++];
+        switch (token.kind) {
+        case PPToken::Identifier: return 0; // not a macro
+        case PPToken::Char: return charValue(token.text);
+        case PPToken::Number: return numberValue(token);
+        default: m_error(token, fmt::format("token \"{}\" is not valid in #if", token.text));
+        }
+        return 0;
+    }
+
+    intmax_t numberValue(PPToken const &token) {
+        auto text = token.text;
+        while (!text.empty() && (text.back() == 'u' || text.back() == 'U' || text.back() == 'l' ||
+                                 text.back() == 'L')) {
+            text.remove_suffix(1);
+        }
+        int base = 10;
+        if (text.size() > 1 && text[0] == '0' && (text[1] == 'x' || text[1] == 'X')) {
+            base = 16;
+            text.remove_prefix(2);
+        } else if (text.size() > 1 && text[0] == '0') {
+            base = 8;
+        }
+        intmax_t value = 0;
+        auto [end, ec] = std::from_chars(text.data(), text.data() + text.size(), value, base);
+        if (ec != std::errc{} || end != text.data() + text.size()) {
+            m_error(token, fmt::format("invalid integer constant \"{}\" in #if", token.text));
+        }
+        return value;
+    }
+
+    bool accept(std::string_view punct) {
+        if (m_pos == m_tokens.size() || m_tokens[m_pos].kind != PPToken::Punct ||
+            m_tokens[m_pos].text != punct) {
+            return false;
+        }
+        ++m_pos;
+        return true;
+    }
+
+    void fail(std::string_view message) {
+        m_error(m_tokens[std::min(m_pos, m_tokens.size() - 1)], message);
+    }
+
+    std::vector<PPToken> const &m_tokens;
+    ErrorFn m_error;
+    size_t m_pos = 0;
+};
+
+} // namespace
+
+// ------------ Implementation of `HeaderCache` -------------------
+
+std::shared_ptr<SourceFile> lexSourceFile(std::string path, std::string text) {
+    auto file = std::make_shared<SourceFile>();
+    file->path = std::move(path);
+    file->text = std::move(text);
+    file->tokens = lexTokens(file->text, file->path);
+    file->guard = includeGuard(file->tokens);
+    return file;
+}
+
+std::shared_ptr<const SourceFile> HeaderCache::get(fs::path const &path) {
+    std::error_code ec;
+    auto mtime = fs::last_write_time(path, ec);
+    uintmax_t size = ec ? 0 : fs::file_size(path, ec);
+    if (ec) throw_err<std::runtime_error>("cannot read '{}': {}", path.native(), ec.message());
+
+    {
+        std::lock_guard lock{m_mutex};
+        auto it = m_files.find(path.native());
+        if (it != m_files.end() && it->second->mtime == mtime && it->second->size == size) {
+            return it->second;
+        }
+    }
+
+    // concurrent compilations may lex a new header at the same time, either result is fine
+    std::ifstream in(path, std::ios::binary);
+    if (!in) throw_err<std::runtime_error>("cannot read '{}'", path.native());
+    std::string text{std::istreambuf_iterator<char>{in}, {}};
+
+    auto file = lexSourceFile(path.native(), std::move(text));
+    file->mtime = mtime;
+    file->size = size;
+    dbg_print("[DEBUG] header {} is lexed{}\n",
+              path.native(),
+              file->guard.empty() ? "" : fmt::format(", include guard {}", file->guard));
+
+    std::lock_guard lock{m_mutex};
+    m_files.insert_or_assign(path.native(), file);
+    return file;
+}
+
+// ------------ Implementation of `Preprocessor` -------------------
+
+Preprocessor::Preprocessor(HeaderCache &headers, std::vector<std::string> include_dirs,
+                           std::vector<std::string> const &defines)
+    : m_headers(headers), m_include_dirs(std::move(include_dirs)) {
+    for (const auto &define : defines) {
+        auto eq = define.find('=');
+        std::string name = define.substr(0, eq);
+        if (name.empty() || !isIdentStart(name.front()) ||
+            !std::all_of(name.begin(), name.end(), isIdentChar)) {
+            throw_err<std::runtime_error>("macro name '{}' of -D must be an identifier", name);
+        }
+        Macro macro;
+        macro.body = lexTokens(save(eq == std::string::npos ? "1" : define.substr(eq + 1)),
+                               "<command line>");
+        m_macros.insert_or_assign(std::move(name), std::move(macro));
+    }
+}
+
+Preprocessor::~Preprocessor() = default;
+
+bool Preprocessor::needed(std::string_view source, std::vector<std::string> const &defines) {
+    return !defines.empty() || source.find('#') != std::string_view::npos;
+}
+
+std::string Preprocessor::run(std::string_view source, std::string const &path) {
+    enterFile(lexSourceFile(path, std::string{source}));
+    m_output.reserve(source.size() + source.size() / 8);
+
+    while (auto token = next()) {
+        // only tokens of files can start directives, expanded ones never do
+        if (token->line_start && token->text == "#" && !token->expanded) {
+            directive(*token);
+        } else if (!expand(*token)) {
+            emit(*token);
+        }
+    }
+    return std::move(m_output);
+}
+
+void Preprocessor::defineMacro(std::string_view definition) {
+    define(lexTokens(save(std::string{definition}), "<command line>"));
+}
+
+std::vector<std::string> Preprocessor::macroDefinitions() const {
+    std::vector<std::string> ret;
+    ret.reserve(m_macros.size());
+    for (const auto &[name, macro] : m_macros) {
+        std::string text = name;
+        if (macro.function_like) {
+            text += '(';
+            for (size_t i = 0; i < macro.params.size(); ++i) {
+                if (i) text += ',';
+                bool va_args = macro.variadic && i + 1 == macro.params.size();
+                text += va_args ? std::string_view{"..."} : macro.params[i];
+            }
+            text += ')';
+        }
+        for (const auto &token : macro.body) {
+            // a space before the body keeps an object-like `X (1)` from turning function-like
+            if (&token == &macro.body.front() || token.space_before) text += ' ';
+            text += token.text;
+        }
+        ret.push_back(std::move(text));
+    }
+    return ret;
+}
+
+std::vector<std::shared_ptr<const SourceFile>> Preprocessor::includedFiles() const {
+    std::vector<std::shared_ptr<const SourceFile>> ret;
+    ret.reserve(m_included.size());
+    for (const auto &[path, file] : m_included) ret.push_back(file);
+    return ret;
+}
+
+// ------------ Token stream -------------------
+
+std::optional<PPToken> Preprocessor::next() {
+    if (!m_pending.empty()) {
+        PPToken token = m_pending.back();
+        m_pending.pop_back();
+        return token;
+    }
+    while (!m_detached && !m_files.empty()) {
+        auto &state = m_files.back();
+        if (state.next < state.file->tokens.size()) return state.file->tokens[state.next++];
+        if (m_conditionals.size() > state.conditional_depth) {
+            throw_err<std::runtime_error>("{}: unterminated conditional directive",
+                                          state.file->path);
+        }
+        m_files.pop_back();
+    }
+    return std::nullopt;
+}
+
+const PPToken *Preprocessor::peek() const {
+    if (!m_pending.empty()) return &m_pending.back();
+    if (m_detached || m_files.empty()) return nullptr;
+    const auto &state = m_files.back();
+    return state.next < state.file->tokens.size() ? &state.file->tokens[state.next] : nullptr;
+}
+
+std::vector<PPToken> Preprocessor::restOfLine() {
+    auto &state = m_files.back();
+    const auto &tokens = state.file->tokens;
+    size_t end = state.next;
+    while (end < tokens.size() && !tokens[end].line_start) ++end;
+
+    std::vector<PPToken> line(tokens.begin() + state.next, tokens.begin() + end);
+    state.next = end;
+    return line;
+}
+
+void Preprocessor::enterFile(std::shared_ptr<const SourceFile> file) {
+    m_files.push_back(FileState{
+        .file = std::move(file),
+        .conditional_depth = m_conditionals.size(),
+    });
+}
+
+// ------------ Directives -------------------
+
+void Preprocessor::directive(PPToken const &hash) {
+    auto line = restOfLine();
+    if (line.empty()) return; // null directive
+
+    PPToken name = line.front();
+    line.erase(line.begin());
+    auto &state = m_files.back();
+    bool in_conditional = m_conditionals.size() > state.conditional_depth;
+
+    if (name.text == "define") {
+        define(line);
+    } else if (name.text == "undef") {
+        if (line.empty() || line[0].kind != PPToken::Identifier) {
+            error(name, "macro name must be an identifier");
+        }
+        if (auto it = m_macros.find(line[0].text); it != m_macros.end()) m_macros.erase(it);
+    } else if (name.text == "include") {
+        include(hash, std::move(line));
+    } else if (name.text == "if" || name.text == "ifdef" || name.text == "ifndef") {
+        bool taking;
+        if (name.text == "if") {
+            taking = evaluate(hash, std::move(line));
+        } else {
+            if (line.empty() || line[0].kind != PPToken::Identifier) {
+                error(name, "macro name must be an identifier");
+            }
+            taking = m_macros.contains(line[0].text) == (name.text == "ifdef");
+        }
+        m_conditionals.push_back(Conditional{
+            .taking = taking,
+            .was_taken = taking,
+            .seen_else = false,
+        });
+        if (!taking) skipGroup();
+    } else if (name.text == "elif" || name.text == "else") {
+        if (!in_conditional) error(name, fmt::format("#{} without #if", name.text));
+        auto &conditional = m_conditionals.back();
+        if (conditional.seen_else) error(name, fmt::format("#{} after #else", name.text));
+        conditional.seen_else = name.text == "else";
+
+        if (conditional.was_taken) {
+            conditional.taking = false;
+        } else {
+            conditional.taking = name.text == "else" || evaluate(hash, std::move(line));
+            conditional.was_taken = conditional.taking;
+        }
+        if (!conditional.taking) skipGroup();
+    } else if (name.text == "endif") {
+        if (!in_conditional) error(name, "#endif without #if");
+        m_conditionals.pop_back();
+    } else if (name.text == "pragma") {
+        if (!line.empty() && line[0].text == "once") m_once.insert(state.file->path);
+        // other pragmas are ignored
+    } else if (name.text == "error" || name.text == "warning") {
+        std::string message;
+        for (const auto &token : line) {
+            if (!message.empty() && token.space_before) message += ' ';
+            message += token.text;
+        }
+        if (name.text == "error") error(name, fmt::format("#error {}", message));
+        fmt::print(stderr, "{}:{}: warning: {}\n", state.file->path, name.line, message);
+    } else {
+        error(name, fmt::format("invalid preprocessing directive #{}", name.text));
+    }
+}
+
+void Preprocessor::define(std::vector<PPToken> const &line) {
+    if (line.empty() || line[0].kind != PPToken::Identifier) {
+        error(line.empty() ? PPToken{} : line[0], "macro name must be an identifier");
+    }
+
+    Macro macro;
+    size_t i = 1;
+    auto at = [&](size_t n) -> PPToken const & {
+        if (n >= line.size()) error(line.back(), "missing ')' in macro parameter list");
+        return line[n];
+    };
+
+    // a function-like macro has its `(` right after the name
+    if (i < line.size() && line[i].text == "(" && !line[i].space_before) {
+        macro.function_like = true;
+        if (at(++i).text == ")") {
+            ++i;
+        } else {
+            for (;;) {
+                const auto &param = at(i++);
+                if (param.text == "...") {
+                    macro.variadic = true;
+                    macro.params.push_back("__VA_ARGS__");
+                    if (at(i++).text != ")") error(param, "missing ')' after '...'");
+                    break;
+                }
+                if (param.kind != PPToken::Identifier) error(param, "expected parameter name");
+                macro.params.push_back(param.text);
+
+                const auto &delim = at(i++);
+                if (delim.text == ")") break;
+                if (delim.text != ",") error(delim, "expected ',' or ')' in macro parameter list");
+            }
+        }
+    }
+
+    macro.body.assign(line.begin() + i, line.end());
+    for (size_t j = 0; j < macro.body.size(); ++j) {
+        const auto &token = macro.body[j];
+        if (token.text == "##" && (j == 0 || j + 1 == macro.body.size())) {
+            error(token, "'##' cannot appear at either end of a macro expansion");
+        }
+        if (macro.function_like && token.text == "#" &&
+            (j + 1 == macro.body.size() ||
+             std::find(macro.params.begin(), macro.params.end(), macro.body[j + 1].text) ==
+                 macro.params.end())) {
+            error(token, "'#' is not followed by a macro parameter");
+        }
+    }
+    m_macros.insert_or_assign(std::string{line[0].text}, std::move(macro));
+}
+
+void Preprocessor::include(PPToken const &hash, std::vector<PPToken> line) {
+    if (!line.empty() && line[0].kind != PPToken::String && line[0].text != "<") {
+        line = expandAll(std::move(line));
+    }
+
+    std::string name;
+    bool quoted = !line.empty() && line[0].kind == PPToken::String;
+    if (quoted) {
+        name = line[0].text.substr(1, line[0].text.size() - 2);
+    } else if (!line.empty() && line[0].text == "<") {
+        size_t i = 1;
+        for (; i < line.size() && line[i].text != ">"; ++i) {
+            if (i > 1 && line[i].space_before) name += ' ';
+            name += line[i].text;
+        }
+        if (i == line.size()) error(hash, "missing terminating '>' character");
+    } else {
+        error(hash, "#include expects \"FILENAME\" or <FILENAME>");
+    }
+
+    auto path = resolve(name, quoted);
+    if (!path) error(hash, fmt::format("'{}' file not found", name));
+    if (m_once.contains(path->native())) return;
+
+    // a file included before isn't even looked up in the cache again if its guard is defined
+    auto [it, first_time] = m_included.try_emplace(path->native());
+    if (first_time) it->second = m_headers.get(*path);
+    const auto &file = it->second;
+    if (!file->guard.empty() && m_macros.contains(file->guard)) return;
+
+    if (m_files.size() >= 200) error(hash, "#include nested too deeply");
+    if (m_files.size() == 1) syncLine(hash.line);
+    enterFile(file);
+}
+
+std::optional<fs::path> Preprocessor::resolve(std::string_view name, bool quoted) {
+    // `"name"` is looked for next to the including file first
+    fs::path dir = quoted ? fs::path{m_files.back().file->path}.parent_path() : fs::path{};
+    std::string key = fmt::format("{}{}\n{}", quoted ? "\"" : "<", dir.native(), name);
+    if (auto it = m_resolved.find(key); it != m_resolved.end()) return it->second;
+
+    std::vector<fs::path> dirs;
+    if (quoted) dirs.push_back(dir);
+    dirs.insert(dirs.end(), m_include_dirs.begin(), m_include_dirs.end());
+
+    std::optional<fs::path> found;
+    for (const auto &candidate_dir : dirs) {
+        std::error_code ec;
+        auto candidate = fs::absolute(candidate_dir / name, ec).lexically_normal();
+        if (!ec && fs::is_regular_file(candidate, ec)) {
+            found = std::move(candidate);
+            break;
+        }
+    }
+    m_resolved.emplace(std::move(key), found);
+    return found;
+}
+
+void Preprocessor::skipGroup() {
+    auto &state = m_files.back();
+    const auto &tokens = state.file->tokens;
+    size_t depth = 0;
+    for (; state.next < tokens.size(); ++state.next) {
+        auto name = directiveAt(tokens, state.next);
+        if (name == "if" || name == "ifdef" || name == "ifndef") {
+            ++depth;
+        } else if (name == "endif" && depth > 0) {
+            --depth;
+        } else if ((name == "elif" || name == "else" || name == "endif") && depth == 0) {
+            return; // handled as a directive next
+        }
+    }
+}
+
+bool Preprocessor::evaluate(PPToken const &hash, std::vector<PPToken> line) {
+    // `defined X` and `defined(X)` go first, expanding `X` would lose it
+    std::vector<PPToken> tokens;
+    for (size_t i = 0; i < line.size(); ++i) {
+        if (line[i].text != "defined") {
+            tokens.push_back(line[i]);
+            continue;
+        }
+        bool paren = i + 1 < line.size() && line[i + 1].text == "(";
+        size_t name_at = i + 1 + paren;
+        if (name_at >= line.size() || line[name_at].kind != PPToken::Identifier) {
+            error(line[i], "macro name missing after 'defined'");
+        }
+        if (paren && (name_at + 1 >= line.size() || line[name_at + 1].text != ")")) {
+            error(line[i], "missing ')' after 'defined'");
+        }
+
+        PPToken value = line[i];
+        value.kind = PPToken::Number;
+        value.text = m_macros.contains(line[name_at].text) ? "1" : "0";
+        tokens.push_back(value);
+        i = name_at + paren;
+    }
+
+    tokens = expandAll(std::move(tokens));
+    if (tokens.empty()) error(hash, "#if with no expression");
+    return IfExpr{tokens, [this](auto const &at, auto message) { error(at, message); }}.evaluate();
+}
+
+// ------------ Macro expansion -------------------
+
+bool Preprocessor::expand(PPToken const &token) {
+    if (token.kind != PPToken::Identifier || contains(token.hide_set, token.text)) return false;
+    auto it = m_macros.find(token.text);
+    if (it == m_macros.end()) return false;
+    const auto &macro = it->second;
+
+    // a use can't be told from its name's hide set
+    std::vector<PPToken> result;
+    const HideSet *hide_set;
+    if (!macro.function_like) {
+        result = substitute(macro, {});
+        hide_set = hideSetWith(token.hide_set, token.text);
+    } else {
+        const PPToken *paren = peek();
+        if (!paren || paren->text != "(") return false; // just the name
+
+        PPToken rparen;
+        auto args = readArgs(token, macro, rparen);
+        result = substitute(macro, args);
+        hide_set = hideSetWith(hideSetIntersection(token.hide_set, rparen.hide_set), token.text);
+    }
+
+    for (auto &expanded : result) {
+        expanded.hide_set = hideSetUnion(expanded.hide_set, hide_set);
+        expanded.line = token.line;
+        expanded.column = token.column;
+        expanded.line_start = false;
+        expanded.expanded = true;
+    }
+    if (!result.empty()) result.front().space_before = token.space_before;
+    m_pending.insert(m_pending.end(), result.rbegin(), result.rend()); // rescanned
+    return true;
+}
+
+std::vector<std::vector<PPToken>> Preprocessor::readArgs(PPToken const &name, Macro const &macro,
+                                                         PPToken &rparen) {
+    next(); // (
+    std::vector<std::vector<PPToken>> args(1);
+    size_t depth = 0;
+    for (;;) {
+        auto token = next();
+        if (!token) {
+            error(name, fmt::format("unterminated argument list invoking macro '{}'", name.text));
+        }
+        if (token->text == ")" && depth == 0) {
+            rparen = *token;
+            break;
+        }
+        if (token->text == "(") ++depth;
+        if (token->text == ")") --depth;
+        // the variadic argument takes the rest, commas included
+        if (token->text == "," && depth == 0 &&
+            !(macro.variadic && args.size() == macro.params.size())) {
+            args.emplace_back();
+            continue;
+        }
+        args.back().push_back(*token);
+    }
+
+    if (macro.params.empty() && args.size() == 1 && args[0].empty()) args.clear();
+    if (macro.variadic && args.size() + 1 == macro.params.size()) args.emplace_back();
+    if (args.size() != macro.params.size()) {
+        error(name,
+              fmt::format("macro '{}' passed {} arguments, but takes {}",
+                          name.text,
+                          args.size(),
+                          macro.params.size()));
+    }
+    return args;
+}
+
+std::vector<PPToken> Preprocessor::substitute(Macro const &macro,
+                                              std::vector<std::vector<PPToken>> const &args) {
+    auto param = [&](PPToken const &token) -> std::optional<size_t> {
+        if (token.kind != PPToken::Identifier) return std::nullopt;
+        auto it = std::find(macro.params.begin(), macro.params.end(), token.text);
+        if (it == macro.params.end()) return std::nullopt;
+        return it - macro.params.begin();
+    };
+    // an empty argument next to `##` is a placemarker, a token with empty text
+    auto placemarker = [](PPToken const &at) {
+        PPToken token = at;
+        token.text = "";
+        return token;
+    };
+
+    const auto &body = macro.body;
+    std::vector<PPToken> out;
+    for (size_t i = 0; i < body.size(); ++i) {
+        const auto &token = body[i];
+        bool before_paste = i + 1 < body.size() && body[i + 1].text == "##";
+
+        if (macro.function_like && token.text == "#") {
+            out.push_back(stringify(args[*param(body[++i])], token));
+        } else if (token.text == "##") {
+            const auto &rhs = body[++i];
+            std::vector<PPToken> operand{rhs};
+            if (auto p = param(rhs)) operand = args[*p]; // not expanded
+            if (operand.empty()) operand.push_back(placemarker(rhs));
+            out.back() = paste(out.back(), operand.front());
+            out.insert(out.end(), operand.begin() + 1, operand.end());
+        } else if (auto p = param(token)) {
+            const auto &arg = args[*p];
+            std::vector<PPToken> value = before_paste ? arg : expandAll(arg);
+            if (value.empty() && before_paste) value.push_back(placemarker(token));
+            if (!value.empty()) value.front().space_before = token.space_before;
+            out.insert(out.end(), value.begin(), value.end());
+        } else {
+            out.push_back(token);
+        }
+    }
+
+    std::erase_if(out, [](PPToken const &token) { return token.text.empty(); });
+    return out;
+}
+
+std::vector<PPToken> Preprocessor::expandAll(std::vector<PPToken> tokens) {
+    auto pending = std::exchange(m_pending, {});
+    bool detached = std::exchange(m_detached, true);
+    m_pending.assign(tokens.rbegin(), tokens.rend());
+
+    std::vector<PPToken> out;
+    while (auto token = next()) {
+        if (!expand(*token)) out.push_back(*token);
+    }
+
+    m_pending = std::move(pending);
+    m_detached = detached;
+    return out;
+}
+
+PPToken Preprocessor::stringify(std::vector<PPToken> const &arg, PPToken const &at) {
+    std::string text = "\"";
+    for (size_t i = 0; i < arg.size(); ++i) {
+        if (i > 0 && arg[i].space_before) text += ' ';
+        for (char c : arg[i].text) {
+            bool literal = arg[i].kind == PPToken::String || arg[i].kind == PPToken::Char;
+            if (literal && (c == '"' || c == '\\')) text += '\\';
+            text += c;
+        }
+    }
+    text += '"';
+
+    PPToken token = at;
+    token.kind = PPToken::String;
+    token.text = save(std::move(text));
+    return token;
+}
+
+PPToken Preprocessor::paste(PPToken const &lhs, PPToken const &rhs) {
+    if (lhs.text.empty()) return rhs;
+    if (rhs.text.empty()) return lhs;
+
+    auto text = save(fmt::format("{}{}", lhs.text, rhs.text));
+    auto tokens = lexTokens(text, "<paste>");
+    if (tokens.size() != 1 || tokens[0].text.size() != text.size()) {
+        error(lhs,
+              fmt::format("pasting \"{}\" and \"{}\" does not give a valid preprocessing token",
+                          lhs.text,
+                          rhs.text));
+    }
+
+    PPToken token = lhs;
+    token.kind = tokens[0].kind;
+    token.text = text;
+    return token;
+}
+
+const HideSet *Preprocessor::hideSetWith(const HideSet *set, std::string_view name) {
+    if (contains(set, name)) return set;
+    return &m_hide_sets.emplace_back(HideSet{.name = name, .next = set});
+}
+
+const HideSet *Preprocessor::hideSetUnion(const HideSet *a, const HideSet *b) {
+    for (; a; a = a->next) b = hideSetWith(b, a->name);
+    return b;
+}
+
+const HideSet *Preprocessor::hideSetIntersection(const HideSet *a, const HideSet *b) {
+    const HideSet *set = nullptr;
+    for (; a; a = a->next) {
+        if (contains(b, a->name)) set = hideSetWith(set, a->name);
+    }
+    return set;
+}
+
+std::string_view Preprocessor::save(std::string text) {
+    return m_strings.emplace_back(std::move(text));
+}
+
+// ------------ Output -------------------
+
+void Preprocessor::syncLine(uint32_t line) {
+    if (line <= m_output_line) return;
+    m_output.append(line - m_output_line, '\n');
+    m_output_line = line;
+    m_output_column = 0;
+    m_last_expanded = false;
+}
+
+void Preprocessor::emit(PPToken const &token) {
+    // tokens of included files stay on the line of the `#include`
+    bool in_main = m_files.size() == 1;
+    if (in_main) syncLine(token.line);
+
+    if (in_main && !token.expanded && m_output_column < token.column) {
+        m_output.append(token.column - m_output_column, ' ');
+        m_output_column = token.column;
+    } else if (m_output_column > 0 && (token.space_before || token.line_start ||
+                                       token.expanded || m_last_expanded)) {
+        m_output += ' '; // tokens that weren't adjacent in a file must not run together
+        ++m_output_column;
+    }
+    m_output += token.text;
+    m_output_column += token.text.size();
+    m_last_expanded = token.expanded;
+}
+
+void Preprocessor::error(PPToken const &at, std::string_view message) const {
+    std::string_view path = m_files.empty() ? "<command line>" : m_files.back().file->path;
+    throw_err<std::runtime_error>("{}:{}:{}: {}", path, at.line, at.column + 1, message);
+}
@@ -0,0 +1,173 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+/// names of the macros a token came out of, which it must not expand again
+struct HideSet {
+    std::string_view name;
+    const HideSet *next;
+};
+
+/// a preprocessing token, `text` points into the file it is lexed from or the `Preprocessor`
+struct PPToken {
+    enum Kind : uint8_t { Identifier, Number, Char, String, Punct, Other };
+
+    std::string_view text;
+    uint32_t line;   // 1-based
+    uint32_t column; // 0-based, in bytes
+    Kind kind;
+    bool line_start = false;   // first token of a line, so `#` starts a directive
+    bool space_before = false; // whitespace between it and the previous token
+    bool expanded = false;     // out of a macro expansion, `line` and `column` are of its use
+    const HideSet *hide_set = nullptr;
+};
+
+/// a source file lexed into preprocessing tokens, immutable once cached
+struct SourceFile {
+    std::string path;
+    std::string text;
+    std::vector<PPToken> tokens;
+    /// `X` if everything is inside `#ifndef X` / `#if !defined X` ... `#endif`. such a file is
+    /// skipped without looking at it once `X` is defined
+    std::string guard;
+
+    fs::file_time_type mtime;
+    uintmax_t size = 0;
+};
+
+/**
+ * Lexed headers shared by all compilations of a process, so a header is read and lexed once per
+ * `tinycc` run or `--serve` session. A cached header is read again only if its size or
+ * modification time changed. Thread-safe.
+ */
+class HeaderCache {
+public:
+    /// lexed `path`, which must be absolute and normalized. throws if it can't be read
+    std::shared_ptr<const SourceFile> get(fs::path const &path);
+
+private:
+    std::mutex m_mutex;
+    std::unordered_map<std::string, std::shared_ptr<const SourceFile>> m_files;
+};
+
+/// lex `text` of file `path` into preprocessing tokens
+std::shared_ptr<SourceFile> lexSourceFile(std::string path, std::string text);
+
+/**
+ * Preprocessor for `#include`, `#define`/`#undef` (object- and function-like macros, with `#`,
+ * `##` and `__VA_ARGS__`), `#if`/`#ifdef`/`#ifndef`/`#elif`/`#else`/`#endif`, `#pragma once` and
+ * `#error`, working on `PPToken`s. Its output is source text again, for `CLexer` or `FastLexer`.
+ *
+ * Lines of the main file keep their numbers in the output, so do the columns of tokens not
+ * preceded by an expanded macro on their line: the content of an included file is put on the
+ * line of its `#include`.
+ *
+ * Headers come from a `HeaderCache`. An included header with `#pragma once`, or with an include
+ * guard whose macro is defined, is skipped without touching it again.
+ */
+class Preprocessor {
+public:
+    /// `defines` are `NAME` or `NAME=VALUE`, as given to `-D`
+    Preprocessor(HeaderCache &headers, std::vector<std::string> include_dirs,
+                 std::vector<std::string> const &defines);
+    ~Preprocessor();
+
+    /// preprocess `source` of file `path`, throws on errors
+    std::string run(std::string_view source, std::string const &path);
+
+    /// define a macro from the text following `#define`, as given by `macroDefinitions`
+    void defineMacro(std::string_view definition);
+    /// the macros defined at this point, each as the text following `#define`
+    [[nodiscard]] std::vector<std::string> macroDefinitions() const;
+    /// headers `run` has looked at, including those skipped by their guard
+    [[nodiscard]] std::vector<std::shared_ptr<const SourceFile>> includedFiles() const;
+
+    /// whether `source` needs `run` at all: it has `#` or there are `defines`
+    [[nodiscard]] static bool needed(std::string_view source,
+                                     std::vector<std::string> const &defines);
+
+private:
+    struct Macro {
+        bool function_like = false;
+        bool variadic = false; // the last parameter is `__VA_ARGS__`
+        std::vector<std::string_view> params;
+        std::vector<PPToken> body;
+    };
+
+    struct Conditional {
+        bool taking;    // the current group is being output
+        bool was_taken; // one of the groups has been taken
+        bool seen_else;
+    };
+
+    struct FileState {
+        std::shared_ptr<const SourceFile> file;
+        size_t next = 0;              // next token
+        size_t conditional_depth = 0; // size of `m_conditionals` when the file was entered
+    };
+
+    // token stream: pushed back tokens first, then the files being included
+    std::optional<PPToken> next();
+    [[nodiscard]] const PPToken *peek() const;
+    [[nodiscard]] std::vector<PPToken> restOfLine();
+    void enterFile(std::shared_ptr<const SourceFile> file);
+
+    // directives
+    void directive(PPToken const &hash);
+    void define(std::vector<PPToken> const &line);
+    void include(PPToken const &hash, std::vector<PPToken> line);
+    void skipGroup(); // skip to the `#elif`, `#else` or `#endif` ending the current group
+    bool evaluate(PPToken const &hash, std::vector<PPToken> line);
+    std::optional<fs::path> resolve(std::string_view name, bool quoted);
+
+    // macro expansion
+    bool expand(PPToken const &token); // push the expansion of `token` back, if it is a macro
+    std::vector<std::vector<PPToken>> readArgs(PPToken const &name, Macro const &macro,
+                                               PPToken &rparen);
+    std::vector<PPToken> substitute(Macro const &macro,
+                                    std::vector<std::vector<PPToken>> const &args);
+    std::vector<PPToken> expandAll(std::vector<PPToken> tokens); // fully expand out of line
+    PPToken stringify(std::vector<PPToken> const &arg, PPToken const &at);
+    PPToken paste(PPToken const &lhs, PPToken const &rhs);
+    const HideSet *hideSetWith(const HideSet *set, std::string_view name);
+    const HideSet *hideSetUnion(const HideSet *a, const HideSet *b);
+    const HideSet *hideSetIntersection(const HideSet *a, const HideSet *b);
+    std::string_view save(std::string text); // keep synthesized token text alive
+
+    void syncLine(uint32_t line); // start line `line` of the main file in the output
+    void emit(PPToken const &token);
+    [[noreturn]] void error(PPToken const &at, std::string_view message) const;
+
+    HeaderCache &m_headers;
+    std::vector<std::string> m_include_dirs;
+
+    std::map<std::string, Macro, std::less<>> m_macros;
+    std::vector<PPToken> m_pending; // pushed back tokens, the next one is the last
+    std::vector<FileState> m_files; // include stack
+    bool m_detached = false;        // in `expandAll`, the stream ends with `m_pending`
+    std::vector<Conditional> m_conditionals;
+    std::unordered_map<std::string, std::optional<fs::path>> m_resolved; // `#include`d names
+    std::unordered_map<std::string, std::shared_ptr<const SourceFile>> m_included; // by path
+    std::unordered_set<std::string> m_once; // paths with `#pragma once`
+
+    std::deque<std::string> m_strings; // text of synthesized tokens
+    std::deque<HideSet> m_hide_sets;
+
+    std::string m_output;
+    uint32_t m_output_line = 1;   // line of the main file the output is at
+    uint32_t m_output_column = 0; // bytes output on that line
+    bool m_last_expanded = false; // whether the last token output came out of a macro
+};
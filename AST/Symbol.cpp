@@ -0,0 +1,86 @@
+#include "Symbol.h"
+
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cassert>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <unordered_map>
+
+namespace {
+
+/**
+ * Texts of all symbols. Lookups by text share a lock, only new texts take it exclusively.
+ *
+ * Texts by id are in chunks that never move, so `text()` needs no lock: an id is only known after
+ * interning it, which happens after its text was stored. Chunk `k` holds `2^(k + 10)` ids, so
+ * there are few chunks and they cover all 32-bit ids.
+ */
+class Interner {
+public:
+    Interner() {
+        for (auto name : {"", "int", "float", "char", "double", "void"}) intern(name);
+        assert(text(builtin::Void.id()) == "void" && "builtin symbols out of order");
+    }
+
+    uint32_t intern(std::string_view text) {
+        {
+            std::shared_lock lock{m_mutex};
+            if (auto it = m_ids.find(text); it != m_ids.end()) return it->second;
+        }
+
+        std::unique_lock lock{m_mutex};
+        if (auto it = m_ids.find(text); it != m_ids.end()) return it->second;
+        uint32_t id = m_size;
+        auto [chunk, index] = locate(id);
+        if (!m_chunks[chunk]) {
+            m_chunks[chunk] = std::make_unique<std::string_view[]>(size_t{1} << (chunk + 10));
+        }
+        std::string_view stored = m_texts.emplace_back(text);
+        m_chunks[chunk][index] = stored;
+        m_ids.emplace(stored, id);
+        m_size.store(id + 1, std::memory_order_release);
+        return id;
+    }
+
+    [[nodiscard]] std::string_view text(uint32_t id) const {
+        assert(id < m_size.load(std::memory_order_acquire) && "symbol was never interned");
+        auto [chunk, index] = locate(id);
+        return m_chunks[chunk][index];
+    }
+
+    [[nodiscard]] size_t size() const { return m_size.load(std::memory_order_acquire); }
+
+private:
+    static std::pair<unsigned, size_t> locate(uint32_t id) {
+        uint64_t biased = uint64_t{id} + 1024;
+        unsigned chunk = std::bit_width(biased) - 11;
+        return {chunk, biased - (uint64_t{1} << (chunk + 10))};
+    }
+
+    std::shared_mutex m_mutex;
+    std::unordered_map<std::string_view, uint32_t> m_ids; // views of `m_texts`
+    std::deque<std::string> m_texts;
+    std::array<std::unique_ptr<std::string_view[]>, 22> m_chunks;
+    std::atomic<uint32_t> m_size = 0;
+};
+
+Interner &interner() {
+    static Interner instance;
+    return instance;
+}
+
+} // namespace
+
+Symbol::Symbol(std::string_view text) : m_id(interner().intern(text)) {}
+
+std::string_view Symbol::str() const {
+    return interner().text(m_id);
+}
+
+size_t Symbol::count() {
+    return interner().size();
+}
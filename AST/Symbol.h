@@ -0,0 +1,65 @@
+#pragma once
+
+#include <fmt/format.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+
+/**
+ * An interned string: identifiers and type names of the AST. Each distinct string is stored once
+ * per process and numbered, the number stays the same for as long as the process runs. Symbols
+ * compare and hash as that number, only `str()` looks the text up again.
+ *
+ * Interning is thread-safe. `FastLexer` interns identifiers as it lexes them, `ASTBuilder` as it
+ * visits them. The builtin type names are interned before anything else, see `builtin`.
+ */
+class Symbol {
+public:
+    constexpr Symbol() = default; // the empty string
+    Symbol(std::string_view text);
+    Symbol(char const *text) : Symbol(std::string_view{text}) {}
+    Symbol(std::string const &text) : Symbol(std::string_view{text}) {}
+
+    /// the symbol numbered `id`, which must have been interned already
+    static constexpr Symbol fromId(uint32_t id) {
+        Symbol symbol;
+        symbol.m_id = id;
+        return symbol;
+    }
+    /// number of symbols interned so far, the empty one included
+    static size_t count();
+
+    [[nodiscard]] constexpr uint32_t id() const { return m_id; }
+    [[nodiscard]] constexpr bool empty() const { return m_id == 0; }
+    [[nodiscard]] std::string_view str() const;
+
+    friend constexpr bool operator==(Symbol lhs, Symbol rhs) = default;
+
+private:
+    uint32_t m_id = 0;
+};
+
+/// builtin type names, interned in this order when the first symbol is
+namespace builtin {
+constexpr Symbol Int = Symbol::fromId(1);
+constexpr Symbol Float = Symbol::fromId(2);
+constexpr Symbol Char = Symbol::fromId(3);
+constexpr Symbol Double = Symbol::fromId(4);
+constexpr Symbol Void = Symbol::fromId(5);
+} // namespace builtin
+
+template <>
+struct std::hash<Symbol> {
+    size_t operator()(Symbol symbol) const noexcept { return std::hash<uint32_t>{}(symbol.id()); }
+};
+
+template <>
+struct fmt::formatter<Symbol> : fmt::formatter<std::string_view> {
+    template <typename FormatContext>
+    auto format(Symbol symbol, FormatContext &ctx) const {
+        return fmt::formatter<std::string_view>::format(symbol.str(), ctx);
+    }
+};
@@ -0,0 +1,229 @@
+// checks of `CompactAST`, run by ctest:
+//   testCompactAST <include dir> <sources...>
+// each source must come back from its saved AST as it was flattened, then crafted ASTs that
+// passes and codegen couldn't walk must be refused by `view`, and the others accepted
+
+#include "CompactAST.h"
+#include "FastLexer.h"
+#include "FastParser.h"
+#include "Preprocessor.h"
+
+#include <fstream>
+#include <functional>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using Builder = CompactAST::Builder;
+using NodeId = CompactAST::NodeId;
+constexpr NodeId no_node = CompactAST::no_node;
+
+/// flattening the trees expanded from the saved AST of `source` must give the same bytes
+static bool roundTrip(std::string const &name, std::string const &source,
+                      std::string const &include_dir) {
+    try {
+        HeaderCache headers;
+        Preprocessor preprocessor{headers, {include_dir}, {}};
+        std::string text = source;
+        if (Preprocessor::needed(source, {})) text = preprocessor.run(source, name);
+        ASTArena arena;
+        auto decls = FastParser{text, FastLexer{text, name}.lex(), arena}.parse();
+        std::string bytes = CompactAST{decls}.serialize();
+
+        ASTArena expanded;
+        if (CompactAST{CompactAST::view(bytes, name).expand(expanded)}.serialize() != bytes) {
+            fmt::print(stderr, "{}: the saved AST doesn't expand to the same trees\n", name);
+            return false;
+        }
+    } catch (std::exception const &e) {
+        fmt::print(stderr, "{}: {}\n", name, e.what());
+        return false;
+    }
+    return true;
+}
+
+// pieces of the crafted ASTs, in `int f(int a)`
+
+static NodeId ref(Builder &out) {
+    return out.add(expr_kind<NameRef>, 0, {no_node, no_node, out.name("a"), no_node});
+}
+
+static NodeId one(Builder &out) { return out.add(ConstVar{1}); }
+
+static NodeId ret(Builder &out, NodeId value) {
+    return out.add(expr_kind<Return>, 0, {value, no_node, no_node, no_node});
+}
+
+static NodeId binary(Builder &out, Operators op, NodeId lhs, NodeId rhs) {
+    return out.add(expr_kind<Binary>, op, {lhs, rhs, no_node, no_node});
+}
+
+/// `int f(<params>)`, `int a` if there are none
+static NodeId proto(Builder &out, std::vector<NodeId> params = {}) {
+    if (params.empty()) {
+        params.push_back(out.add(expr_kind<Variable>, NONE,
+                                 {no_node, no_node, out.name("a"), out.name("int")}));
+    }
+    uint32_t first = out.list(params);
+    return out.add(expr_kind<FuncProto>, NONE,
+                   {first, static_cast<uint32_t>(params.size()), out.name("f"), out.name("int")});
+}
+
+static NodeId compound(Builder &out, std::vector<NodeId> const &stmts) {
+    uint32_t first = out.list(stmts);
+    return out.add(expr_kind<CompoundExpr>, 0,
+                   {first, static_cast<uint32_t>(stmts.size()), no_node, no_node});
+}
+
+/// `int f(int a) { <stmt> }` as the next root
+static void function(Builder &out, NodeId stmt) {
+    NodeId body = compound(out, {stmt});
+    out.root(out.add(expr_kind<FuncDef>, 0, {proto(out), body, no_node, no_node}));
+}
+
+struct Crafted {
+    const char *what;
+    bool valid;
+    std::function<void(Builder &)> build;
+};
+
+static bool craftedFiles() {
+    const std::vector<Crafted> cases{
+        {"function", true, [](Builder &out) { function(out, ret(out, ref(out))); }},
+        {"if without else", true,
+         [](Builder &out) {
+             NodeId cond = ref(out);
+             function(out, out.add(expr_kind<IfElse>, 0,
+                                   {cond, ret(out, one(out)), no_node, no_node}));
+         }},
+        {"return without value", true, [](Builder &out) { function(out, ret(out, no_node)); }},
+        {"for without init, condition and iteration", true,
+         [](Builder &out) {
+             NodeId body = out.add(expr_kind<Break>);
+             function(out, out.add(expr_kind<ForLoop>, 0, {no_node, no_node, no_node, body}));
+         }},
+        {"assignment to a name", true,
+         [](Builder &out) {
+             NodeId lhs = ref(out);
+             function(out, binary(out, Assign, lhs, one(out)));
+         }},
+        // a node taken twice would be expanded twice
+        {"operands sharing a node", false,
+         [](Builder &out) {
+             NodeId operand = ref(out);
+             function(out, ret(out, binary(out, Plus, operand, operand)));
+         }},
+        {"statements sharing a node", false,
+         [](Builder &out) {
+             NodeId stmt = ret(out, ref(out));
+             NodeId body = compound(out, {stmt, stmt});
+             out.root(out.add(expr_kind<FuncDef>, 0, {proto(out), body, no_node, no_node}));
+         }},
+        {"statement as a root too", false,
+         [](Builder &out) {
+             NodeId stmt = ret(out, ref(out));
+             function(out, stmt);
+             out.root(stmt);
+         }},
+        // children that are dereferenced
+        {"unary without operand", false,
+         [](Builder &out) { function(out, out.add(expr_kind<Unary>, Minus)); }},
+        {"binary without rhs", false,
+         [](Builder &out) { function(out, binary(out, Plus, ref(out), no_node)); }},
+        {"if without condition", false,
+         [](Builder &out) {
+             NodeId then = ret(out, one(out));
+             function(out, out.add(expr_kind<IfElse>, 0, {no_node, then, no_node, no_node}));
+         }},
+        {"if without then", false,
+         [](Builder &out) {
+             NodeId cond = ref(out);
+             function(out, out.add(expr_kind<IfElse>, 0, {cond, no_node, no_node, no_node}));
+         }},
+        {"while without body", false,
+         [](Builder &out) {
+             NodeId cond = ref(out);
+             function(out, out.add(expr_kind<WhileLoop>, 0, {cond, no_node, no_node, no_node}));
+         }},
+        {"for without body", false,
+         [](Builder &out) { function(out, out.add(expr_kind<ForLoop>)); }},
+        {"function without body", false,
+         [](Builder &out) {
+             out.root(out.add(expr_kind<FuncDef>, 0, {proto(out), no_node, no_node, no_node}));
+         }},
+        // children of the wrong kind
+        {"function with its proto and body swapped", false,
+         [](Builder &out) {
+             NodeId body = compound(out, {ret(out, ref(out))});
+             out.root(out.add(expr_kind<FuncDef>, 0, {body, proto(out), no_node, no_node}));
+         }},
+        {"assignment to an expression", false,
+         [](Builder &out) {
+             NodeId lhs = binary(out, Plus, ref(out), one(out));
+             function(out, binary(out, Assign, lhs, one(out)));
+         }},
+        {"variable initialized by a name", false,
+         [](Builder &out) {
+             NodeId init = ref(out);
+             NodeId var = out.add(expr_kind<Variable>, NONE,
+                                  {init, no_node, out.name("b"), out.name("int")});
+             uint32_t first = out.list({&var, 1});
+             out.root(out.add(expr_kind<InitExpr>, 0, {first, 1, no_node, no_node}));
+         }},
+        {"declaration of a name", false,
+         [](Builder &out) {
+             NodeId name = ref(out);
+             uint32_t first = out.list({&name, 1});
+             out.root(out.add(expr_kind<InitExpr>, 0, {first, 1, no_node, no_node}));
+         }},
+        {"parameter that isn't a variable", false,
+         [](Builder &out) {
+             NodeId body = compound(out, {ret(out, no_node)});
+             NodeId decl = proto(out, {ref(out)});
+             out.root(out.add(expr_kind<FuncDef>, 0, {decl, body, no_node, no_node}));
+         }},
+        {"statement as a root", false, [](Builder &out) { out.root(compound(out, {})); }},
+        {"empty name", false,
+         [](Builder &out) {
+             NodeId name =
+                 out.add(expr_kind<NameRef>, 0, {no_node, no_node, out.name(""), no_node});
+             function(out, ret(out, name));
+         }},
+    };
+
+    bool success = true;
+    for (const auto &crafted : cases) {
+        Builder out;
+        crafted.build(out);
+        std::string bytes = out.finish().serialize();
+        bool viewed = true;
+        try {
+            (void)CompactAST::view(bytes, crafted.what);
+        } catch (std::runtime_error const &) {
+            viewed = false;
+        }
+        if (viewed != crafted.valid) {
+            fmt::print(stderr, "{}: {}\n", crafted.what, viewed ? "accepted" : "refused");
+            success = false;
+        }
+    }
+    return success;
+}
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        fmt::print(stderr, "usage: testCompactAST <include dir> <sources...>\n");
+        return 1;
+    }
+
+    bool success = true;
+    for (int i = 2; i < argc; ++i) {
+        std::stringstream buffer;
+        buffer << std::ifstream{argv[i]}.rdbuf();
+        success = roundTrip(argv[i], buffer.str(), argv[1]) && success;
+    }
+    success = craftedFiles() && success;
+
+    fmt::print("{}\n", success ? "passed" : "FAILED");
+    return success ? 0 : 1;
+}
@@ -2,26 +2,16 @@
 #include "AST.hpp"
 #include "ASTSimplify.h"
 #include "CFGDotPrinter.h"
+#include "CompactAST.h"
 #include "DeadBlockRemove.h"
-#include "OptHandler.h"
 #include "utility.hpp"
 
-using namespace llvm;
-
-extern OptHandler cli_inputs;
+#include "llvm/ADT/DenseSet.h"
+#include "llvm/Bitcode/BitcodeReader.h"
+#include "llvm/Bitcode/BitcodeWriter.h"
+#include "llvm/Transforms/Utils/SplitModule.h"
 
-struct loop_BB_manager { // RAII loop basic block manager
-    inline static BasicBlock *continueBB = nullptr, *breakBB = nullptr;
-    BasicBlock *tmp_head, *tmp_tail;
-    loop_BB_manager(BasicBlock *conti, BasicBlock *brk) : tmp_head(conti), tmp_tail(brk) {
-        std::swap(continueBB, tmp_head);
-        std::swap(breakBB, tmp_tail);
-    }
-    ~loop_BB_manager() {
-        std::swap(continueBB, tmp_head);
-        std::swap(breakBB, tmp_tail);
-    }
-};
+using namespace llvm;
 
 static PassBuilder::OptimizationLevel int2OptLevel(int opt_level) {
     switch (opt_level) {
@@ -38,11 +28,11 @@ TypeTable::TypeTable(llvm::LLVMContext &ctx) {
     push_scope();
 
     // add primitive types
-    symbols[0].insert({"int", llvm::Type::getInt32Ty(ctx)});
-    symbols[0].insert({"float", llvm::Type::getFloatTy(ctx)});
-    symbols[0].insert({"char", llvm::Type::getInt8Ty(ctx)});
-    symbols[0].insert({"double", llvm::Type::getDoubleTy(ctx)});
-    symbols[0].insert({"void", llvm::Type::getVoidTy(ctx)});
+    symbols[0].insert({builtin::Int.id(), llvm::Type::getInt32Ty(ctx)});
+    symbols[0].insert({builtin::Float.id(), llvm::Type::getFloatTy(ctx)});
+    symbols[0].insert({builtin::Char.id(), llvm::Type::getInt8Ty(ctx)});
+    symbols[0].insert({builtin::Double.id(), llvm::Type::getDoubleTy(ctx)});
+    symbols[0].insert({builtin::Void.id(), llvm::Type::getVoidTy(ctx)});
 }
 
 TypeTable::~TypeTable() {
@@ -50,7 +40,7 @@ TypeTable::~TypeTable() {
     pop_scope();
 }
 
-void TypeTable::insert(llvm::StringRef type_name, llvm::Type *type) {
+void TypeTable::insert(Symbol type_name, llvm::Type *type) {
     assert(!symbols.empty() && "No scope available for variable insertion!");
     if (inCurrScope(type_name)) {
         Type *previous_type = operator[](type_name);
@@ -59,55 +49,64 @@ void TypeTable::insert(llvm::StringRef type_name, llvm::Type *type) {
         }
         return;
     }
-    symbols.back().insert({type_name, type});
+    symbols.back().insert({type_name.id(), type});
 }
 
-// ------------ Implementation of `IRGenerator` -------------------
+// ------------ Implementation of `IRToolchain` -------------------
 
-IRGenerator::IRGenerator(std::vector<std::shared_ptr<Expr>> const &trees)
-    : m_simplifiedAST(trees), m_context_ptr(std::make_unique<llvm::LLVMContext>()),
-      m_module_ptr(std::make_unique<llvm::Module>("tinycc JIT", *m_context_ptr)),
-      m_builder_ptr(std::make_unique<llvm::IRBuilder<>>(*m_context_ptr)),
-      m_analysis(std::make_unique<IRAnalysis>()),
-      m_symbolTable_ptr(std::make_unique<SymbolTable>()),
-      m_typeTable_ptr(std::make_unique<TypeTable>(*m_context_ptr)) {
+void IRAnalysis::clear() {
+    LAM.clear();
+    FAM.clear();
+    CGAM.clear();
+    MAM.clear();
+}
 
-    /// trivial heuristic transform on AST
-    simplifyAST(m_simplifiedAST);
+IRToolchain::IRToolchain(CompileOptions const &opts) : m_opts(opts) {
+    initializeTargets();
+
+    m_target_machine = createTargetMachine();
 
     /// LLVM Pass (New PM)
-    PassBuilder PB;
-    PB.registerModuleAnalyses(m_analysis->MAM);
-    PB.registerCGSCCAnalyses(m_analysis->CGAM);
-    PB.registerFunctionAnalyses(m_analysis->FAM);
-    PB.registerLoopAnalyses(m_analysis->LAM);
-    PB.crossRegisterProxies(m_analysis->LAM, m_analysis->FAM, m_analysis->CGAM, m_analysis->MAM);
-
-    if (cli_inputs.emitCFG) {
+    registerTraceCallbacks();
+    PassBuilder PB(nullptr, PipelineTuningOptions(), None, &m_instrumentation);
+    PB.registerModuleAnalyses(m_analysis.MAM);
+    PB.registerCGSCCAnalyses(m_analysis.CGAM);
+    PB.registerFunctionAnalyses(m_analysis.FAM);
+    PB.registerLoopAnalyses(m_analysis.LAM);
+    PB.crossRegisterProxies(m_analysis.LAM, m_analysis.FAM, m_analysis.CGAM, m_analysis.MAM);
+
+    if (m_opts.emitCFG) {
         PB.registerOptimizerLastEPCallback(
             [&](ModulePassManager &MPM, PassBuilder::OptimizationLevel level) {
-                MPM.addPass(createModuleToFunctionPassAdaptor(CFGDotPrinterPass{}));
+                MPM.addPass(
+                    createModuleToFunctionPassAdaptor(CFGDotPrinterPass{m_opts.pic_outdir}));
             });
     }
 
-    if (cli_inputs.opt_level) {
-        m_optimizer = std::make_unique<ModulePassManager>(
-            PB.buildPerModuleDefaultPipeline(int2OptLevel(cli_inputs.opt_level)));
-    } else { // disable opt: O0 isn't allowed by module default pipeline builder
-        m_optimizer = std::make_unique<ModulePassManager>(
-            PB.buildO0DefaultPipeline(PassBuilder::OptimizationLevel::O0));
+    if (!m_opts.opt_level) { // disable opt: O0 isn't allowed by module default pipeline builder
+        m_optimizer = PB.buildO0DefaultPipeline(PassBuilder::OptimizationLevel::O0,
+                                                m_opts.thinLTO);
+    } else if (m_opts.thinLTO) { // the rest runs in the ThinLTO backends of the linker
+        m_optimizer = PB.buildThinLTOPreLinkDefaultPipeline(int2OptLevel(m_opts.opt_level));
+    } else {
+        m_optimizer = PB.buildPerModuleDefaultPipeline(int2OptLevel(m_opts.opt_level));
     }
 }
 
-void IRGenerator::emitOBJ(fs::path const &asm_path) {
-    InitializeAllTargetInfos();
-    InitializeAllTargets();
-    InitializeAllTargetMCs();
-    InitializeAllAsmParsers();
-    InitializeAllAsmPrinters();
+void IRToolchain::initializeTargets() {
+    static std::once_flag initialized;
+    std::call_once(initialized, [] {
+        InitializeAllTargetInfos();
+        InitializeAllTargets();
+        InitializeAllTargetMCs();
+        InitializeAllAsmParsers();
+        InitializeAllAsmPrinters();
+    });
+}
 
-    // construct target machine
-    auto targetTriple = llvm::sys::getDefaultTargetTriple();
+std::unique_ptr<TargetMachine> IRToolchain::createTargetMachine() {
+    initializeTargets();
+    auto targetTriple = IRToolchain::targetTriple();
 
     std::string error;
     auto target = TargetRegistry::lookupTarget(targetTriple, error);
@@ -116,42 +115,184 @@ void IRGenerator::emitOBJ(fs::path const &asm_path) {
         throw_err<std::runtime_error>("Failed to initialize target: {}", error);
     }
 
-    auto CPU = "x86-64-v3";
+    auto CPU = target_cpu;
     auto features = "";
     TargetOptions opt;
     auto RM = Optional<Reloc::Model>();
-    auto targetMachine = target->createTargetMachine(targetTriple, CPU, features, opt, RM);
+    return std::unique_ptr<TargetMachine>(
+        target->createTargetMachine(targetTriple, CPU, features, opt, RM));
+}
 
-    // set module target
-    m_module_ptr->setTargetTriple(targetTriple);
-    m_module_ptr->setDataLayout(targetMachine->createDataLayout());
+std::string IRToolchain::targetTriple() {
+    return llvm::sys::getDefaultTargetTriple();
+}
 
-    // open file to emit
-    std::error_code ec;
-    raw_fd_ostream out(asm_path.native(), ec);
+bool IRToolchain::compatible(CompileOptions const &opts) const {
+    return m_opts.opt_level == opts.opt_level && m_opts.thinLTO == opts.thinLTO &&
+           m_opts.emitCFG == opts.emitCFG &&
+           (!opts.emitCFG || m_opts.pic_outdir == opts.pic_outdir);
+}
+
+void IRToolchain::registerTraceCallbacks() {
+    m_instrumentation.registerBeforeNonSkippedPassCallback([this](StringRef pass, Any IR) {
+        StringRef detail;
+        if (any_isa<const Function *>(IR)) {
+            detail = any_cast<const Function *>(IR)->getName();
+        } else if (any_isa<const Module *>(IR)) {
+            detail = any_cast<const Module *>(IR)->getName();
+        }
+        m_pass_spans.push_back(std::make_unique<trace::Scope>(pass, detail));
+    });
+    m_instrumentation.registerAfterPassCallback(
+        [this](StringRef, Any, const PreservedAnalyses &) { m_pass_spans.pop_back(); });
+    m_instrumentation.registerAfterPassInvalidatedCallback(
+        [this](StringRef, const PreservedAnalyses &) { m_pass_spans.pop_back(); });
+}
+
+void IRToolchain::optimize(Module &module) {
+    trace::Scope span{"Optimize"};
+    m_optimizer.run(module, m_analysis.MAM);
+    m_analysis.clear();
+}
+
+void IRToolchain::writeThinLTOBitcode(Module &module, raw_ostream &out) {
+    ThinLTOBitcodeWriterPass{out, nullptr}.run(module, m_analysis.MAM);
+    m_analysis.clear();
+}
+
+// ------------ Implementation of `IRGenerator` -------------------
+
+IRGenerator::IRGenerator(IRToolchain &toolchain, std::string const &source_name)
+    : m_toolchain(toolchain),
+      m_context_ptr(std::make_unique<llvm::LLVMContext>()),
+      m_module_ptr(std::make_unique<llvm::Module>("tinycc JIT", *m_context_ptr)),
+      m_builder_ptr(std::make_unique<llvm::IRBuilder<>>(*m_context_ptr)),
+      m_symbolTable_ptr(std::make_unique<SymbolTable>()),
+      m_typeTable_ptr(std::make_unique<TypeTable>(*m_context_ptr)) {
+    if (!source_name.empty()) m_module_ptr->setSourceFileName(source_name);
+}
+
+IRGenerator::IRGenerator(ASTSnapshot const &ast, IRToolchain &toolchain,
+                         std::string const &source_name)
+    : IRGenerator(toolchain, source_name) {
+    /// trivial heuristic transform on AST
+    trace::Scope span{"SimplifyAST"};
+    auto arena = std::make_shared<ASTArena>();
+    auto simplified = simplifyAST(ast.decls(), *arena);
+    m_simplifiedAST = ast.derive(std::move(simplified), std::move(arena));
+}
+
+IRGenerator::IRGenerator(CompactAST const &ast, IRToolchain &toolchain,
+                         std::string const &source_name)
+    : IRGenerator(toolchain, source_name) {
+    trace::Scope span{"SimplifyAST"};
+    auto arena = std::make_shared<ASTArena>();
+    auto simplified = simplifyAST(ast).expand(*arena);
+    m_simplifiedAST = ASTSnapshot{{simplified.begin(), simplified.end()}, {std::move(arena)}};
+}
+
+void IRGenerator::setModuleTarget() {
+    auto &targetMachine = m_toolchain.targetMachine();
+    m_module_ptr->setTargetTriple(targetMachine.getTargetTriple().str());
+    m_module_ptr->setDataLayout(targetMachine.createDataLayout());
+}
 
+static void writeObject(TargetMachine &targetMachine, Module &module, fs::path const &obj_path) {
+    std::error_code ec;
+    raw_fd_ostream out(obj_path.native(), ec);
     if (ec) {
-        fmt::print(stderr,
-                   "Error Category: {}, Code: {}, Message: {}\n",
-                   ec.category().name(),
-                   ec.value(),
-                   ec.message());
+        throw_err<std::runtime_error>("cannot open '{}': {}", obj_path.native(), ec.message());
     }
 
     legacy::PassManager pass;
     auto fileType = CGFT_ObjectFile;
 
-    if (targetMachine->addPassesToEmitFile(pass, out, nullptr, fileType)) {
+    if (targetMachine.addPassesToEmitFile(pass, out, nullptr, fileType)) {
         throw_err<std::runtime_error>("target machine can't emit a file of this type");
     }
 
-    pass.run(*m_module_ptr);
+    pass.run(module);
     out.flush();
+}
+
+void IRGenerator::emitOBJ(fs::path const &asm_path) {
+    trace::Scope span{"EmitOBJ", asm_path.native()};
+    setModuleTarget();
+    writeObject(m_toolchain.targetMachine(), *m_module_ptr, asm_path);
 
     dbg_print("[DEBUG] obj file is written to {}\n", asm_path.native());
 }
 
+std::vector<fs::path> IRGenerator::emitOBJParts(std::string const &stem, unsigned n_parts) {
+    trace::Scope span{"EmitOBJ", stem};
+    setModuleTarget();
+
+    // partitions live in our context, which can't be shared across threads: pass them as bitcode.
+    // Locals stay local, each in the partition of its users, or `static` functions of different
+    // units (or sharing a name with an external one) would clash once the units are linked
+    std::vector<SmallString<0>> bitcodes;
+    {
+        trace::Scope split_span{"SplitModule"};
+        SplitModule(
+            *m_module_ptr,
+            n_parts,
+            [&](std::unique_ptr<Module> part) {
+                raw_svector_ostream out{bitcodes.emplace_back()};
+                WriteBitcodeToFile(*part, out);
+            },
+            true);
+    }
+
+    std::vector<fs::path> obj_paths;
+    for (size_t i = 0; i < bitcodes.size(); ++i) {
+        obj_paths.emplace_back(fmt::format("{}.part{}.o", stem, i));
+    }
+
+    // each partition gets its own context and `TargetMachine`
+    std::vector<std::string> errors(bitcodes.size());
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < bitcodes.size(); ++i) {
+        threads.emplace_back([&, i] {
+            trace::ThreadScope thread_trace;
+            trace::Scope part_span{"EmitOBJPart", obj_paths[i].native()};
+            try {
+                LLVMContext context;
+                auto part = parseBitcodeFile(MemoryBufferRef{bitcodes[i], stem}, context);
+                if (!part) {
+                    throw_err<std::runtime_error>("cannot read partition: {}",
+                                                  toString(part.takeError()));
+                }
+                writeObject(*IRToolchain::createTargetMachine(), **part, obj_paths[i]);
+            } catch (std::exception const &e) {
+                errors[i] = e.what();
+            }
+        });
+    }
+    for (auto &thread : threads) thread.join();
+
+    for (const auto &error : errors) {
+        if (!error.empty()) throw_err<std::runtime_error>("{}", error);
+    }
+    dbg_print("[DEBUG] {} obj file partitions are written for {}\n", obj_paths.size(), stem);
+    return obj_paths;
+}
+
+void IRGenerator::emitBitcode(fs::path const &bc_path) {
+    trace::Scope span{"EmitBitcode", bc_path.native()};
+    setModuleTarget();
+
+    std::error_code ec;
+    raw_fd_ostream out(bc_path.native(), ec);
+    if (ec) {
+        throw_err<std::runtime_error>("cannot open '{}': {}", bc_path.native(), ec.message());
+    }
+    m_toolchain.writeThinLTOBitcode(*m_module_ptr, out);
+
+    dbg_print("[DEBUG] bitcode is written to {}\n", bc_path.native());
+}
+
 void IRGenerator::dumpIR(fs::path const &asm_path) const {
+    trace::Scope span{"DumpIR", asm_path.native()};
     std::error_code ec;
     raw_fd_ostream out(asm_path.native(), ec);
     if (!ec) {
@@ -175,6 +316,10 @@ std::string IRGenerator::dumpIRString() const {
     return out.str();
 }
 
+orc::ThreadSafeModule IRGenerator::takeModule() {
+    return orc::ThreadSafeModule(std::move(m_module_ptr), std::move(m_context_ptr));
+}
+
 void IRGenerator::emitBlock(BasicBlock *BB, bool IsFinished) {
     auto &Builder = *m_builder_ptr;
 
@@ -207,9 +352,10 @@ void IRGenerator::emitBlock(BasicBlock *BB, bool IsFinished) {
     Builder.SetInsertPoint(BB);
 }
 
-void IRGenerator::codegen() {
-    for (const auto &tree : m_simplifiedAST) {
+void IRGenerator::codegen(bool optimize) {
+    for (const auto *tree : m_simplifiedAST.decls()) {
         if (tree->is<InitExpr>()) {
+            trace::Scope span{"Codegen", "<globals>"};
             // global vars
             for (const auto &p_node : tree->as<InitExpr>()) {
                 const auto &var = p_node->as<Variable>();
@@ -221,7 +367,7 @@ void IRGenerator::codegen() {
                 }
 
                 auto *globalVar = cast<GlobalVariable>(
-                    m_module_ptr->getOrInsertGlobal(var.m_var_name, var_type) //
+                    m_module_ptr->getOrInsertGlobal(var.m_var_name.str(), var_type) //
                 );
                 if (var.m_var_init) {
                     auto init = cast<Constant>(codegenVisitor(*var.m_var_init));
@@ -233,11 +379,77 @@ void IRGenerator::codegen() {
             }
         } else {
             // a func
+            trace::Scope span{"Codegen",
+                              tree->is<FuncDef>() ? tree->as<FuncDef>().getName().str() : ""};
             codegenVisitor(*tree);
         }
     }
+    m_simplifiedAST = {}; // the trees may be freed from now on
+
+    if (optimize) m_toolchain.optimize(*m_module_ptr);
+}
 
-    m_optimizer->run(*m_module_ptr, m_analysis->MAM);
+/// whether functions of `a` and `b` get the same `llvm::Function`, but for argument names
+static bool sameSignature(FuncProto const &a, FuncProto const &b) {
+    auto type_of = [](auto const &p_para) { return p_para->template as<Variable>().m_var_type; };
+    return a.m_storage == b.m_storage && a.m_return_type == b.m_return_type &&
+           std::equal(a.m_para_list.begin(), a.m_para_list.end(), b.m_para_list.begin(),
+                      b.m_para_list.end(), [&](auto const &x, auto const &y) {
+                          return type_of(x) == type_of(y);
+                      });
+}
+
+bool IRGenerator::updateFunctions(std::vector<Expr *> const &removed,
+                                  std::vector<Expr *> const &added) {
+    auto is_func_def = [](auto const &decl) { return decl->template is<FuncDef>(); };
+    if (!std::all_of(removed.begin(), removed.end(), is_func_def) ||
+        !std::all_of(added.begin(), added.end(), is_func_def)) {
+        return false;
+    }
+
+    // a removed function may still be called, and a function defined elsewhere can't be
+    // defined again. other functions are compiled against the signatures in the module
+    DenseMap<uint32_t, FuncProto const *> removed_protos; // by `Symbol::id()`
+    for (const auto &decl : removed) {
+        const auto &proto = decl->as<FuncDef>().m_proto->as<FuncProto>();
+        removed_protos[proto.m_name.id()] = &proto;
+    }
+    DenseSet<uint32_t> added_names;
+    for (const auto &decl : added) {
+        const auto &proto = decl->as<FuncDef>().m_proto->as<FuncProto>();
+        if (!added_names.insert(proto.m_name.id()).second) return false;
+
+        if (auto it = removed_protos.find(proto.m_name.id()); it != removed_protos.end()) {
+            if (!sameSignature(*it->second, proto)) return false;
+        } else if (m_module_ptr->getFunction(proto.m_name.str())) {
+            return false;
+        }
+    }
+    for (const auto &[name, proto] : removed_protos) {
+        if (!added_names.contains(name)) return false;
+    }
+
+    for (const auto &[name, proto] : removed_protos) {
+        Function *p_func = m_module_ptr->getFunction(proto->m_name.str());
+        auto linkage = p_func->getLinkage(); // reset by `deleteBody`
+        p_func->deleteBody();
+        p_func->setLinkage(linkage);
+    }
+
+    ASTArena arena; // of the simplified copies
+    for (const auto *decl : simplifyAST({added.begin(), added.end()}, arena)) {
+        const auto &func_def = decl->as<FuncDef>();
+        trace::Scope span{"Codegen", func_def.getName().str()};
+        // arguments of the old body may be named differently
+        if (Function *p_func = m_module_ptr->getFunction(func_def.getName().str())) {
+            const auto &para_list = func_def.m_proto->as<FuncProto>().m_para_list;
+            for (size_t i = 0; auto &arg : p_func->args()) {
+                arg.setName(para_list[i++]->as<Variable>().m_var_name.str());
+            }
+        }
+        codegenVisitor(*decl);
+    }
+    return true;
 }
 
 static bool isFloat(Value *val) {
@@ -253,9 +465,9 @@ Value *IRGenerator::boolCast(Value *val) { // NOTE: ad-hoc bool cast
     auto &builder = *m_builder_ptr;
     auto &typeTable = *m_typeTable_ptr;
     Type *type = val->getType();
-    if (type == typeTable["int"] || type == typeTable["char"]) {
+    if (type == typeTable[builtin::Int] || type == typeTable[builtin::Char]) {
         return builder.CreateICmpNE(val, ConstantInt::get(type, 0), "bool_cast");
-    } else if (type == typeTable["float"] || type == typeTable["double"]) {
+    } else if (type == typeTable[builtin::Float] || type == typeTable[builtin::Double]) {
         // QUESTION: comparison relaxation for float?
         return builder.CreateFCmpONE(val, ConstantFP::get(type, 0), "bool_cast");
     }
@@ -284,13 +496,13 @@ Value *IRGenerator::codegenVisitor(const Expr &expr) {
             llvm_unreachable("Unsupported ConstVar type!");
         },
         [&, this](FuncProto const &func_proto) -> Value * {
-            Function *p_func = module.getFunction(func_proto.m_name);
+            Function *p_func = module.getFunction(func_proto.m_name.str());
 
             if (!p_func) { // generate func proto if not exist
                 SmallVector<Type *> funcArgsTypes;
                 for (const auto &p_para : func_proto.m_para_list) {
                     const auto &para = p_para->as<Variable>();
-                    if (para.m_var_type != "void") { // skip Void param
+                    if (para.m_var_type != builtin::Void) { // skip Void param
                         funcArgsTypes.push_back(typeTable[para.m_var_type]);
                     }
                 }
@@ -306,10 +518,10 @@ Value *IRGenerator::codegenVisitor(const Expr &expr) {
                                                         ? Function::InternalLinkage
                                                         : Function::ExternalLinkage;
 
-                p_func = Function::Create(func_type, linkage, func_proto.m_name, module);
+                p_func = Function::Create(func_type, linkage, func_proto.m_name.str(), module);
 
                 for (size_t i = 0; auto &arg : p_func->args()) {
-                    arg.setName(func_proto.m_para_list[i++]->as<Variable>().m_var_name);
+                    arg.setName(func_proto.m_para_list[i++]->as<Variable>().m_var_name.str());
                 }
             }
 
@@ -333,11 +545,11 @@ Value *IRGenerator::codegenVisitor(const Expr &expr) {
             scope_manager scope_mgr(*this);
 
             // params
-            for (auto &arg : p_func->args()) {
+            const auto &para_list = func_node.m_proto->as<FuncProto>().m_para_list;
+            for (size_t i = 0; auto &arg : p_func->args()) {
                 Type *argType = arg.getType();
-                StringRef argName = arg.getName();
-                AllocaInst *alloc = builder.CreateAlloca(argType, nullptr, argName);
-                symTable.insert(argName, alloc);
+                AllocaInst *alloc = builder.CreateAlloca(argType, nullptr, arg.getName());
+                symTable.insert(para_list[i++]->as<Variable>().m_var_name, alloc);
                 builder.CreateStore(&arg, alloc);
             }
 
@@ -361,14 +573,14 @@ Value *IRGenerator::codegenVisitor(const Expr &expr) {
             auto *var_ref = symTable[var_name];
             if (!var_ref) {
                 // check if it's global
-                if (auto *global = module.getNamedGlobal(var_name)) {
+                if (auto *global = module.getNamedGlobal(var_name.str())) {
                     // NOTE: global->getType() is a pointer type
-                    return builder.CreateLoad(global->getValueType(), global, var_name.c_str());
+                    return builder.CreateLoad(global->getValueType(), global, var_name.str());
                 }
                 // report error: ref to var that doesn't exist
                 throw_err("Try to use undeclared var:{}\n", var_name);
             } else {
-                return builder.CreateLoad(var_ref->getAllocatedType(), var_ref, var_name.c_str());
+                return builder.CreateLoad(var_ref->getAllocatedType(), var_ref, var_name.str());
             }
         },
         [this](InitExpr const &var_decls) -> Value * {
@@ -392,7 +604,7 @@ Value *IRGenerator::codegenVisitor(const Expr &expr) {
                 return nullptr;
             }
 
-            AllocaInst *p_new_var = builder.CreateAlloca(var_type, nullptr, var.m_var_name);
+            AllocaInst *p_new_var = builder.CreateAlloca(var_type, nullptr, var.m_var_name.str());
             if (!p_new_var) [[unlikely]] {
                 throw_err<std::runtime_error>("Interal compiler error: failed to allocate '{}'\n",
                                               var.m_var_name);
@@ -424,7 +636,7 @@ Value *IRGenerator::codegenVisitor(const Expr &expr) {
         },
         [&, this](FuncCall const &func_call) -> Value * {
             // Look up the name in the global module table.
-            Function *CalleeF = module.getFunction(func_call.m_func_name);
+            Function *CalleeF = module.getFunction(func_call.m_func_name.str());
             if (!CalleeF) {
                 throw_err("Unknown function `{}` referenced", func_call.m_func_name);
             }
@@ -446,7 +658,9 @@ Value *IRGenerator::codegenVisitor(const Expr &expr) {
                 ArgsV.push_back(argVal);
             }
 
-            return builder.CreateCall(CalleeF, ArgsV, "calltmp");
+            // a void result can't be named, bitcode of such a call doesn't read back
+            bool is_void = CalleeF->getReturnType()->isVoidTy();
+            return builder.CreateCall(CalleeF, ArgsV, is_void ? "" : "calltmp");
         },
         [&, this](Binary const &exp) -> Value * {
             // refactor? builder.CreateBinOp(llvm::BinaryOperator::Add);
@@ -458,8 +672,8 @@ Value *IRGenerator::codegenVisitor(const Expr &expr) {
             // if either is float, convert them to floats
             bool is_f_left = isFloat(lhs), is_f_right = isFloat(rhs);
             bool is_f = is_f_left || is_f_right;
-            if (is_f && !is_f_left) builder.CreateSIToFP(lhs, typeTable["float"]);
-            if (is_f && !is_f_right) builder.CreateSIToFP(rhs, typeTable["float"]);
+            if (is_f && !is_f_left) builder.CreateSIToFP(lhs, typeTable[builtin::Float]);
+            if (is_f && !is_f_right) builder.CreateSIToFP(rhs, typeTable[builtin::Float]);
 
             switch (exp.m_operator) {
             case Plus: return builder.CreateAdd(lhs, rhs, "add");
@@ -530,9 +744,9 @@ Value *IRGenerator::codegenVisitor(const Expr &expr) {
                 }
 
                 // extract var ref
-                StringRef var_name = exp.m_operand1->as<NameRef>();
+                NameRef var_name = exp.m_operand1->as<NameRef>();
                 Value *var_ref = symTable[var_name];
-                if (!var_ref) var_ref = module.getNamedGlobal(var_name);
+                if (!var_ref) var_ref = module.getNamedGlobal(var_name.str());
                 if (!var_ref) throw_err("Try to use undeclared var:{}\n", var_name);
 
                 return builder.CreateStore(rhs, var_ref);
@@ -578,10 +792,8 @@ Value *IRGenerator::codegenVisitor(const Expr &expr) {
 
             return nullptr;
         },
-        [&, this](Break const &) -> Value * { return builder.CreateBr(loop_BB_manager::breakBB); },
-        [&, this](Continue const &) -> Value * {
-            return builder.CreateBr(loop_BB_manager::continueBB);
-        },
+        [&, this](Break const &) -> Value * { return builder.CreateBr(m_breakBB); },
+        [&, this](Continue const &) -> Value * { return builder.CreateBr(m_continueBB); },
         [&, this](WhileLoop const &while_loop) -> Value * {
             /**
              *      ...
@@ -605,7 +817,7 @@ Value *IRGenerator::codegenVisitor(const Expr &expr) {
             auto *loopBB = BasicBlock::Create(context, "loop");
             auto *latchBB = BasicBlock::Create(context, "latch");
             auto *loopEndBB = BasicBlock::Create(context, "loop_end");
-            loop_BB_manager BB_mgr(latchBB, loopEndBB);
+            loop_BB_manager BB_mgr(*this, latchBB, loopEndBB);
 
             builder.CreateCondBr(cond_val, loopBB, loopEndBB);
 
@@ -649,7 +861,7 @@ Value *IRGenerator::codegenVisitor(const Expr &expr) {
             auto *loopBB = BasicBlock::Create(context, "loop");
             auto *latchBB = BasicBlock::Create(context, "latch");
             auto *loopEndBB = BasicBlock::Create(context, "loop_end");
-            loop_BB_manager BB_mgr(latchBB, loopEndBB);
+            loop_BB_manager BB_mgr(*this, latchBB, loopEndBB);
 
             // loop entry
             if (for_loop.m_condi) {
@@ -1,23 +1,28 @@
 #pragma once
 
 #include "AST.hpp"
+#include "ASTSnapshot.h"
+#include "OptHandler.h"
+#include "Trace.h"
 
 namespace fs = std::filesystem;
 
+class CompactAST;
+
 template <typename T>
 class SymbolTableMixin {
 public:
     void push_scope();
     void pop_scope();
 
-    [[nodiscard]] bool inCurrScope(llvm::StringRef sym_name) const;
-    void insert(llvm::StringRef sym_name, T val);
+    [[nodiscard]] bool inCurrScope(Symbol sym_name) const;
+    void insert(Symbol sym_name, T val);
 
     // array-like read
-    T operator[](llvm::StringRef sym_name) const;
+    T operator[](Symbol sym_name) const;
 
 protected:
-    llvm::SmallVector<llvm::StringMap<T>> symbols;
+    llvm::SmallVector<llvm::DenseMap<uint32_t, T>> symbols; // by `Symbol::id()`
 };
 
 class SymbolTable : public SymbolTableMixin<llvm::AllocaInst *> {};
@@ -27,9 +32,9 @@ public:
     TypeTable(llvm::LLVMContext &ctx);
     ~TypeTable();
 
-    void insert(llvm::StringRef type_name, llvm::Type *type);
+    void insert(Symbol type_name, llvm::Type *type);
 
-    llvm::Type *operator[](llvm::StringRef type_name) const {
+    llvm::Type *operator[](Symbol type_name) const {
         auto ret = SymbolTableMixin::operator[](type_name);
         if (ret == nullptr) throw_err("Unknown type name '{}'", type_name);
         return ret;
@@ -41,38 +46,94 @@ struct IRAnalysis {
     llvm::FunctionAnalysisManager FAM;
     llvm::CGSCCAnalysisManager CGAM;
     llvm::ModuleAnalysisManager MAM;
+
+    /// drop cached results, they are keyed by pointers into a module that is going away
+    void clear();
+};
+
+/// LLVM state that outlives a single translation unit: target machine, analysis managers and
+/// the optimization pipeline. It isn't thread-safe, use one per worker.
+class IRToolchain {
+public:
+    explicit IRToolchain(CompileOptions const &opts);
+
+    static constexpr std::string_view target_cpu = "x86-64-v3";
+
+    /// register LLVM targets, safe to call from multiple threads
+    static void initializeTargets();
+    [[nodiscard]] static std::string targetTriple();
+    [[nodiscard]] static std::unique_ptr<llvm::TargetMachine> createTargetMachine();
+
+    /// whether the pipeline is built for the same options that affect codegen
+    [[nodiscard]] bool compatible(CompileOptions const &opts) const;
+
+    void optimize(llvm::Module &module);
+    void writeThinLTOBitcode(llvm::Module &module, llvm::raw_ostream &out);
+    llvm::TargetMachine &targetMachine() { return *m_target_machine; }
+
+private:
+    void registerTraceCallbacks();
+
+    CompileOptions m_opts;
+    std::unique_ptr<llvm::TargetMachine> m_target_machine;
+    llvm::PassInstrumentationCallbacks m_instrumentation;
+    std::vector<std::unique_ptr<trace::Scope>> m_pass_spans; // spans of running passes
+    IRAnalysis m_analysis;
+    llvm::ModulePassManager m_optimizer;
 };
 
 class IRGenerator {
 public:
     IRGenerator() = delete;
-    IRGenerator(std::vector<std::shared_ptr<Expr>> const &trees);
-
-    void codegen();
+    /// `ast` is simplified into a version of its own, others may go on reading `ast` meanwhile.
+    /// `source_name` is the source file of the module, whose stem prefixes the `--emit-cfg` pics
+    IRGenerator(ASTSnapshot const &ast, IRToolchain &toolchain,
+                std::string const &source_name = "");
+    /// `ast` is simplified in its flat form, only the simplified trees are expanded for codegen
+    IRGenerator(CompactAST const &ast, IRToolchain &toolchain,
+                std::string const &source_name = "");
+
+    /// generate IR of all declarations, then optimize it unless `optimize` is false
+    void codegen(bool optimize = true);
+    /// replace the functions defined by `removed` with those defined by `added`, in a module
+    /// generated without optimization. Returns false without touching the module if other
+    /// declarations or function signatures changed, then it has to be generated anew
+    bool updateFunctions(std::vector<Expr *> const &removed, std::vector<Expr *> const &added);
 
     /// should be called only after codegen is done
     void dumpIR(fs::path const &asm_path) const;
     [[nodiscard]] std::string dumpIRString() const;
     void emitOBJ(fs::path const &asm_path);
+    /// split the module into up to `n_parts` partitions and compile them in parallel, into
+    /// `<stem>.part<i>.o`. Partitioning only depends on the module, so output is deterministic
+    std::vector<fs::path> emitOBJParts(std::string const &stem, unsigned n_parts);
+    /// bitcode with a ThinLTO summary, for `-flto=thin`
+    void emitBitcode(fs::path const &bc_path);
+    /// hand over the module with its context, e.g. to a JIT. The generator is unusable afterwards
+    llvm::orc::ThreadSafeModule takeModule();
 
 private:
+    IRGenerator(IRToolchain &toolchain, std::string const &source_name);
+
+    void setModuleTarget();
     llvm::Value *codegenVisitor(const Expr &expr);
     llvm::Value *boolCast(llvm::Value *val);
 
     void emitBlock(llvm::BasicBlock *BB, bool IsFinished = false);
 
-    std::vector<std::shared_ptr<Expr>> m_simplifiedAST;
+    ASTSnapshot m_simplifiedAST; // until `codegen` is done
+    IRToolchain &m_toolchain;
 
     std::unique_ptr<llvm::LLVMContext> m_context_ptr;
     std::unique_ptr<llvm::Module> m_module_ptr;
     std::unique_ptr<llvm::IRBuilder<>> m_builder_ptr;
 
-    std::unique_ptr<IRAnalysis> m_analysis;
-    std::unique_ptr<llvm::ModulePassManager> m_optimizer;
-
     std::unique_ptr<SymbolTable> m_symbolTable_ptr;
     std::unique_ptr<TypeTable> m_typeTable_ptr;
 
+    // jump targets of `continue` and `break` in the innermost loop
+    llvm::BasicBlock *m_continueBB = nullptr, *m_breakBB = nullptr;
+
 private:
     struct scope_manager { // RAII scope manager
         IRGenerator &ir_gen;
@@ -85,13 +146,27 @@ private:
             ir_gen.m_typeTable_ptr->pop_scope();
         }
     };
+
+    struct loop_BB_manager { // RAII loop basic block manager
+        IRGenerator &ir_gen;
+        llvm::BasicBlock *tmp_head, *tmp_tail;
+        loop_BB_manager(IRGenerator &ir_gen, llvm::BasicBlock *conti, llvm::BasicBlock *brk)
+            : ir_gen{ir_gen}, tmp_head(conti), tmp_tail(brk) {
+            std::swap(ir_gen.m_continueBB, tmp_head);
+            std::swap(ir_gen.m_breakBB, tmp_tail);
+        }
+        ~loop_BB_manager() {
+            std::swap(ir_gen.m_continueBB, tmp_head);
+            std::swap(ir_gen.m_breakBB, tmp_tail);
+        }
+    };
 };
 
 // --------------------- Implementation of `SymbolTableMixin<T>` --------------------------
 
 template <typename T>
 void SymbolTableMixin<T>::push_scope() {
-    symbols.push_back(llvm::StringMap<T>{});
+    symbols.push_back(llvm::DenseMap<uint32_t, T>{});
 }
 
 template <typename T>
@@ -101,25 +176,24 @@ void SymbolTableMixin<T>::pop_scope() {
 }
 
 template <typename T>
-bool SymbolTableMixin<T>::inCurrScope(llvm::StringRef sym_name) const {
+bool SymbolTableMixin<T>::inCurrScope(Symbol sym_name) const {
     if (symbols.empty()) llvm_unreachable("try to query locals in null scope?");
-    const auto &curr_scope = symbols.back();
-    return curr_scope.find(sym_name) != curr_scope.end();
+    return symbols.back().count(sym_name.id());
 }
 
 template <typename T>
-void SymbolTableMixin<T>::insert(llvm::StringRef sym_name, T val) {
+void SymbolTableMixin<T>::insert(Symbol sym_name, T val) {
     assert(!symbols.empty() && "No scope available for variable insertion!");
-    symbols.back().insert({sym_name, val});
+    symbols.back().insert({sym_name.id(), val});
 }
 
 template <typename T>
-T SymbolTableMixin<T>::operator[](llvm::StringRef sym_name) const {
+T SymbolTableMixin<T>::operator[](Symbol sym_name) const {
     // NOLINTNEXTLINE
     for (auto it = symbols.rbegin(); it != symbols.rend(); ++it) {
         const auto &map = *it;
-        if (auto pair_it = map.find(sym_name); pair_it != map.end()) {
-            return pair_it->getValue();
+        if (auto pair_it = map.find(sym_name.id()); pair_it != map.end()) {
+            return pair_it->second;
         }
     }
     return T{}; // == nullptr for pointer types
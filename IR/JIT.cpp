@@ -0,0 +1,197 @@
+#include "JIT.h"
+#include "IRGenerator.h"
+#include "Tiering.h"
+#include "utility.hpp"
+
+#include "llvm/Bitcode/BitcodeReader.h"
+#include "llvm/Bitcode/BitcodeWriter.h"
+#include "llvm/ExecutionEngine/Orc/CompileUtils.h"
+
+using namespace llvm;
+using namespace llvm::orc;
+
+template <typename T>
+static T unwrap(Expected<T> value, std::string_view what) {
+    if (!value) {
+        throw_err<std::runtime_error>("{}: {}", what, toString(value.takeError()));
+    }
+    return std::move(*value);
+}
+
+static void unwrap(Error err, std::string_view what) {
+    if (err) throw_err<std::runtime_error>("{}: {}", what, toString(std::move(err)));
+}
+
+static void addRuntimeLibraries(LLJIT &jit, std::string const &stdlib_path) {
+    auto &main_dylib = jit.getMainJITDylib();
+
+    // libc and friends, as the dynamic loader would find them
+    main_dylib.addGenerator(
+        unwrap(DynamicLibrarySearchGenerator::GetForCurrentProcess(
+                   jit.getDataLayout().getGlobalPrefix()),
+               "failed to load process symbols"));
+
+    // mystdlib: the same archive executables are linked against
+    main_dylib.addGenerator(
+        unwrap(StaticLibraryDefinitionGenerator::Load(jit.getObjLinkingLayer(),
+                                                      stdlib_path.c_str()),
+               fmt::format("failed to load '{}'", stdlib_path)));
+}
+
+static int runMain(LLJIT &jit) {
+    auto main_sym = unwrap(jit.lookup("main"), "failed to find `main`");
+    auto *main_fn = jitTargetAddressToFunction<int (*)()>(main_sym.getAddress());
+
+    dbg_print("[DEBUG] running `main` in JIT\n");
+    return main_fn();
+}
+
+int runJIT(std::vector<ThreadSafeModule> modules, std::string const &stdlib_path) {
+    IRToolchain::initializeTargets();
+
+    auto jit = unwrap(LLJITBuilder().create(), "failed to create JIT");
+    addRuntimeLibraries(*jit, stdlib_path);
+
+    for (auto &module : modules) {
+        unwrap(jit->addIRModule(std::move(module)), "failed to add module");
+    }
+    return runMain(*jit);
+}
+
+namespace {
+
+/// recompiles hot functions at -O3 on its own thread and swaps them into their call slots
+class TierUpCompiler {
+public:
+    TierUpCompiler(LLLazyJIT &jit, std::vector<std::string> units, StringMap<unsigned> unit_of)
+        : m_jit(jit), m_units(std::move(units)), m_unit_of(std::move(unit_of)) {
+        auto jtmb = unwrap(JITTargetMachineBuilder::detectHost(), "failed to detect host");
+        jtmb.setCodeGenOptLevel(CodeGenOpt::Aggressive);
+        m_target_machine = unwrap(jtmb.createTargetMachine(), "failed to create target machine");
+        m_thread = std::thread{[this] { run(); }};
+    }
+    TierUpCompiler(TierUpCompiler const &) = delete;
+    TierUpCompiler &operator=(TierUpCompiler const &) = delete;
+
+    ~TierUpCompiler() {
+        {
+            std::lock_guard lock{m_mutex};
+            m_stopping = true;
+        }
+        m_wakeup.notify_one();
+        m_thread.join();
+    }
+
+    void request(std::string fn) {
+        {
+            std::lock_guard lock{m_mutex};
+            m_queue.push_back(std::move(fn));
+        }
+        m_wakeup.notify_one();
+    }
+
+private:
+    void run() {
+        trace::ThreadScope trace_thread;
+        std::unique_lock lock{m_mutex};
+        while (true) {
+            m_wakeup.wait(lock, [this] { return m_stopping || !m_queue.empty(); });
+            if (m_stopping) return;
+            auto fn = std::move(m_queue.front());
+            m_queue.pop_front();
+
+            lock.unlock();
+            try {
+                recompile(fn);
+            } catch (std::exception const &e) {
+                // not fatal, the program keeps running the unoptimized code
+                dbg_print("[DEBUG] failed to recompile '{}': {}\n", fn, e.what());
+            }
+            lock.lock();
+        }
+    }
+
+    void recompile(std::string const &fn) {
+        trace::Scope span{"TierUp", fn};
+
+        // a fresh context, the ones of the running tier-0 code are locked by the JIT
+        LLVMContext context;
+        MemoryBufferRef bitcode{m_units[m_unit_of.lookup(fn)], fn};
+        auto module = unwrap(parseBitcodeFile(bitcode, context), "failed to read bitcode");
+        module->setTargetTriple(m_target_machine->getTargetTriple().str());
+        module->setDataLayout(m_target_machine->createDataLayout());
+
+        auto slotted = tiering::extractTier1(*module, fn);
+        m_optimizer.optimize(*module);
+        tiering::restoreCallSlots(*module, slotted);
+
+        auto object = unwrap(SimpleCompiler(*m_target_machine)(*module), "failed to compile");
+        unwrap(m_jit.addObjectFile(std::move(object)), "failed to add object");
+
+        auto body = unwrap(m_jit.lookup(tiering::tier1Name(fn)), "failed to find tier-1 body");
+        auto slot = unwrap(m_jit.lookup(tiering::slotName(fn)), "failed to find call slot");
+        std::atomic_ref{*jitTargetAddressToPointer<void **>(slot.getAddress())}.store(
+            jitTargetAddressToPointer<void *>(body.getAddress()), std::memory_order_release);
+        dbg_print("[DEBUG] '{}' recompiled at -O3\n", fn);
+    }
+
+    LLLazyJIT &m_jit;
+    std::vector<std::string> m_units; // bitcode of each unit, before counters were added
+    StringMap<unsigned> m_unit_of;    // defining unit of every function
+    std::unique_ptr<TargetMachine> m_target_machine;
+    IRToolchain m_optimizer{CompileOptions{.opt_level = 3}};
+
+    std::mutex m_mutex;
+    std::condition_variable m_wakeup;
+    std::deque<std::string> m_queue;
+    bool m_stopping = false;
+    std::thread m_thread;
+};
+
+TierUpCompiler *active_tier_up = nullptr;
+
+void onHot(const char *fn) { active_tier_up->request(fn); }
+
+} // namespace
+
+int runTieredJIT(std::vector<ThreadSafeModule> modules, std::string const &stdlib_path,
+                 uint64_t hot_threshold) {
+    IRToolchain::initializeTargets();
+
+    // tier 0: every function is compiled on its first call, by FastISel
+    auto jtmb = unwrap(JITTargetMachineBuilder::detectHost(), "failed to detect host");
+    jtmb.setCodeGenOptLevel(CodeGenOpt::None);
+    auto jit = unwrap(LLLazyJITBuilder().setJITTargetMachineBuilder(std::move(jtmb)).create(),
+                      "failed to create JIT");
+    addRuntimeLibraries(*jit, stdlib_path);
+
+    auto &main_dylib = jit->getMainJITDylib();
+    unwrap(main_dylib.define(absoluteSymbols({{
+               jit->mangleAndIntern(tiering::hot_callback),
+               JITEvaluatedSymbol(pointerToJITTargetAddress(&onHot),
+                                  JITSymbolFlags::Exported | JITSymbolFlags::Callable),
+           }})),
+           "failed to define hot callback");
+
+    std::vector<std::string> units(modules.size());
+    StringMap<unsigned> unit_of;
+    for (unsigned unit = 0; unit < modules.size(); ++unit) {
+        modules[unit].withModuleDo([&](Module &module) {
+            tiering::addCallSlots(module, unit);
+            for (auto &F : module) {
+                if (!F.isDeclaration()) unit_of[F.getName()] = unit;
+            }
+            raw_string_ostream bitcode{units[unit]};
+            WriteBitcodeToFile(module, bitcode);
+            bitcode.flush();
+            tiering::addHotCounters(module, hot_threshold);
+        });
+        unwrap(jit->addLazyIRModule(std::move(modules[unit])), "failed to add module");
+    }
+
+    TierUpCompiler tier_up{*jit, std::move(units), std::move(unit_of)};
+    active_tier_up = &tier_up;
+    int exit_code = runMain(*jit);
+    active_tier_up = nullptr;
+    return exit_code;
+}
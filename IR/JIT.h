@@ -0,0 +1,19 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace llvm::orc {
+class ThreadSafeModule;
+}
+
+/// link `modules` in-process with ORC LLJIT and call their `main`, returns what `main` returns.
+/// `mystdlib` symbols are resolved from the archive at `stdlib_path`, libc from this process
+int runJIT(std::vector<llvm::orc::ThreadSafeModule> modules, std::string const &stdlib_path);
+
+/// like `runJIT`, but functions are compiled on their first call without optimization.
+/// Once a function has been called or looped `hot_threshold` times it is recompiled at -O3 on a
+/// background thread and later calls go to the new code. `modules` should be unoptimized
+int runTieredJIT(std::vector<llvm::orc::ThreadSafeModule> modules,
+                 std::string const &stdlib_path, uint64_t hot_threshold);
@@ -1,46 +1,476 @@
 #include "ASTSimplify.h"
 #include "AST.hpp"
+#include "ASTArena.h"
+#include "CompactAST.h"
 #include "utility.hpp"
 #include "variant_magic.hpp"
 
+#include <cmath>
+#include <limits>
+#include <optional>
+#include <type_traits>
+
 using namespace std;
 
 inline bool isTerminator(Expr const &expr) {
     return expr.is<Return>() || expr.is<Break>() || expr.is<Continue>();
 }
 
-static void simplifyVisitor(Expr &expr) {
+// ------------ Constant folding -------------------
+// a folded node has the value `IRGenerator` would compute for it, so only operands of one type
+// are folded, and nothing that would be undefined at run time, e.g. a division by zero
+
+/// the value of `value` as a condition, as `boolCast` has it; nothing for strings
+static optional<bool> truth(ConstVar const &value) {
+    return match<optional<bool>>(
+        value,
+        [](bool val) -> optional<bool> { return val; },
+        [](char val) -> optional<bool> { return val != 0; },
+        [](int val) -> optional<bool> { return val != 0; },
+        [](float val) -> optional<bool> { return val < 0 || val > 0; }, // ordered, as `fcmp one`
+        [](double val) -> optional<bool> { return val < 0 || val > 0; },
+        [](string const &) -> optional<bool> { return nullopt; });
+}
+
+/// the value of condition `expr`, if it's a constant
+static optional<bool> constantCondition(Expr const *expr) {
+    if (!expr || !expr->is<ConstVar>()) return nullopt;
+    return truth(expr->as<ConstVar>());
+}
+
+/// `lhs op rhs` on `int` or `char`, wrapping around as the `i32` and `i8` of the IR do
+template <typename T>
+static optional<ConstVar> foldIntegral(Operators op, T lhs, T rhs) {
+    using U = make_unsigned_t<T>;
+    switch (op) {
+    case Plus: return ConstVar{T(U(lhs) + U(rhs))};
+    case Minus: return ConstVar{T(U(lhs) - U(rhs))};
+    case Mul: return ConstVar{T(U(lhs) * U(rhs))};
+    case Div:
+    case Mod: {
+        if (rhs == 0 || (lhs == numeric_limits<T>::min() && rhs == -1)) return nullopt;
+        return ConstVar{T(op == Div ? lhs / rhs : lhs % rhs)};
+    }
+    case Equal: return ConstVar{lhs == rhs};
+    case NotEqual: return ConstVar{lhs != rhs};
+    case Greater: return ConstVar{lhs > rhs};
+    case GreaterEqual: return ConstVar{lhs >= rhs};
+    case Less: return ConstVar{lhs < rhs};
+    case LessEqual: return ConstVar{lhs <= rhs};
+    default: return nullopt;
+    }
+}
+
+/// `lhs op rhs` on `double`, comparisons are ordered: false if either side is a NaN
+static optional<ConstVar> foldFloating(Operators op, double lhs, double rhs) {
+    switch (op) {
+    case Plus: return ConstVar{lhs + rhs};
+    case Minus: return ConstVar{lhs - rhs};
+    case Mul: return ConstVar{lhs * rhs};
+    case Div: return ConstVar{lhs / rhs};
+    case Mod: return ConstVar{fmod(lhs, rhs)};
+    case Equal: return ConstVar{lhs == rhs};
+    case NotEqual: return ConstVar{lhs < rhs || lhs > rhs};
+    case Greater: return ConstVar{lhs > rhs};
+    case GreaterEqual: return ConstVar{lhs >= rhs};
+    case Less: return ConstVar{lhs < rhs};
+    case LessEqual: return ConstVar{lhs <= rhs};
+    default: return nullopt;
+    }
+}
+
+/// `lhs op rhs` on `bool`, the results of comparisons. `&&` and `||` are bitwise in the IR, which
+/// is only the same as logical on bools
+static optional<ConstVar> foldBool(Operators op, bool lhs, bool rhs) {
+    switch (op) {
+    case Equal: return ConstVar{lhs == rhs};
+    case NotEqual: return ConstVar{lhs != rhs};
+    case AndAnd: return ConstVar{lhs && rhs};
+    case OrOr: return ConstVar{lhs || rhs};
+    default: return nullopt;
+    }
+}
+
+static optional<ConstVar> foldBinary(Operators op, ConstVar const &lhs, ConstVar const &rhs) {
+    if (lhs.index() != rhs.index()) return nullopt;
+    if (lhs.is<int>()) return foldIntegral(op, lhs.as<int>(), rhs.as<int>());
+    if (lhs.is<char>()) return foldIntegral(op, lhs.as<char>(), rhs.as<char>());
+    if (lhs.is<double>()) return foldFloating(op, lhs.as<double>(), rhs.as<double>());
+    if (lhs.is<bool>()) return foldBool(op, lhs.as<bool>(), rhs.as<bool>());
+    return nullopt;
+}
+
+/// `op operand`, `!` gives a bool like the comparisons do
+static optional<ConstVar> foldUnary(Operators op, ConstVar const &operand) {
+    if (operand.is<string>()) return nullopt;
+    if (op == Not) return ConstVar{!*truth(operand)};
+    if (op == Plus && !operand.is<bool>()) return operand;
+    if (op != Minus) return nullopt;
+    if (operand.is<int>()) return ConstVar{int(0u - unsigned(operand.as<int>()))};
+    if (operand.is<char>()) return ConstVar{char(0u - (unsigned char)operand.as<char>())};
+    if (operand.is<double>()) return ConstVar{-operand.as<double>()};
+    return nullopt;
+}
+
+/// the operand `lhs op rhs` is equal to, e.g. `x` of `x * 1`: 1 or 2, 0 if there's none.
+/// `is_int(i, value)` tells whether operand `i` is the `int` constant `value`
+template <typename IsInt>
+static int identityOperand(Operators op, IsInt is_int) {
+    switch (op) {
+    case Plus:
+        if (is_int(1, 0)) return 2;
+        return is_int(2, 0) ? 1 : 0;
+    case Mul:
+        if (is_int(1, 1)) return 2;
+        return is_int(2, 1) ? 1 : 0;
+    case Minus: return is_int(2, 0) ? 1 : 0;
+    case Div: return is_int(2, 1) ? 1 : 0;
+    default: return 0;
+    }
+}
+
+/// whether `value` is the `int` constant `expected`
+inline bool isInt(ConstVar const &value, int expected) {
+    return value.is<int>() && value.as<int>() == expected;
+}
+
+/// whether `lhs op rhs` assigns to the name `lhs`, which isn't an expression then
+inline bool isAssignment(Operators op) { return op >= PlusAssign && op <= Assign; }
+
+// ------------ Implementation on `Expr` trees -------------------
+
+static Expr *simplifyVisitor(Expr const &expr, ASTArena &arena);
+
+/// replace `child` by its simplified copy, if there is one
+static bool simplifyChild(Expr *&child, ASTArena &arena) {
+    Expr *copy = child ? simplifyVisitor(*child, arena) : nullptr;
+    if (copy) child = copy;
+    return copy != nullptr;
+}
+
+/// `list` with its elements simplified, nothing if none of them changes
+static optional<vector<Expr *>> simplifyList(vector<Expr *> const &list, ASTArena &arena) {
+    optional<vector<Expr *>> copy; // made on the first change
+    for (size_t i = 0; i < list.size(); ++i) {
+        Expr *elem = simplifyVisitor(*list[i], arena);
+        if (elem && !copy) copy.emplace(list.begin(), list.end());
+        if (elem) (*copy)[i] = elem;
+    }
+    return copy;
+}
+
+/**
+ * A simplified copy of `expr` in `arena`, null if there's nothing to simplify. Constant
+ * expressions are folded, the branch a constant condition doesn't take is dropped and so are loops
+ * that never run, as well as the statements after a `return`, `break` or `continue`. A statement
+ * that is dropped altogether becomes `Null`, which compound statements leave out.
+ */
+static Expr *simplifyVisitor(Expr const &expr, ASTArena &arena) {
     if (expr.is<CompoundExpr>()) {
-        auto &comp = expr.as<CompoundExpr>();
-        int i = 0;
-        for (; i < comp.size(); ++i) {
-            if (isTerminator(*comp[i])) {
-                comp.resize(i + 1);
+        const auto &comp = expr.as<CompoundExpr>();
+        CompoundExpr copy; // made on the first change
+        bool changed = false;
+        for (size_t i = 0; i < comp.size(); ++i) {
+            Expr *stmt = simplifyVisitor(*comp[i], arena);
+            if (!changed && (stmt || comp[i]->is<Null>())) {
+                copy.assign(comp.begin(), comp.begin() + i);
+                changed = true;
+            }
+            if (!stmt) stmt = comp[i];
+            if (changed && !stmt->is<Null>()) copy.push_back(stmt);
+            if (isTerminator(*stmt)) {
+                if (!changed && i + 1 < comp.size()) {
+                    copy.assign(comp.begin(), comp.begin() + i + 1);
+                    changed = true;
+                }
                 break;
             }
-            simplifyVisitor(*comp[i]);
         }
-        return;
+        return changed ? arena.make(std::move(copy)) : nullptr;
     }
 
     if (expr.is<FuncDef>()) {
-        simplifyVisitor(*expr.as<FuncDef>().m_body);
+        auto def = expr.as<FuncDef>();
+        if (simplifyChild(def.m_body, arena)) return arena.make(def);
     } else if (expr.is<IfElse>()) {
-        simplifyVisitor(*expr.as<IfElse>().m_if);
-        if (expr.as<IfElse>().m_else) simplifyVisitor(*expr.as<IfElse>().m_else);
+        auto if_else = expr.as<IfElse>();
+        bool changed = simplifyChild(if_else.m_condi, arena);
+        if (auto cond = constantCondition(if_else.m_condi)) {
+            Expr *taken = *cond ? if_else.m_if : if_else.m_else;
+            simplifyChild(taken, arena);
+            return taken ? taken : arena.make(Null{});
+        }
+        changed = simplifyChild(if_else.m_if, arena) || changed;
+        changed = simplifyChild(if_else.m_else, arena) || changed;
+        if (changed) return arena.make(if_else);
     } else if (expr.is<WhileLoop>()) {
-        simplifyVisitor(*expr.as<WhileLoop>().m_loop_body);
+        auto loop = expr.as<WhileLoop>();
+        bool changed = simplifyChild(loop.m_condi, arena);
+        if (constantCondition(loop.m_condi) == false) return arena.make(Null{});
+        changed = simplifyChild(loop.m_loop_body, arena) || changed;
+        if (changed) return arena.make(loop);
     } else if (expr.is<ForLoop>()) {
-        simplifyVisitor(*expr.as<ForLoop>().m_loop_body);
+        auto loop = expr.as<ForLoop>();
+        bool changed = simplifyChild(loop.m_init, arena);
+        changed = simplifyChild(loop.m_condi, arena) || changed;
+        if (constantCondition(loop.m_condi) == false) {
+            // only `init` is left, in a scope of its own as in the loop
+            if (!loop.m_init) return arena.make(Null{});
+            return arena.make(CompoundExpr{loop.m_init});
+        }
+        changed = simplifyChild(loop.m_iter, arena) || changed;
+        changed = simplifyChild(loop.m_loop_body, arena) || changed;
+        if (changed) return arena.make(loop);
+    } else if (expr.is<Unary>()) {
+        auto unary = expr.as<Unary>();
+        bool changed = simplifyChild(unary.m_operand, arena);
+        if (unary.m_operand->is<ConstVar>()) {
+            if (auto value = foldUnary(unary.m_operator, unary.m_operand->as<ConstVar>())) {
+                return arena.make(std::move(*value));
+            }
+        }
+        if (changed) return arena.make(unary);
+    } else if (expr.is<Binary>()) {
+        auto bin = expr.as<Binary>();
+        bool changed = simplifyChild(bin.m_operand2, arena);
+        if (isAssignment(bin.m_operator)) { // lhs is a name
+            return changed ? arena.make(bin) : nullptr;
+        }
+        changed = simplifyChild(bin.m_operand1, arena) || changed;
+        if (bin.m_operand1->is<ConstVar>() && bin.m_operand2->is<ConstVar>()) {
+            auto value = foldBinary(bin.m_operator, bin.m_operand1->as<ConstVar>(),
+                                    bin.m_operand2->as<ConstVar>());
+            if (value) return arena.make(std::move(*value));
+        }
+        int identity = identityOperand(bin.m_operator, [&](int i, int value) {
+            Expr const *operand = i == 1 ? bin.m_operand1 : bin.m_operand2;
+            return operand->is<ConstVar>() && isInt(operand->as<ConstVar>(), value);
+        });
+        if (identity) return identity == 1 ? bin.m_operand1 : bin.m_operand2;
+        if (changed) return arena.make(bin);
+    } else if (expr.is<Variable>()) {
+        auto var = expr.as<Variable>();
+        if (simplifyChild(var.m_var_init, arena)) return arena.make(var);
+    } else if (expr.is<InitExpr>()) {
+        if (auto vars = simplifyList(expr.as<InitExpr>(), arena)) {
+            return arena.make(InitExpr(vars->begin(), vars->end()));
+        }
+    } else if (expr.is<Return>()) {
+        auto ret = expr.as<Return>();
+        if (simplifyChild(ret.m_expr, arena)) return arena.make(ret);
+    } else if (expr.is<FuncCall>()) {
+        const auto &call = expr.as<FuncCall>();
+        if (auto args = simplifyList(call.m_para_list, arena)) {
+            return arena.make(FuncCall{
+                .m_para_list = std::move(*args),
+                .m_func_name = call.m_func_name,
+            });
+        }
+    }
+    return nullptr;
+}
+
+std::vector<Expr const *> simplifyAST(std::vector<Expr const *> const &ASTs, ASTArena &arena) {
+    std::vector<Expr const *> ret;
+    ret.reserve(ASTs.size());
+    for (const auto *AST : ASTs) {
+        Expr *copy = simplifyVisitor(*AST, arena);
+        ret.push_back(copy ? copy : AST);
     }
+    return ret;
 }
 
-void simplifyAST(std::vector<std::shared_ptr<Expr>> &ASTs) {
-    //
-    for (const auto &AST : ASTs) {
-        if (AST->is<InitExpr>()) continue;
+// ------------ Implementation on `CompactAST` -------------------
+// the same on the flat form. The trees are written anew, children first, so the nodes of a folded
+// expression or of a dropped branch are already written when that is known: they are rolled back
 
-        // funcdef
-        simplifyVisitor(*AST);
+namespace {
+
+using NodeId = CompactAST::NodeId;
+constexpr NodeId no_node = CompactAST::no_node;
+
+class FlatSimplifier {
+public:
+    explicit FlatSimplifier(CompactAST const &ast) : m_out(ast), m_ast(ast) {}
+
+    /// the simplified tree of `node` of `m_ast`, written into `m_out`. As with `simplifyVisitor`,
+    /// a statement that is dropped altogether becomes `Null`
+    NodeId visit(NodeId node);
+
+    CompactAST::Builder m_out;
+
+private:
+    /// `node` with its children simplified
+    NodeId copy(NodeId node);
+    NodeId compound(NodeId node);
+    NodeId ifElse(NodeId node);
+    NodeId whileLoop(NodeId node);
+    NodeId forLoop(NodeId node);
+    NodeId unary(NodeId node);
+    NodeId binary(NodeId node);
+
+    NodeId addList(uint8_t kind, span<const NodeId> nodes);
+    /// the value of condition `node` of `m_out`, if it's a constant
+    optional<bool> constantCondition(NodeId node) const;
+    bool isTerminator(NodeId node) const;
+
+    CompactAST const &m_ast;
+};
+
+} // namespace
+
+NodeId FlatSimplifier::visit(NodeId node) {
+    if (node == no_node) return no_node;
+    switch (m_ast.kind(node)) {
+    case expr_kind<CompoundExpr>: return compound(node);
+    case expr_kind<IfElse>: return ifElse(node);
+    case expr_kind<WhileLoop>: return whileLoop(node);
+    case expr_kind<ForLoop>: return forLoop(node);
+    case expr_kind<Unary>: return unary(node);
+    case expr_kind<Binary>: return binary(node);
+    default: return copy(node);
+    }
+}
+
+NodeId FlatSimplifier::copy(NodeId node) {
+    auto operands = m_ast.operands(node);
+    auto children = [&](unsigned count) {
+        for (unsigned i = 0; i < count; ++i) operands[i] = visit(operands[i]);
+    };
+    switch (m_ast.kind(node)) {
+    case expr_kind<Variable>:
+    case expr_kind<Return>: children(1); break;
+    case expr_kind<FuncDef>: children(2); break;
+    case expr_kind<InitExpr>:
+    case expr_kind<FuncCall>:
+    case expr_kind<FuncProto>: {
+        vector<NodeId> nodes;
+        nodes.reserve(operands[1]);
+        for (auto child : m_ast.children(node)) nodes.push_back(visit(child));
+        operands[0] = m_out.list(nodes);
+        break;
+    }
+    default: break; // names and strings are numbered as in `m_ast`, the rest has no children
+    }
+    return m_out.add(m_ast.kind(node), m_ast.tag(node), operands);
+}
+
+NodeId FlatSimplifier::compound(NodeId node) {
+    vector<NodeId> stmts;
+    for (auto child : m_ast.children(node)) {
+        auto mark = m_out.mark();
+        NodeId stmt = visit(child);
+        if (m_out.is<Null>(stmt)) {
+            m_out.rollback(mark);
+            continue;
+        }
+        stmts.push_back(stmt);
+        if (isTerminator(stmt)) break;
+    }
+    return addList(expr_kind<CompoundExpr>, stmts);
+}
+
+NodeId FlatSimplifier::ifElse(NodeId node) {
+    auto mark = m_out.mark();
+    NodeId cond = visit(m_ast.child(node, 0));
+    if (auto taken = constantCondition(cond)) {
+        m_out.rollback(mark);
+        NodeId branch = m_ast.child(node, *taken ? 1 : 2);
+        return branch == no_node ? m_out.add(expr_kind<Null>) : visit(branch);
+    }
+    NodeId then = visit(m_ast.child(node, 1));
+    NodeId otherwise = visit(m_ast.child(node, 2));
+    return m_out.add(expr_kind<IfElse>, 0, {cond, then, otherwise, no_node});
+}
+
+NodeId FlatSimplifier::whileLoop(NodeId node) {
+    auto mark = m_out.mark();
+    NodeId cond = visit(m_ast.child(node, 0));
+    if (constantCondition(cond) == false) {
+        m_out.rollback(mark);
+        return m_out.add(expr_kind<Null>);
     }
+    NodeId body = visit(m_ast.child(node, 1));
+    return m_out.add(expr_kind<WhileLoop>, 0, {cond, body, no_node, no_node});
+}
+
+NodeId FlatSimplifier::forLoop(NodeId node) {
+    NodeId init = visit(m_ast.child(node, 0));
+    auto mark = m_out.mark();
+    NodeId cond = visit(m_ast.child(node, 1));
+    if (constantCondition(cond) == false) {
+        // only `init` is left, in a scope of its own as in the loop
+        m_out.rollback(mark);
+        if (init == no_node) return m_out.add(expr_kind<Null>);
+        return addList(expr_kind<CompoundExpr>, {&init, 1});
+    }
+    NodeId iter = visit(m_ast.child(node, 2));
+    NodeId body = visit(m_ast.child(node, 3));
+    return m_out.add(expr_kind<ForLoop>, 0, {init, cond, iter, body});
+}
+
+NodeId FlatSimplifier::unary(NodeId node) {
+    auto op = static_cast<Operators>(m_ast.tag(node));
+    auto mark = m_out.mark();
+    NodeId operand = visit(m_ast.child(node, 0));
+    if (operand != no_node && m_out.is<ConstVar>(operand)) {
+        if (auto value = foldUnary(op, m_out.constant(operand))) {
+            m_out.rollback(mark);
+            return m_out.add(*value);
+        }
+    }
+    return m_out.add(expr_kind<Unary>, op, {operand, no_node, no_node, no_node});
+}
+
+NodeId FlatSimplifier::binary(NodeId node) {
+    auto op = static_cast<Operators>(m_ast.tag(node));
+    auto mark = m_out.mark();
+    NodeId lhs = visit(m_ast.child(node, 0));
+    auto after_lhs = m_out.mark();
+    NodeId rhs = visit(m_ast.child(node, 1));
+    if (isAssignment(op)) return m_out.add(expr_kind<Binary>, op, {lhs, rhs, no_node, no_node});
+
+    auto constant = [&](NodeId operand) {
+        return operand != no_node && m_out.is<ConstVar>(operand);
+    };
+    if (constant(lhs) && constant(rhs)) {
+        if (auto value = foldBinary(op, m_out.constant(lhs), m_out.constant(rhs))) {
+            m_out.rollback(mark);
+            return m_out.add(*value);
+        }
+    }
+    int identity = identityOperand(op, [&](int i, int value) {
+        NodeId operand = i == 1 ? lhs : rhs;
+        return constant(operand) && isInt(m_out.constant(operand), value);
+    });
+    if (identity == 1) {
+        m_out.rollback(after_lhs);
+        return lhs;
+    }
+    if (identity == 2) {
+        // the constant `lhs` is written before `rhs`, which is written again without it
+        m_out.rollback(mark);
+        return visit(m_ast.child(node, 1));
+    }
+    return m_out.add(expr_kind<Binary>, op, {lhs, rhs, no_node, no_node});
+}
+
+NodeId FlatSimplifier::addList(uint8_t kind, span<const NodeId> nodes) {
+    uint32_t first = m_out.list(nodes);
+    return m_out.add(kind, 0, {first, static_cast<uint32_t>(nodes.size()), no_node, no_node});
+}
+
+optional<bool> FlatSimplifier::constantCondition(NodeId node) const {
+    if (node == no_node || !m_out.is<ConstVar>(node)) return nullopt;
+    return truth(m_out.constant(node));
+}
+
+bool FlatSimplifier::isTerminator(NodeId node) const {
+    return m_out.is<Return>(node) || m_out.is<Break>(node) || m_out.is<Continue>(node);
+}
+
+CompactAST simplifyAST(CompactAST const &AST) {
+    FlatSimplifier simplifier{AST};
+    for (auto root : AST.roots()) simplifier.m_out.root(simplifier.visit(root));
+    return simplifier.m_out.finish();
 }
@@ -1,5 +1,18 @@
 #pragma once
 
+#include <vector>
+
 struct Expr; // generic node
+class ASTArena;
+class CompactAST;
+
+/// `AST` with constant expressions folded, without the branches and loops that a constant
+/// condition never runs and without the statements after a `return`, `break` or `continue`. The
+/// trees are left as they are: changed nodes are copied into `arena`, the new trees share all
+/// others with them
+[[nodiscard]] std::vector<Expr const *> simplifyAST(std::vector<Expr const *> const &AST,
+                                                    ASTArena &arena);
 
-void simplifyAST(std::vector<std::shared_ptr<Expr>> &AST);
\ No newline at end of file
+/// the same on the flat form. The result is a new `CompactAST`, of the simplified trees only:
+/// nodes that are folded or dropped are never in it
+[[nodiscard]] CompactAST simplifyAST(CompactAST const &AST);
@@ -1,41 +1,36 @@
 #include "CFGDotPrinter.h"
-#include "OptHandler.h"
+#include "GraphRenderer.h"
 #include "utility.hpp"
 
 #include "llvm/ADT/PostOrderIterator.h"
 #include "llvm/Analysis/CFGPrinter.h"
-#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Path.h"
 
 using namespace llvm;
 
-extern OptHandler cli_inputs;
-
-static void writeCFGToDotFile(Function &F, BlockFrequencyInfo *BFI, BranchProbabilityInfo *BPI,
-                              uint64_t MaxFreq, bool CFGOnly = false) {
-    std::string Basename = fmt::format("{}/cfg_{}", cli_inputs.pic_outdir, F.getName());
-    dbg_print("[DEBUG] write CFG for '{}'\n", F.getName());
-
-    std::error_code EC;
-    raw_fd_ostream File(Basename + ".dot", EC, sys::fs::OF_Text);
+static void renderCFG(StringRef OutDir, Function &F, BlockFrequencyInfo *BFI,
+                      BranchProbabilityInfo *BPI, uint64_t MaxFreq, bool CFGOnly = false) {
+    // units of one compilation share `OutDir`, and their static functions may share names
+    StringRef Unit = sys::path::stem(F.getParent()->getSourceFileName());
+    std::string Basename = fmt::format("{}/{}.cfg_{}", OutDir, Unit, F.getName());
+    dbg_print("[DEBUG] render CFG for '{}'\n", F.getName());
 
     DOTFuncInfo CFGInfo(&F, BFI, BPI, MaxFreq);
     CFGInfo.setHeatColors(true);
     CFGInfo.setEdgeWeights(false);
     CFGInfo.setRawEdgeWeights(false);
 
-    if (!EC)
-        WriteGraph(File, &CFGInfo, CFGOnly).flush();
-    else
-        errs() << "  error opening file for writing!\n";
-
-    auto temp = fmt::format("dot {}.dot -Tpng:cairo -o {}.png", Basename, Basename);
-    system(temp.c_str());
-    std::filesystem::remove(Basename + ".dot");
+    // only the DOT text is built here, rendering goes on in the background
+    std::string Dot;
+    raw_string_ostream OS(Dot);
+    WriteGraph(OS, &CFGInfo, CFGOnly);
+    OS.flush();
+    GraphRenderer::instance().submit(std::move(Dot), Basename + ".png");
 }
 
 PreservedAnalyses CFGDotPrinterPass::run(Function &F, FunctionAnalysisManager &AM) {
     auto *BFI = &AM.getResult<BlockFrequencyAnalysis>(F);
     auto *BPI = &AM.getResult<BranchProbabilityAnalysis>(F);
-    writeCFGToDotFile(F, BFI, BPI, getMaxFreq(F, BFI));
+    renderCFG(m_pic_outdir, F, BFI, BPI, getMaxFreq(F, BFI));
     return PreservedAnalyses::all();
 }
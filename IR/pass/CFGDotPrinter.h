@@ -4,7 +4,11 @@ namespace llvm {
 
 class CFGDotPrinterPass : public PassInfoMixin<CFGDotPrinterPass> {
 public:
+    explicit CFGDotPrinterPass(std::string pic_outdir) : m_pic_outdir(std::move(pic_outdir)) {}
     PreservedAnalyses run(Function &F, FunctionAnalysisManager &AM);
+
+private:
+    std::string m_pic_outdir;
 };
 
 } // namespace llvm
\ No newline at end of file
@@ -0,0 +1,121 @@
+#include "Tiering.h"
+#include "utility.hpp"
+
+#include "llvm/Analysis/CFG.h"
+#include "llvm/Transforms/Utils/BasicBlockUtils.h"
+
+using namespace llvm;
+
+static void routeThroughSlot(Function &F, GlobalVariable *slot) {
+    for (auto &use : make_early_inc_range(F.uses())) {
+        auto *call = dyn_cast<CallBase>(use.getUser());
+        if (!call || !call->isCallee(&use)) continue;
+        // monotonic is enough: any published address is a complete function
+        auto *callee = new LoadInst(F.getType(), slot, F.getName() + ".callee", false, Align(8),
+                                    AtomicOrdering::Monotonic, SyncScope::System, call);
+        call->setCalledOperand(callee);
+    }
+}
+
+void tiering::addCallSlots(Module &module, unsigned unit) {
+    for (auto &GV : module.global_values()) {
+        if (!GV.hasLocalLinkage() || GV.isDeclaration()) continue;
+        GV.setName(fmt::format("{}.u{}", GV.getName(), unit));
+        GV.setLinkage(GlobalValue::ExternalLinkage);
+    }
+
+    SmallVector<Function *> defined;
+    for (auto &F : module) {
+        if (!F.isDeclaration()) defined.push_back(&F);
+    }
+    for (auto *F : defined) {
+        auto *slot = new GlobalVariable(module, F->getType(), false,
+                                        GlobalValue::ExternalLinkage, F, slotName(F->getName()));
+        routeThroughSlot(*F, slot);
+    }
+}
+
+static void bumpCounter(GlobalVariable *counter, FunctionCallee hot_fn, Constant *name,
+                        uint64_t threshold, Instruction *before) {
+    IRBuilder<> builder(before);
+    auto *count = builder.CreateAdd(builder.CreateLoad(builder.getInt64Ty(), counter),
+                                    builder.getInt64(1));
+    builder.CreateStore(count, counter);
+
+    // reported exactly once, the counter keeps running past the threshold
+    auto *is_hot = builder.CreateICmpEQ(count, builder.getInt64(threshold));
+    builder.SetInsertPoint(SplitBlockAndInsertIfThen(is_hot, before, false));
+    builder.CreateCall(hot_fn, {name});
+}
+
+void tiering::addHotCounters(Module &module, uint64_t threshold) {
+    auto &ctx = module.getContext();
+    auto *i64 = Type::getInt64Ty(ctx);
+    auto hot_fn = module.getOrInsertFunction(
+        hot_callback, FunctionType::get(Type::getVoidTy(ctx), {Type::getInt8PtrTy(ctx)}, false));
+
+    IRBuilder<> builder(ctx);
+    for (auto &F : module) {
+        if (F.isDeclaration()) continue;
+
+        auto *counter = new GlobalVariable(module, i64, false, GlobalValue::PrivateLinkage,
+                                           ConstantInt::get(i64, 0), F.getName() + ".count");
+        auto *name = builder.CreateGlobalStringPtr(F.getName(), F.getName() + ".name", 0, &module);
+
+        SmallVector<std::pair<const BasicBlock *, const BasicBlock *>> backedges;
+        FindFunctionBackedges(F, backedges);
+        for (auto [from, to] : backedges) {
+            auto *latch = const_cast<BasicBlock *>(from);
+            bumpCounter(counter, hot_fn, name, threshold, latch->getTerminator());
+        }
+
+        // allocas have to stay in the entry block
+        auto entry = F.getEntryBlock().getFirstInsertionPt();
+        while (isa<AllocaInst>(*entry)) ++entry;
+        bumpCounter(counter, hot_fn, name, threshold, &*entry);
+    }
+}
+
+std::vector<std::string> tiering::extractTier1(Module &module, StringRef fn) {
+    // direct calls again, so the inliner sees through them
+    std::vector<std::string> slotted;
+    for (auto &GV : module.globals()) {
+        auto *callee = GV.hasInitializer() ? dyn_cast<Function>(GV.getInitializer()) : nullptr;
+        if (!callee || GV.getName() != slotName(callee->getName())) continue;
+        slotted.push_back(callee->getName().str());
+        for (auto *user : make_early_inc_range(GV.users())) {
+            if (auto *load = dyn_cast<LoadInst>(user)) {
+                load->replaceAllUsesWith(callee);
+                load->eraseFromParent();
+            }
+        }
+    }
+
+    auto *target = module.getFunction(fn);
+    if (!target || target->isDeclaration()) {
+        throw_err<std::runtime_error>("no definition of '{}' to recompile", fn.str());
+    }
+    for (auto &F : module) {
+        if (&F != target && !F.isDeclaration()) {
+            F.setLinkage(GlobalValue::AvailableExternallyLinkage);
+        }
+    }
+    target->setName(tier1Name(fn));
+
+    for (auto &GV : module.globals()) {
+        if (!GV.hasInitializer()) continue;
+        GV.setInitializer(nullptr);
+        GV.setLinkage(GlobalValue::ExternalLinkage);
+    }
+    return slotted;
+}
+
+void tiering::restoreCallSlots(Module &module, std::vector<std::string> const &slotted) {
+    for (const auto &name : slotted) {
+        // the recompiled function itself was renamed, its recursive calls stay direct
+        auto *F = module.getFunction(name);
+        if (!F || F->use_empty()) continue;
+        auto *slot = cast<GlobalVariable>(module.getOrInsertGlobal(slotName(name), F->getType()));
+        routeThroughSlot(*F, slot);
+    }
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+namespace llvm {
+
+/// Module transforms behind `--tiered`.
+///
+/// Every function defined in a module gets a mutable slot `<fn>.slot` holding its address and
+/// calls go through it, so the JIT can swap in an optimized body while the program runs.
+namespace tiering {
+
+/// symbol the counters call once a function crosses the hotness threshold, `void(i8*)`
+inline constexpr const char *hot_callback = "__tinycc_hot";
+
+inline std::string slotName(StringRef fn) { return (fn + ".slot").str(); }
+inline std::string tier1Name(StringRef fn) { return (fn + ".tier1").str(); }
+
+/// route calls to functions defined in `module` through their slots. Local symbols are
+/// promoted (suffixed with `unit` to stay unique) since tier-1 modules refer to them from outside
+void addCallSlots(Module &module, unsigned unit);
+
+/// count calls and loop back-edges of every function, `hot_callback` is called with the
+/// function name when the count reaches `threshold`
+void addHotCounters(Module &module, uint64_t threshold);
+
+/// reduce a module prepared by `addCallSlots` to an optimizable copy of `fn` named
+/// `tier1Name(fn)`. Other functions stay `available_externally` for the inliner,
+/// globals become declarations resolved against the running tier-0 code.
+/// Returns the functions that have slots
+std::vector<std::string> extractTier1(Module &module, StringRef fn);
+
+/// after optimizing, point calls to `slotted` functions that weren't inlined back at the slots
+void restoreCallSlots(Module &module, std::vector<std::string> const &slotted);
+
+} // namespace tiering
+
+} // namespace llvm
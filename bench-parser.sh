@@ -0,0 +1,100 @@
+#!/bin/bash
+# parse times on an expression heavy corpus, copies of the functions of test/expr.c: the best of 5
+# runs per phase of `tinycc --time-report`
+#
+#   ./bench-parser.sh <tinycc> [copies]
+#       the Lex, Parse and BuildAST times of CParser + ASTBuilder next to those of --parser=fast
+#   ./bench-parser.sh --grammar <tinycc before> <tinycc> [copies]
+#       the same times of CParser + ASTBuilder in two builds, e.g. before and after a change of
+#       CParser.g4
+#   ./bench-parser.sh --warmup <tinycc> [copies]
+#       the same times of CParser + ASTBuilder with and without --sll, in a cold process and in one
+#       whose prediction DFA was filled by --parser-warmup=test/expr.c first
+
+set -e
+
+case "$1" in
+--grammar)
+    before=$(realpath "$2")
+    shift 2
+    ;;
+--warmup)
+    warmup=$(realpath "$(dirname "$0")/test/expr.c")
+    shift
+    ;;
+esac
+tinycc=$(realpath "$1")
+copies=${2:-3000}
+runs=5
+
+dir=$(mktemp -d)
+trap 'rm -rf "$dir"' EXIT
+
+# the functions before `main` renamed per copy, the first one keeps the names `main` calls
+awk -v copies="$copies" '
+    /^int main/ { functions = 0; main = 1 }
+    /^int / && !main { functions = 1 }
+    functions { body = body $0 "\n" }
+    main { tail = tail $0 "\n" }
+    END {
+        for (i = 0; i < copies; ++i) {
+            copy = body
+            if (i) {
+                gsub(/poly\(/, "poly_" i "(", copy)
+                gsub(/mix\(/, "mix_" i "(", copy)
+                gsub(/cond\(/, "cond_" i "(", copy)
+            }
+            printf "%s", copy
+        }
+        printf "extern void output_int(int num);\n\n%s", tail
+    }' "$(dirname "$0")/test/expr.c" > "$dir/big.c"
+echo "big.c: $copies copies of test/expr.c, $(wc -c < "$dir/big.c") bytes"
+
+columns=()
+
+# best time in ms of each phase over `runs` runs of a tinycc with the given options, as `phase ms`
+# in the next column of the table, titled `$1`
+column() {
+    local title=$1
+    shift
+    for _ in $(seq $runs); do
+        (cd "$dir" && "$@" --time-report big.c 2>&1)
+    done | awk '$3 ~ /^(Lex|Parse|ParseLL|BuildAST|WarmUpParser)$/ && (!($3 in ms) || $1 < ms[$3]) {
+                    ms[$3] = $1
+                }
+                END { for (phase in ms) print phase, ms[phase] }' > "$dir/${#columns[@]}"
+    columns+=("$title (ms)")
+}
+
+phases=(Lex Parse BuildAST)
+if [ -n "$before" ]; then
+    # --emit-ast-bin is newer than the grammar change, the builds compile the whole program
+    column before "$before" -o big
+    column after "$tinycc" -o big
+elif [ -n "$warmup" ]; then
+    # --emit-ast-bin stops after parsing. ParseLL is the reparse of --sll after a syntax error
+    phases=(WarmUpParser Lex Parse ParseLL BuildAST)
+    column cold "$tinycc" --emit-ast-bin
+    column "cold sll" "$tinycc" --emit-ast-bin --sll
+    column warm "$tinycc" --emit-ast-bin --parser-warmup="$warmup"
+    column "warm sll" "$tinycc" --emit-ast-bin --parser-warmup="$warmup" --sll
+else
+    column antlr "$tinycc" --emit-ast-bin
+    column fast "$tinycc" --emit-ast-bin --lexer=fast --parser=fast
+fi
+
+# the time of phase `$1` in column `$2`, `-` if it didn't run
+cell() {
+    awk -v phase="$1" 'BEGIN { ms = "-" } $1 == phase { ms = $2 } END { print ms }' "$dir/$2"
+}
+
+printf "%-12s" ""
+printf " %15s" "${columns[@]}"
+echo
+for phase in "${phases[@]}"; do
+    printf "%-12s" "$phase"
+    for i in "${!columns[@]}"; do
+        printf " %15s" "$(cell "$phase" "$i")"
+    done
+    echo
+done
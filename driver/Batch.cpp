@@ -0,0 +1,121 @@
+#include "Batch.h"
+#include "CompileCache.h"
+#include "GraphRenderer.h"
+#include "IRGenerator.h"
+#include "Linker.h"
+#include "Trace.h"
+
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/Support/LineIterator.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <atomic>
+#include <set>
+#include <thread>
+
+using namespace llvm;
+
+static double millisecondsSince(trace::clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(trace::clock::now() - start).count();
+}
+
+int runBatch(OptHandler const &cli, DriverSession &session, raw_ostream &out) {
+    const auto exe_name = fs::path{session.exe_path}.filename().native();
+    const auto &manifest_path = cli.batch_manifest.getValue();
+
+    auto manifest = MemoryBuffer::getFile(manifest_path, true);
+    if (!manifest) {
+        out << fmt::format("{}: error: cannot read manifest '{}': {}\n",
+                           exe_name,
+                           manifest_path,
+                           manifest.getError().message());
+        return 1;
+    }
+
+    std::vector<CompileJob> jobs;
+    std::set<std::string> outputs;
+    for (line_iterator line{**manifest, true, '#'}; !line.is_at_end(); ++line) {
+        SmallVector<StringRef, 2> fields;
+        SplitString(*line, fields);
+        if (fields.empty()) continue;
+        if (fields.size() > 2) {
+            out << fmt::format("{}:{}: error: expected `<source> [<output>]`\n",
+                               manifest_path,
+                               line.line_number());
+            return 1;
+        }
+
+        fs::path input{fields[0].str()};
+        std::string output =
+            fields.size() == 2 ? fields[1].str() : fs::path{input}.replace_extension("").native();
+        if (!outputs.insert(output).second) {
+            out << fmt::format("{}:{}: error: '{}' is already built by another program\n",
+                               manifest_path,
+                               line.line_number(),
+                               output);
+            return 1;
+        }
+        jobs.push_back(CompileJob{.input = std::move(input), .out_stem = std::move(output)});
+    }
+
+    const CompileOptions opts = cli.compileOptions();
+
+    std::unique_ptr<CompileCache> cache;
+    if (!cli.cache_dir.empty()) {
+        cache = std::make_unique<CompileCache>(cli.cache_dir.getValue(),
+                                               uint64_t{cli.cache_size} << 20);
+    }
+
+    trace::start(!cli.trace_file.empty(), cli.time_report);
+    warmUpParser(cli, session, out);
+    const auto batch_start = trace::clock::now();
+
+    unsigned n_workers = cli.jobs ? cli.jobs : std::thread::hardware_concurrency();
+    // programs are already linked in parallel
+    const LinkOptions link_opts = linkOptions(cli, 1);
+
+    std::mutex out_mutex;
+    std::atomic<size_t> n_failed = 0;
+
+    // a failing program is reported in its status line, the others go on
+    auto build = [&](size_t i, IRToolchain &toolchain) {
+        const auto &job = jobs[i];
+        const auto start = trace::clock::now();
+        std::string error;
+        try {
+            auto object = compileUnit(job, opts, toolchain, session.headers, cache.get());
+            trace::Scope span{"Link", job.out_stem};
+            linkExecutable(job.out_stem, {object.native()}, link_opts);
+        } catch (std::exception const &e) {
+            error = e.what();
+            ++n_failed;
+        }
+
+        const double elapsed = millisecondsSince(start);
+        std::lock_guard lock{out_mutex};
+        if (error.empty()) {
+            out << fmt::format("[ok] {} -> {} ({:.1f} ms)\n", job.input.native(), job.out_stem,
+                               elapsed);
+        } else {
+            out << fmt::format("[failed] {} ({:.1f} ms): {}\n", job.input.native(), elapsed,
+                               error);
+        }
+    };
+
+    compileAll(jobs, opts, n_workers, session.toolchains, out, build);
+
+    out << fmt::format("{} of {} programs built in {:.1f} ms\n",
+                       jobs.size() - n_failed,
+                       jobs.size(),
+                       millisecondsSince(batch_start));
+
+    GraphRenderer::instance().wait();
+    trace::finish(cli.trace_file, out);
+
+    if (cache) {
+        cache->flushStats();
+        if (cli.cache_stats) cache->printStats(out);
+    }
+    return n_failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,17 @@
+#pragma once
+
+#include "Driver.h"
+
+/**
+ * Batch mode: build many unrelated programs in one process, sharing targets, `TargetMachine`s
+ * and pass pipelines between them.
+ *
+ * @manifest: one program per line, `<source> [<output>]`. The output defaults to the source
+ *            path without extension, `.ll` and `.o` are written next to it. Blank lines and
+ *            lines starting with `#` are skipped, relative paths are relative to the working
+ *            directory.
+ *
+ * A line of status and timing is printed to `out` per program, failures don't stop the batch.
+ * Returns 1 if any program failed.
+ */
+int runBatch(OptHandler const &cli, DriverSession &session, llvm::raw_ostream &out);
@@ -0,0 +1,205 @@
+#include "CompileCache.h"
+#include "IRGenerator.h"
+#include "utility.hpp"
+
+#include "llvm/Config/llvm-config.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Program.h"
+#include "llvm/Support/SHA1.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <fstream>
+#include <map>
+
+using namespace llvm;
+
+namespace {
+
+/// exclusive lock on `<dir>/lock`, shared by all processes using the directory
+class DirLock {
+public:
+    DirLock(fs::path const &dir, bool wait) {
+        auto lock_path = (dir / "lock").native();
+        if (sys::fs::openFileForReadWrite(lock_path, fd, sys::fs::CD_OpenAlways, sys::fs::OF_None))
+            return;
+        locked = !(wait ? sys::fs::lockFile(fd) : sys::fs::tryLockFile(fd));
+    }
+    ~DirLock() {
+        if (locked) sys::fs::unlockFile(fd);
+        if (fd >= 0) sys::fs::closeFile(fd);
+    }
+    explicit operator bool() const { return locked; }
+
+private:
+    int fd = -1;
+    bool locked = false;
+};
+
+/// SHA1 of the running `tinycc` binary, so that any rebuild of the compiler gets keys of its own
+std::string const &compilerIdentity() {
+    static const std::string identity = [] {
+        static int anchor;
+        auto exe = sys::fs::getMainExecutable(nullptr, &anchor);
+        auto buffer = MemoryBuffer::getFile(exe, false, false);
+        if (!buffer) return fmt::format("{} {} {}", TINYCC_VERSION, __DATE__, __TIME__);
+        return toHex(SHA1::hash(arrayRefFromStringRef((*buffer)->getBuffer())), true);
+    }();
+    return identity;
+}
+
+} // namespace
+
+CompileCache::CompileCache(fs::path dir, uint64_t max_bytes)
+    : m_dir(std::move(dir)), m_max_bytes(max_bytes) {
+    std::error_code ec;
+    fs::create_directories(m_dir, ec);
+}
+
+std::string CompileCache::key(std::string_view source, CompileOptions const &opts,
+                              std::string_view pch) {
+    SHA1 hasher;
+    hasher.update(fmt::format("tinycc:{};llvm:{};triple:{};cpu:{};O:{};lto:{};pch:{};ast:{}\n",
+                              compilerIdentity(),
+                              LLVM_VERSION_STRING,
+                              IRToolchain::targetTriple(),
+                              IRToolchain::target_cpu,
+                              opts.opt_level,
+                              opts.thinLTO ? "thin" : "none",
+                              pch.size(),
+                              opts.fromASTBin));
+    hasher.update(StringRef(pch.data(), pch.size()));
+    hasher.update(StringRef(source.data(), source.size()));
+    return toHex(hasher.final(), true);
+}
+
+fs::path CompileCache::entryPath(std::string const &key, std::string_view ext) const {
+    return m_dir / fmt::format("{}{}", key, ext);
+}
+
+bool CompileCache::fetch(std::string const &key, std::string const &out_stem) {
+    for (std::string_view ext : {".ll", ".o"}) {
+        std::error_code ec;
+        auto entry = entryPath(key, ext);
+        // entries may be evicted by other processes at any time, treat every failure as a miss
+        fs::copy_file(entry,
+                      fmt::format("{}{}", out_stem, ext),
+                      fs::copy_options::overwrite_existing,
+                      ec);
+        if (ec) {
+            ++m_misses;
+            return false;
+        }
+        fs::last_write_time(entry, fs::file_time_type::clock::now(), ec); // LRU bookkeeping
+    }
+    ++m_hits;
+    dbg_print("[DEBUG] cache hit {}\n", key);
+    return true;
+}
+
+void CompileCache::store(std::string const &key, std::string const &out_stem) {
+    for (std::string_view ext : {".ll", ".o"}) {
+        // copy to a private file first, then publish it atomically
+        SmallString<128> tmp_path;
+        if (sys::fs::createUniqueFile((m_dir / "tmp-%%%%%%%%").native(), tmp_path)) return;
+
+        std::error_code ec;
+        fs::copy_file(fmt::format("{}{}", out_stem, ext),
+                      tmp_path.str().str(),
+                      fs::copy_options::overwrite_existing,
+                      ec);
+        if (!ec) fs::rename(tmp_path.str().str(), entryPath(key, ext), ec);
+        if (ec) {
+            fs::remove(tmp_path.str().str(), ec);
+            return;
+        }
+    }
+    evict();
+}
+
+void CompileCache::evict() {
+    // the `.ll` and `.o` of a key are one entry: a fetch misses unless both are there
+    struct Entry {
+        std::vector<fs::path> files;
+        fs::file_time_type mtime; // of the most recently used file
+        uint64_t size = 0;
+    };
+
+    auto list_entries = [this](std::vector<Entry> &entries) {
+        uint64_t total = 0;
+        std::map<std::string, Entry> by_key;
+        std::error_code ec;
+        for (const auto &file : fs::directory_iterator{m_dir, ec}) {
+            auto ext = file.path().extension();
+            if (ext != ".ll" && ext != ".o") continue;
+            auto mtime = file.last_write_time(ec);
+            auto size = file.file_size(ec);
+            if (ec) continue; // evicted by someone else meanwhile
+            auto &entry = by_key[file.path().stem().native()];
+            entry.files.push_back(file.path());
+            entry.mtime = std::max(entry.mtime, mtime);
+            entry.size += size;
+            total += size;
+        }
+        for (auto &[key, entry] : by_key) {
+            entries.push_back(std::move(entry));
+        }
+        return total;
+    };
+
+    std::vector<Entry> entries;
+    uint64_t total = list_entries(entries);
+    if (total <= m_max_bytes) return;
+
+    DirLock lock{m_dir, false};
+    if (!lock) return; // another process is cleaning up
+
+    entries.clear();
+    total = list_entries(entries);
+    std::sort(entries.begin(), entries.end(), [](const auto &lhs, const auto &rhs) {
+        return lhs.mtime < rhs.mtime;
+    });
+
+    // shrink to 3/4 of the limit, so that we don't evict on every store
+    for (const auto &entry : entries) {
+        if (total <= m_max_bytes / 4 * 3) break;
+        for (const auto &file : entry.files) {
+            std::error_code ec;
+            fs::remove(file, ec);
+        }
+        ++m_evictions;
+        total -= entry.size;
+    }
+}
+
+void CompileCache::flushStats() {
+    DirLock lock{m_dir, true};
+    if (!lock) return;
+
+    auto stats_path = m_dir / "stats";
+    {
+        std::ifstream in{stats_path};
+        in >> m_total.hits >> m_total.misses >> m_total.evictions;
+        if (!in) m_total = Stats{};
+    }
+
+    Stats delta{m_hits.exchange(0), m_misses.exchange(0), m_evictions.exchange(0)};
+    m_session += delta;
+    m_total += delta;
+
+    std::ofstream out{stats_path, std::ios_base::trunc};
+    out << m_total.hits << ' ' << m_total.misses << ' ' << m_total.evictions << '\n';
+}
+
+void CompileCache::printStats(raw_ostream &os) const {
+    auto print = [&os](std::string_view what, Stats const &stats) {
+        os << fmt::format("  {:<8} {} hits, {} misses, {} evictions\n",
+                          what,
+                          stats.hits,
+                          stats.misses,
+                          stats.evictions);
+    };
+    os << fmt::format("compile cache '{}':\n", m_dir.native());
+    print("session", m_session);
+    print("total", m_total);
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include "OptHandler.h"
+
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <string_view>
+
+namespace fs = std::filesystem;
+
+namespace llvm {
+class raw_ostream;
+}
+
+/**
+ * On-disk cache of compiled translation units, content addressed by the source bytes, the options
+ * that affect codegen and a hash of the `tinycc` binary, so a rebuilt compiler never reuses them.
+ *
+ * Entries are published with an atomic rename, so concurrent processes sharing a directory only
+ * ever observe complete entries. When the directory grows over its size limit, least recently
+ * used entries, the `.ll` and `.o` of a key together, are evicted by whichever process holds the
+ * directory lock.
+ */
+class CompileCache {
+public:
+    CompileCache(fs::path dir, uint64_t max_bytes);
+
+    /// cache key of `source` compiled with `opts`, after the precompiled header `pch` if any
+    [[nodiscard]] static std::string key(std::string_view source, CompileOptions const &opts,
+                                         std::string_view pch = {});
+
+    /// copy cached `.ll` and `.o` of `key` to `<out_stem>.ll` and `<out_stem>.o`
+    bool fetch(std::string const &key, std::string const &out_stem);
+    /// publish `<out_stem>.ll` and `<out_stem>.o` under `key`
+    void store(std::string const &key, std::string const &out_stem);
+
+    /// add counters of this process to the totals kept in the cache directory
+    void flushStats();
+    void printStats(llvm::raw_ostream &os) const;
+
+private:
+    struct Stats {
+        uint64_t hits = 0, misses = 0, evictions = 0;
+
+        Stats &operator+=(Stats const &other) {
+            hits += other.hits;
+            misses += other.misses;
+            evictions += other.evictions;
+            return *this;
+        }
+    };
+
+    [[nodiscard]] fs::path entryPath(std::string const &key, std::string_view ext) const;
+    void evict();
+
+    fs::path m_dir;
+    uint64_t m_max_bytes;
+    std::atomic<uint64_t> m_hits = 0, m_misses = 0, m_evictions = 0;
+    Stats m_session; // flushed counters of this process
+    Stats m_total;   // totals of all processes, valid after `flushStats`
+};
@@ -0,0 +1,583 @@
+#include "Driver.h"
+#include "ASTArena.h"
+#include "ASTBuilder.h"
+#include "ASTPrinter.h"
+#include "ASTSnapshot.h"
+#include "ByteCharStream.h"
+#include "CLexer.h"
+#include "CompactAST.h"
+#include "CompileCache.h"
+#include "GraphRenderer.h"
+#include "CParser.h"
+#include "FastLexer.h"
+#include "FastParser.h"
+#include "IRGenerator.h"
+#include "JIT.h"
+#include "Linker.h"
+#include "PCH.h"
+#include "Preprocessor.h"
+#include "Trace.h"
+#include "antlr4-runtime.h"
+
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <atomic>
+#include <future>
+#include <set>
+#include <thread>
+
+using namespace antlrcpp;
+using namespace antlr4;
+
+// ------------ Implementation of `ToolchainPool` -------------------
+
+ToolchainPool::ToolchainPool() = default;
+ToolchainPool::~ToolchainPool() = default;
+
+std::unique_ptr<IRToolchain> ToolchainPool::acquire(CompileOptions const &opts) {
+    {
+        std::lock_guard lock{m_mutex};
+        auto it = std::find_if(m_idle.begin(), m_idle.end(), [&](const auto &toolchain) {
+            return toolchain->compatible(opts);
+        });
+        if (it != m_idle.end()) {
+            auto ret = std::move(*it);
+            m_idle.erase(it);
+            return ret;
+        }
+    }
+    return std::make_unique<IRToolchain>(opts);
+}
+
+void ToolchainPool::release(std::unique_ptr<IRToolchain> toolchain) {
+    std::lock_guard lock{m_mutex};
+    m_idle.push_back(std::move(toolchain));
+}
+
+// ------------ Compilation -------------------
+
+static std::unique_ptr<llvm::MemoryBuffer> loadSource(CompileJob const &job) {
+    // map the source read-only instead of copying it, the lexer reads the bytes in place
+    if (job.source) {
+        return llvm::MemoryBuffer::getMemBuffer(*job.source, job.input.native(), false);
+    }
+
+    auto file = llvm::MemoryBuffer::getFile(job.input.native(), false, false);
+    if (!file) {
+        throw_err<std::runtime_error>("cannot read file: {}", file.getError().message());
+    }
+    return std::move(*file);
+}
+
+/// the PCH of `-include-pch`, if any
+static std::unique_ptr<PrecompiledHeader> loadPCH(CompileOptions const &opts) {
+    if (opts.include_pch.empty()) return nullptr;
+    trace::Scope span{"LoadPCH", opts.include_pch};
+    return PrecompiledHeader::load(opts.include_pch);
+}
+
+/// `source` with its directives and macros expanded, kept in `buffer` if there are any. Macros of
+/// `pch` are defined beforehand
+static std::string_view preprocess(CompileJob const &job, std::string_view source,
+                                   CompileOptions const &opts, HeaderCache &headers,
+                                   PrecompiledHeader const *pch, std::string &buffer) {
+    auto pch_macros = pch ? pch->macros() : std::vector<std::string_view>{};
+    if (!Preprocessor::needed(source, opts.defines) && pch_macros.empty()) return source;
+
+    trace::Scope span{"Preprocess"};
+    Preprocessor preprocessor{headers, opts.include_dirs, opts.defines};
+    for (auto macro : pch_macros) preprocessor.defineMacro(macro);
+    buffer = preprocessor.run(source, job.input.native());
+    return buffer;
+}
+
+/// what `generateIR` reads from `buffer`: the preprocessed source, or a saved AST as it is
+static std::string_view frontEndInput(CompileJob const &job, llvm::MemoryBuffer const &buffer,
+                                      CompileOptions const &opts, HeaderCache &headers,
+                                      PrecompiledHeader const *pch, std::string &preprocessed) {
+    std::string_view bytes{buffer.getBufferStart(), buffer.getBufferSize()};
+    if (opts.fromASTBin) return bytes;
+    return preprocess(job, bytes, opts, headers, pch, preprocessed);
+}
+
+/// parse with SLL prediction and bail out at the first syntax error. SLL is enough for nearly all
+/// inputs and much cheaper, only if it fails the input is parsed again with full LL prediction and
+/// the usual error recovery, so that errors are reported as before
+static tree::ParseTree *parseTwoStage(CParser &parser, bool quiet) {
+    auto *interpreter = parser.getInterpreter<atn::ParserATNSimulator>();
+    interpreter->setPredictionMode(atn::PredictionMode::SLL);
+    parser.setErrorHandler(std::make_shared<BailErrorStrategy>());
+    parser.removeErrorListeners();
+    try {
+        return parser.prog();
+    } catch (ParseCancellationException const &) {
+        trace::Scope span{"ParseLL"};
+        parser.reset(); // rewinds the token stream too
+        if (!quiet) parser.addErrorListener(&ConsoleErrorListener::INSTANCE);
+        parser.setErrorHandler(std::make_shared<DefaultErrorStrategy>());
+        interpreter->setPredictionMode(atn::PredictionMode::LL);
+        return parser.prog();
+    }
+}
+
+/// top level declarations of `source`, through ANTLR's `CParser` and `ASTBuilder`. `quiet` keeps
+/// syntax errors off the console
+static std::vector<Expr *> parseWithANTLR(CompileJob const &job, std::string_view source,
+                                          CompileOptions const &opts, ASTArena &arena,
+                                          bool quiet = false) {
+    ByteCharStream input(source, job.input.native());
+    std::unique_ptr<TokenSource> lexer;
+    if (opts.lexer == LexerKind::Fast) {
+        trace::Scope span{"Lex"};
+        auto fast_tokens = FastLexer{source, job.input.native()}.lex();
+        if (opts.verifyLexer) FastLexer::verify(source, fast_tokens, job.input.native());
+        lexer = std::make_unique<FastTokenSource>(std::move(fast_tokens), source, input);
+    } else {
+        auto clexer = std::make_unique<CLexer>(&input);
+        if (quiet) clexer->removeErrorListeners();
+        lexer = std::move(clexer);
+    }
+    CommonTokenStream tokens(lexer.get());
+    {
+        trace::Scope span{"Lex"};
+        tokens.fill();
+    }
+
+    CParser parser(&tokens);
+    if (quiet) parser.removeErrorListeners();
+    tree::ParseTree *tree;
+    {
+        trace::Scope span{"Parse"};
+        tree = opts.sllParse ? parseTwoStage(parser, quiet) : parser.prog();
+    }
+
+    ASTBuilder visitor{arena};
+    {
+        trace::Scope span{"BuildAST"};
+        visitor.visit(tree);
+    }
+    return std::move(visitor.m_decls);
+}
+
+/// top level declarations of `source`, through `FastLexer` and `FastParser`
+static std::vector<Expr *> parseFast(CompileJob const &job, std::string_view source,
+                                     CompileOptions const &opts, ASTArena &arena) {
+    std::vector<FastToken> tokens;
+    {
+        trace::Scope span{"Lex"};
+        tokens = FastLexer{source, job.input.native()}.lex();
+        if (opts.verifyLexer) FastLexer::verify(source, tokens, job.input.native());
+    }
+
+    trace::Scope span{"Parse"};
+    return FastParser{source, std::move(tokens), arena}.parse();
+}
+
+void warmUpParser(OptHandler const &cli, DriverSession &session, llvm::raw_ostream &diag) {
+    if (cli.parser_warmup.empty()) return;
+
+    // the prediction DFA is shared by all `CParser`s of the process, so later parses of similar
+    // code find their decisions there instead of simulating the ATN
+    std::vector<std::string> files{cli.parser_warmup.begin(), cli.parser_warmup.end()};
+    std::call_once(session.parser_warmup, [&] {
+        trace::Scope span{"WarmUpParser"};
+        session.parser_warmup_files = files;
+        CompileOptions opts = cli.compileOptions();
+        opts.parser = ParserKind::ANTLR;
+        for (const auto &path : cli.parser_warmup) {
+            auto file = llvm::MemoryBuffer::getFile(path, false, false);
+            if (!file) {
+                diag << fmt::format("warning: cannot read parser warm-up file '{}': {}\n",
+                                    path,
+                                    file.getError().message());
+                continue;
+            }
+            std::string_view source{(*file)->getBufferStart(), (*file)->getBufferSize()};
+            try {
+                // preprocessed like any input, syntax errors don't matter here
+                CompileJob job{.input = path};
+                std::string preprocessed;
+                source = preprocess(job, source, opts, session.headers, nullptr, preprocessed);
+                ASTArena arena;
+                parseWithANTLR(job, source, opts, arena, true);
+            } catch (std::exception const &e) {
+                diag << fmt::format("warning: parser warm-up file '{}': {}\n", path, e.what());
+            }
+        }
+    });
+    if (files != session.parser_warmup_files) {
+        diag << fmt::format("warning: the parser was warmed up with '{}' already, --parser-warmup "
+                            "is ignored\n",
+                            fmt::join(session.parser_warmup_files, ","));
+    }
+}
+
+/// top level declarations of `source` in `arena`, with the parser chosen by `opts`
+static std::vector<Expr *> parse(CompileJob const &job, std::string_view source,
+                                 CompileOptions const &opts, ASTArena &arena) {
+    return opts.parser == ParserKind::Fast ? parseFast(job, source, opts, arena)
+                                           : parseWithANTLR(job, source, opts, arena);
+}
+
+/// `--time-report` counters of the nodes in `arena`
+static void countAST(ASTArena const &arena) {
+    trace::count("AST nodes", arena.nodes());
+    trace::count("AST bytes", arena.bytes());
+    trace::count("AST allocations", arena.blocks());
+}
+
+/// DOT text of the trees of `ast` for `--emit-ast`, the pics are rendered in the background.
+/// They are prefixed with `unit`, as other translation units write into the same directory
+static void dumpAST(CompactAST const &ast, CompileOptions const &opts, std::string const &unit) {
+    trace::Scope span{"DumpAST"};
+    for (int i = 0; auto root : ast.roots()) {
+        assert(ast.is<FuncDef>(root) || ast.is<InitExpr>(root) || ast.is<FuncProto>(root));
+        fs::path pic_path{opts.pic_outdir};
+        if (ast.is<FuncDef>(root)) {
+            pic_path.append(fmt::format("{}.func:{}", unit, ast.name(ast.child(root, 0))));
+        } else {
+            pic_path.append(fmt::format("{}.global_decl{}", unit, i++));
+        }
+        ASTPrinter{ast, root, opts.debugSExpr}.ToPNG(pic_path);
+    }
+}
+
+std::unique_ptr<IRGenerator> generateIR(CompileJob const &job, std::string_view source,
+                                        CompileOptions const &opts, IRToolchain &toolchain,
+                                        PrecompiledHeader const *pch) {
+    // the trees are read-only, so they are printed while the IR is generated
+    std::future<void> dump;
+    auto startDump = [&](auto flatten) {
+        if (!opts.emitAST) return;
+        dump = std::async(std::launch::async, [&opts, &job, flatten] {
+            trace::ThreadScope thread_trace;
+            dumpAST(flatten(), opts, job.input.stem().native());
+        });
+    };
+
+    std::unique_ptr<IRGenerator> builder;
+    if (opts.fromASTBin) {
+        // saved with the declarations of its PCH, if any. Simplified and printed as it is, only
+        // the simplified trees are expanded
+        CompactAST ast;
+        {
+            trace::Scope span{"LoadAST"};
+            ast = CompactAST::view(source, job.input.native());
+        }
+        trace::count("AST nodes", ast.size());
+        trace::count("AST bytes", ast.bytes());
+        startDump([ast] { return ast; });
+        builder = std::make_unique<IRGenerator>(ast, toolchain, job.input.native());
+    } else {
+        // the trees are only needed until codegen is done
+        auto arena = std::make_shared<ASTArena>();
+        std::vector<Expr *> decls;
+        if (pch) {
+            trace::Scope span{"ReadPCH"};
+            decls = pch->decls(*arena);
+        }
+        auto parsed = parse(job, source, opts, *arena);
+        decls.insert(decls.end(), parsed.begin(), parsed.end());
+        countAST(*arena);
+        ASTSnapshot ast{{decls.begin(), decls.end()}, {arena}};
+        startDump([ast] { return CompactAST{ast.decls()}; });
+        builder = std::make_unique<IRGenerator>(ast, toolchain, job.input.native());
+    }
+    builder->codegen();
+    if (dump.valid()) dump.get();
+    return builder;
+}
+
+fs::path compileUnit(CompileJob const &job, CompileOptions const &opts, IRToolchain &toolchain,
+                     HeaderCache &headers, CompileCache *cache) {
+    trace::Scope unit_span{"Compile", job.input.native()};
+
+    auto buffer = loadSource(job);
+    auto pch = loadPCH(opts);
+    std::string preprocessed; // keyed by the cache, so are the headers it includes
+    std::string_view source = frontEndInput(job, *buffer, opts, headers, pch.get(), preprocessed);
+
+    fs::path obj_path = fmt::format("{}.o", job.out_stem);
+
+    // side outputs (pics) need the real pipeline to run
+    std::string cache_key;
+    if (cache && !opts.emitAST && !opts.emitCFG) {
+        cache_key = CompileCache::key(source, opts, pch ? pch->bytes() : "");
+        if (cache->fetch(cache_key, job.out_stem)) return obj_path;
+    }
+
+    auto builder = generateIR(job, source, opts, toolchain, pch.get());
+
+    builder->dumpIR(fmt::format("{}.ll", job.out_stem));
+    if (opts.thinLTO) {
+        builder->emitBitcode(obj_path);
+    } else if (opts.codegen_threads > 1) {
+        auto parts = builder->emitOBJParts(job.out_stem, opts.codegen_threads);
+        trace::Scope span{"CombineOBJ", obj_path.native()};
+        std::vector<std::string> part_names;
+        for (const auto &part : parts) part_names.push_back(part.native());
+        linkRelocatable(obj_path.native(), part_names);
+        for (const auto &part : parts) fs::remove(part);
+    } else {
+        builder->emitOBJ(obj_path);
+    }
+
+    if (!cache_key.empty()) cache->store(cache_key, job.out_stem);
+    return obj_path;
+}
+
+llvm::orc::ThreadSafeModule compileUnitForJIT(CompileJob const &job, CompileOptions const &opts,
+                                              IRToolchain &toolchain, HeaderCache &headers) {
+    trace::Scope unit_span{"Compile", job.input.native()};
+
+    auto buffer = loadSource(job);
+    auto pch = loadPCH(opts);
+    std::string preprocessed;
+    std::string_view source = frontEndInput(job, *buffer, opts, headers, pch.get(), preprocessed);
+    return generateIR(job, source, opts, toolchain, pch.get())->takeModule();
+}
+
+void precompileHeader(CompileJob const &job, CompileOptions const &opts, HeaderCache &headers) {
+    trace::Scope unit_span{"Precompile", job.input.native()};
+
+    auto buffer = loadSource(job);
+    Preprocessor preprocessor{headers, opts.include_dirs, opts.defines};
+    std::string source;
+    {
+        trace::Scope span{"Preprocess"};
+        source = preprocessor.run({buffer->getBufferStart(), buffer->getBufferSize()},
+                                  job.input.native());
+    }
+    ASTArena arena;
+    auto decls = parse(job, source, opts, arena);
+    countAST(arena);
+
+    // the PCH goes out of date with any of them, a header from stdin with none
+    std::vector<fs::path> files;
+    if (!job.source) files.push_back(fs::absolute(job.input).lexically_normal());
+    for (const auto &file : preprocessor.includedFiles()) files.emplace_back(file->path);
+
+    trace::Scope span{"WritePCH"};
+    PrecompiledHeader::write(fmt::format("{}.pch", job.out_stem),
+                             decls,
+                             preprocessor.macroDefinitions(),
+                             files);
+}
+
+void saveAST(CompileJob const &job, CompileOptions const &opts, HeaderCache &headers) {
+    trace::Scope unit_span{"SaveAST", job.input.native()};
+
+    auto buffer = loadSource(job);
+    auto pch = loadPCH(opts);
+    std::string preprocessed;
+    std::string_view source = preprocess(job,
+                                         {buffer->getBufferStart(), buffer->getBufferSize()},
+                                         opts,
+                                         headers,
+                                         pch.get(),
+                                         preprocessed);
+    ASTArena arena;
+    std::vector<Expr *> decls;
+    if (pch) decls = pch->decls(arena);
+    auto parsed = parse(job, source, opts, arena);
+    decls.insert(decls.end(), parsed.begin(), parsed.end());
+    countAST(arena);
+
+    trace::Scope span{"WriteAST"};
+    CompactAST{decls}.save(fmt::format("{}.ast", job.out_stem));
+}
+
+bool compileAll(std::vector<CompileJob> const &jobs, CompileOptions const &opts,
+                unsigned n_workers, ToolchainPool &toolchains, llvm::raw_ostream &diag,
+                UnitAction const &action) {
+    if (jobs.empty()) return true;
+
+    std::atomic<size_t> next_job = 0;
+    std::mutex diag_mutex;
+    bool success = true;
+
+    // every worker owns an LLVMContext per job and a toolchain, nothing else is shared
+    auto worker = [&] {
+        auto toolchain = toolchains.acquire(opts);
+        for (size_t i; (i = next_job++) < jobs.size();) {
+            try {
+                action(i, *toolchain);
+            } catch (std::exception const &e) {
+                std::lock_guard lock{diag_mutex};
+                diag << fmt::format("{}: error: {}\n", jobs[i].input.native(), e.what());
+                success = false;
+            }
+        }
+        toolchains.release(std::move(toolchain));
+    };
+
+    n_workers = std::clamp<size_t>(n_workers, 1, jobs.size());
+    std::vector<std::thread> pool;
+    pool.reserve(n_workers - 1);
+    for (unsigned i = 1; i < n_workers; ++i) {
+        pool.emplace_back([&worker] {
+            trace::ThreadScope thread_trace;
+            worker();
+        });
+    }
+    worker(); // main thread works as well
+    for (auto &thread : pool) thread.join();
+
+    return success;
+}
+
+LinkOptions linkOptions(OptHandler const &cli, unsigned n_workers) {
+    return LinkOptions{
+        .gcc_lib_version = cli.gcc_lib_version,
+        .stdlib_path = cli.stdlib_path,
+        .thin_lto = cli.lto == LTOKind::Thin,
+        .lto_opt_level = cli.opt_level,
+        .lto_cpu = std::string{IRToolchain::target_cpu},
+        .lto_jobs = n_workers,
+        .lto_cache_dir = cli.cache_dir.empty() ? "" : cli.cache_dir.getValue() + "/thinlto",
+    };
+}
+
+int runDriver(OptHandler const &cli, DriverSession &session, llvm::raw_ostream &diag,
+              std::string const *stdin_source) {
+    fs::path exe_name{session.exe_path};
+    if (cli.input_filenames.empty()) {
+        diag << fmt::format("{}: error: no input files\n", exe_name.filename().native());
+        return 1;
+    }
+    for (const auto &input : cli.input_filenames) {
+        if (input == "-" ? !stdin_source : !fs::exists(input)) {
+            diag << fmt::format("{}: error: no such file: '{}'\n",
+                                exe_name.filename().native(),
+                                input);
+            return 1;
+        }
+    }
+
+    const CompileOptions opts = cli.compileOptions();
+    const auto &output_dir = opts.pic_outdir;
+
+    if (opts.emitAST || opts.emitCFG) {
+        fs::create_directory(output_dir.c_str());
+        for (const auto &dir_entry : fs::directory_iterator{output_dir.c_str()}) {
+            fs::remove_all(dir_entry);
+        }
+    }
+
+    std::string out_name;
+    if (cli.output_filename.empty()) {
+        fs::path input{cli.input_filenames.front() == "-" ? "a" : cli.input_filenames.front()};
+        out_name = input.stem();
+    } else {
+        fs::path output{cli.output_filename.c_str()};
+        output.replace_extension("");
+        out_name = output;
+    }
+
+    // `.ll` and `.o` are named after the executable for a single input, after each input otherwise
+    std::vector<CompileJob> jobs;
+    std::set<std::string> stems;
+    for (const auto &input : cli.input_filenames) {
+        fs::path input_path{input};
+        std::string stem =
+            cli.input_filenames.size() == 1 ? out_name : input_path.stem().native();
+        if (!stems.insert(stem).second) {
+            diag << fmt::format("{}: error: multiple inputs would write to '{}.o'\n",
+                                exe_name.filename().native(),
+                                stem);
+            return 1;
+        }
+        jobs.push_back(CompileJob{
+            .input = std::move(input_path),
+            .out_stem = std::move(stem),
+            .source = input == "-" ? std::optional{*stdin_source} : std::nullopt,
+        });
+    }
+
+    std::unique_ptr<CompileCache> cache;
+    if (!cli.cache_dir.empty()) {
+        cache = std::make_unique<CompileCache>(cli.cache_dir.getValue(),
+                                               uint64_t{cli.cache_size} << 20);
+    }
+
+    trace::start(!cli.trace_file.empty(), cli.time_report);
+    warmUpParser(cli, session, diag);
+
+    unsigned n_workers = cli.jobs ? cli.jobs : std::thread::hardware_concurrency();
+
+    if (cli.emit_pch) {
+        // --emit-pch: the inputs are headers, each becomes a `.pch` and nothing is linked
+        auto to_pch = [&](size_t i, IRToolchain &) {
+            precompileHeader(jobs[i], opts, session.headers);
+        };
+        bool success = compileAll(jobs, opts, n_workers, session.toolchains, diag, to_pch);
+        trace::finish(cli.trace_file, diag);
+        return success ? 0 : 1;
+    }
+
+    if (cli.emit_ast_bin) {
+        // --emit-ast-bin: each input is parsed into a `.ast` for --from-ast-bin, nothing is linked
+        auto to_ast = [&](size_t i, IRToolchain &) { saveAST(jobs[i], opts, session.headers); };
+        bool success = compileAll(jobs, opts, n_workers, session.toolchains, diag, to_ast);
+        trace::finish(cli.trace_file, diag);
+        return success ? 0 : 1;
+    }
+
+    if (cli.run) {
+        // --run: keep the optimized modules in memory and execute them, nothing is written.
+        // --tiered optimizes while running instead, only what turns out to be hot
+        CompileOptions run_opts = opts;
+        run_opts.thinLTO = false;
+        if (cli.tiered) run_opts.opt_level = 0;
+
+        std::vector<llvm::orc::ThreadSafeModule> modules(jobs.size());
+        auto to_module = [&](size_t i, IRToolchain &toolchain) {
+            modules[i] = compileUnitForJIT(jobs[i], run_opts, toolchain, session.headers);
+        };
+        bool success =
+            compileAll(jobs, run_opts, n_workers, session.toolchains, diag, to_module);
+        int exit_code = 1;
+        if (success) {
+            try {
+                trace::Scope span{"Run"};
+                exit_code = cli.tiered ? runTieredJIT(std::move(modules), cli.stdlib_path,
+                                                      cli.tier_threshold)
+                                       : runJIT(std::move(modules), cli.stdlib_path);
+            } catch (std::exception const &e) {
+                diag << fmt::format("{}: error: {}\n", exe_name.filename().native(), e.what());
+            }
+        }
+        GraphRenderer::instance().wait();
+        trace::finish(cli.trace_file, diag);
+        return exit_code;
+    }
+
+    auto to_object = [&](size_t i, IRToolchain &toolchain) {
+        compileUnit(jobs[i], opts, toolchain, session.headers, cache.get());
+    };
+    bool success = compileAll(jobs, opts, n_workers, session.toolchains, diag, to_object);
+    int link_result = 0;
+
+    if (success) {
+        std::vector<std::string> objs;
+        for (const auto &job : jobs) objs.push_back(job.out_stem + ".o");
+
+        trace::Scope span{"Link", out_name};
+        try {
+            linkExecutable(out_name, objs, linkOptions(cli, n_workers));
+        } catch (std::exception const &e) {
+            diag << fmt::format("{}: error: {}\n", exe_name.filename().native(), e.what());
+            link_result = 1;
+        }
+    }
+
+    GraphRenderer::instance().wait();
+    trace::finish(cli.trace_file, diag);
+
+    if (cache) {
+        cache->flushStats();
+        if (cli.cache_stats) cache->printStats(diag);
+    }
+    return success && link_result == 0 ? 0 : 1;
+}
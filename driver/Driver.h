@@ -0,0 +1,100 @@
+#pragma once
+
+#include "Linker.h"
+#include "OptHandler.h"
+#include "Preprocessor.h"
+
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace llvm {
+class raw_ostream;
+namespace orc {
+class ThreadSafeModule;
+}
+} // namespace llvm
+
+class IRGenerator;
+class IRToolchain;
+class CompileCache;
+class PrecompiledHeader;
+
+/// one translation unit: a source file compiled into `<out_stem>.ll` and `<out_stem>.o`
+struct CompileJob {
+    fs::path input;
+    std::string out_stem;              // output path without extension
+    std::optional<std::string> source; // in-memory source, read `input` if not provided
+};
+
+/// keeps initialized `IRToolchain`s around, so that targets, `TargetMachine` and pass pipelines
+/// are built once per process instead of once per translation unit
+class ToolchainPool {
+public:
+    ToolchainPool();
+    ~ToolchainPool();
+
+    /// take an idle toolchain built for `opts`, or build a new one
+    std::unique_ptr<IRToolchain> acquire(CompileOptions const &opts);
+    void release(std::unique_ptr<IRToolchain> toolchain);
+
+private:
+    std::mutex m_mutex;
+    std::vector<std::unique_ptr<IRToolchain>> m_idle;
+};
+
+/// state shared by all compilations in a `tinycc` process or `--serve` session
+struct DriverSession {
+    std::string exe_path; // argv[0]
+    ToolchainPool toolchains;
+    HeaderCache headers;
+    std::once_flag parser_warmup;
+    std::vector<std::string> parser_warmup_files; // `--parser-warmup` of the first job
+};
+
+/// parse the `--parser-warmup` sources once per session, to fill `CParser`'s prediction DFA
+void warmUpParser(OptHandler const &cli, DriverSession &session, llvm::raw_ostream &diag);
+
+/// front end and optimized IR of `source` in a fresh LLVMContext, after the declarations of `pch`
+std::unique_ptr<IRGenerator> generateIR(CompileJob const &job, std::string_view source,
+                                        CompileOptions const &opts, IRToolchain &toolchain,
+                                        PrecompiledHeader const *pch = nullptr);
+
+/// compile a single translation unit with a fresh LLVMContext, returns the object file path.
+/// with a `cache`, identical compilations are copied from it instead
+fs::path compileUnit(CompileJob const &job, CompileOptions const &opts, IRToolchain &toolchain,
+                     HeaderCache &headers, CompileCache *cache = nullptr);
+
+/// compile a single translation unit into an optimized module, without writing anything
+llvm::orc::ThreadSafeModule compileUnitForJIT(CompileJob const &job, CompileOptions const &opts,
+                                              IRToolchain &toolchain, HeaderCache &headers);
+
+/// precompile the header of `job` into `<out_stem>.pch`, for `-include-pch`
+void precompileHeader(CompileJob const &job, CompileOptions const &opts, HeaderCache &headers);
+
+/// parse `job` into `<out_stem>.ast`, with the declarations of `-include-pch` if any, for
+/// `--from-ast-bin`
+void saveAST(CompileJob const &job, CompileOptions const &opts, HeaderCache &headers);
+
+/// what to do with the job of given index, on a worker's toolchain
+using UnitAction = std::function<void(size_t, IRToolchain &)>;
+
+/// run `action` for all jobs on up to `n_workers` threads, report failures to `diag`.
+/// returns false if any of the jobs failed
+bool compileAll(std::vector<CompileJob> const &jobs, CompileOptions const &opts,
+                unsigned n_workers, ToolchainPool &toolchains, llvm::raw_ostream &diag,
+                UnitAction const &action);
+
+/// how to link what `cli` asks for, ThinLTO backends run on up to `n_workers` threads
+LinkOptions linkOptions(OptHandler const &cli, unsigned n_workers);
+
+/// compile and link what `cli` asks for, returns the exit code.
+/// `stdin_source` is the content of input `-`, if any
+int runDriver(OptHandler const &cli, DriverSession &session, llvm::raw_ostream &diag,
+              std::string const *stdin_source = nullptr);
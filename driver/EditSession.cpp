@@ -0,0 +1,46 @@
+#include "EditSession.h"
+#include "IRGenerator.h"
+#include "Trace.h"
+
+EditSession::EditSession(std::string source, std::string source_name, IRToolchain &toolchain)
+    : m_parser(std::move(source), std::move(source_name)), m_toolchain(toolchain) {}
+
+EditSession::~EditSession() = default;
+
+void EditSession::update() {
+    DeclUpdate update;
+    {
+        trace::Scope span{"Parse"};
+        update = m_parser.parse();
+    }
+    regenerate(update);
+}
+
+void EditSession::edit(TextEdit const &edit) {
+    DeclUpdate update;
+    {
+        trace::Scope span{"Parse"};
+        update = m_parser.edit(edit);
+    }
+    regenerate(update);
+}
+
+void EditSession::regenerate(DeclUpdate const &update) {
+    // a failed parse keeps the old declarations, so the module is still theirs. a failed codegen
+    // leaves it half done
+    const auto &decls = m_parser.decls();
+    if (m_generator) {
+        std::vector<Expr *> added{decls.begin() + update.first, decls.begin() + update.last};
+        try {
+            if (m_generator->updateFunctions(update.removed, added)) return;
+        } catch (...) {
+            m_generator.reset();
+            throw;
+        }
+    }
+
+    m_generator.reset();
+    auto generator = std::make_unique<IRGenerator>(m_parser.snapshot(), m_toolchain);
+    generator->codegen(false);
+    m_generator = std::move(generator);
+}
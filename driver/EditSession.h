@@ -0,0 +1,45 @@
+#pragma once
+
+#include "IncrementalParser.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+class IRGenerator;
+class IRToolchain;
+
+/**
+ * A source file kept open by an editor, recompiled on every edit. An edit re-parses the top level
+ * declarations it touches (see `IncrementalParser`), and if those are function definitions only,
+ * just these functions are regenerated in a module kept across edits. Otherwise the module is
+ * generated anew.
+ *
+ * The module isn't optimized: optimizing would inline functions into others, which an edit then
+ * can't replace alone.
+ */
+class EditSession {
+public:
+    EditSession(std::string source, std::string source_name, IRToolchain &toolchain);
+    ~EditSession();
+
+    /// parse and generate whatever is out of date, errors are thrown. `edit` does that too
+    void update();
+    /// apply `edit` to the source and `update()`. after an error, the parts that failed are
+    /// retried along with the next edit
+    void edit(TextEdit const &edit);
+
+    [[nodiscard]] std::string const &source() const { return m_parser.source(); }
+    [[nodiscard]] std::vector<Expr *> const &decls() const { return m_parser.decls(); }
+    /// `decls()` as of now, for readers on other threads
+    [[nodiscard]] ASTSnapshot snapshot() const { return m_parser.snapshot(); }
+    /// IR of `decls()`, null if the last update failed in codegen
+    [[nodiscard]] IRGenerator *ir() { return m_generator.get(); }
+
+private:
+    void regenerate(DeclUpdate const &update);
+
+    IncrementalParser m_parser;
+    IRToolchain &m_toolchain;
+    std::unique_ptr<IRGenerator> m_generator; // null if out of date
+};
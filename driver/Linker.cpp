@@ -0,0 +1,63 @@
+#include "Linker.h"
+#include "utility.hpp"
+
+#include "llvm/Support/Program.h"
+
+using namespace llvm;
+
+static std::string const &findLinker() {
+    static const std::string path = [] {
+        auto lld = sys::findProgramByName("ld.lld");
+        if (!lld) throw_err<std::runtime_error>("cannot find ld.lld: {}", lld.getError().message());
+        return *lld;
+    }();
+    return path;
+}
+
+static void runLinker(ArrayRef<StringRef> args) {
+    std::string err_msg;
+    int result = sys::ExecuteAndWait(args[0], args, None, {}, 0, 0, &err_msg);
+    if (result < 0) throw_err<std::runtime_error>("cannot run ld.lld: {}", err_msg);
+    if (result > 0) throw_err<std::runtime_error>("ld.lld failed with exit code {}", result);
+}
+
+void linkRelocatable(std::string const &output, std::vector<std::string> const &objects) {
+    SmallVector<StringRef, 16> args{findLinker(), "-r", "-o", output};
+    args.append(objects.begin(), objects.end());
+    runLinker(args);
+}
+
+void linkExecutable(std::string const &output, std::vector<std::string> const &objects,
+                    LinkOptions const &opts) {
+    const auto gcc_dir =
+        fmt::format("/usr/lib64/gcc/x86_64-pc-linux-gnu/{}", opts.gcc_lib_version);
+    const auto crtbegin = gcc_dir + "/crtbeginS.o", crtend = gcc_dir + "/crtendS.o";
+    const auto gcc_lib_dir = "-L" + gcc_dir;
+
+    SmallVector<StringRef, 48> args{
+        findLinker(), "-pie", "--eh-frame-hdr", "-m", "elf_x86_64",
+        "-dynamic-linker", "/lib64/ld-linux-x86-64.so.2", "-o", output,
+        "/usr/lib64/Scrt1.o", "/usr/lib64/crti.o", crtbegin,
+        gcc_lib_dir, "-L/usr/lib64", "-L/lib64", "-L/usr/lib", "-L/lib",
+    };
+    args.append(objects.begin(), objects.end());
+    args.append({
+        opts.stdlib_path, "-lgcc", "--as-needed", "-lgcc_s", "--no-as-needed", "-lc", "-lgcc",
+        "--as-needed", "-lgcc_s", "--no-as-needed", crtend, "/usr/lib64/crtn.o",
+    });
+
+    // ThinLTO: lld imports across modules, then runs the backends in parallel
+    std::vector<std::string> lto_args;
+    if (opts.thin_lto) {
+        lto_args.push_back(fmt::format("--lto-O{}", opts.lto_opt_level));
+        lto_args.push_back(fmt::format("-plugin-opt=mcpu={}", opts.lto_cpu));
+        lto_args.push_back(opts.lto_jobs ? fmt::format("--thinlto-jobs={}", opts.lto_jobs)
+                                         : "--thinlto-jobs=all");
+        if (!opts.lto_cache_dir.empty()) {
+            lto_args.push_back(fmt::format("--thinlto-cache-dir={}", opts.lto_cache_dir));
+        }
+    }
+    args.append(lto_args.begin(), lto_args.end());
+
+    runLinker(args);
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+struct LinkOptions {
+    std::string gcc_lib_version;
+    std::string stdlib_path;
+
+    // objects are ThinLTO bitcode, optimized and compiled by the linker
+    bool thin_lto = false;
+    int lto_opt_level = 2;
+    std::string lto_cpu;
+    unsigned lto_jobs = 0;       // 0: one backend per core
+    std::string lto_cache_dir;   // reuse backend results across links, if not empty
+};
+
+/// combine `objects` into a single relocatable object `output`, with `ld.lld -r`
+void linkRelocatable(std::string const &output, std::vector<std::string> const &objects);
+
+/// link `objects` with mystdlib and libc into the executable `output`, by running ld.lld directly
+/// with the arguments gcc would pass. Throws if the link fails
+void linkExecutable(std::string const &output, std::vector<std::string> const &objects,
+                    LinkOptions const &opts);
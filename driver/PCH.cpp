@@ -0,0 +1,374 @@
+#include "PCH.h"
+
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <deque>
+#include <map>
+#include <stdexcept>
+#include <unordered_map>
+#include <utility>
+
+namespace {
+
+// ------------ File layout -------------------
+//
+// a `Header`, then the sections in the order of `Section`, each an array of its record type.
+// `Ast` is the declarations as `CompactAST::serialize` writes them, viewed in place, so it comes
+// first and stays aligned. Other records are copied out with `memcpy` and need no alignment
+
+enum Section { Ast, Files, Strings, Params, Types, Macros, StringBytes, n_sections };
+
+constexpr std::array<char, 8> pch_magic{'t', 'i', 'n', 'y', 'p', 'c', 'h', '\0'};
+// nodes are numbered by `CompactAST`, whose own version is checked by `CompactAST::view`
+constexpr uint32_t pch_version = 2;
+
+struct Header {
+    std::array<char, 8> magic;
+    uint32_t version;
+    std::array<uint32_t, n_sections> counts; // records in each section
+};
+static_assert(sizeof(Header) % 8 == 0, "`Ast` must stay aligned for `CompactAST::view`");
+
+/// a file the PCH was built from, out of date if it no longer has this size and time
+struct FileRecord {
+    uint32_t path; // string
+    uint32_t padding = 0;
+    uint64_t size;
+    int64_t mtime; // ticks of `fs::file_time_type`
+};
+
+/// a piece of `StringBytes`
+struct StringRecord {
+    uint32_t offset, size;
+};
+
+/// a typedef of a builtin `type`, or of a function type returning it. For the latter, the type
+/// and name strings of `n_params` parameters start at `params` in `Params`
+struct TypeRecord {
+    uint8_t function;
+    std::array<uint8_t, 3> padding{};
+    uint32_t name, type; // strings
+    uint32_t params, n_params;
+};
+
+constexpr std::array<size_t, n_sections> record_size{
+    1,
+    sizeof(FileRecord),
+    sizeof(StringRecord),
+    sizeof(uint32_t),   // string of a `TypeRecord` parameter
+    sizeof(TypeRecord),
+    sizeof(uint32_t),   // string
+    1,
+};
+
+constexpr std::array builtin_types{
+    builtin::Int, builtin::Float, builtin::Char, builtin::Double, builtin::Void};
+
+int64_t fileTime(fs::path const &path) {
+    return fs::last_write_time(path).time_since_epoch().count();
+}
+
+// ------------ Writing -------------------
+
+/// a typedef resolved down to builtin types
+struct ResolvedType {
+    bool function = false;
+    std::string type;                // or return type
+    std::vector<std::string> params; // types
+    std::vector<std::string> param_names;
+};
+
+class Writer {
+public:
+    void write(std::string const &path, std::vector<Expr *> const &decls,
+               std::vector<std::string> const &macros, std::vector<fs::path> const &files);
+
+private:
+    uint32_t string(std::string_view text);
+
+    void typedefOf(Variable const &var);
+    void typedefOf(FuncProto const &proto);
+    ResolvedType resolve(Symbol name) const;
+
+    std::vector<FileRecord> m_files;
+    std::vector<StringRecord> m_strings;
+    std::string m_string_bytes;
+    std::unordered_map<std::string_view, uint32_t> m_string_index; // views of `m_owned`
+    std::deque<std::string> m_owned;
+    std::vector<uint32_t> m_params, m_macros;
+    std::vector<TypeRecord> m_types;
+    std::map<std::string, ResolvedType, std::less<>> m_typedefs;
+};
+
+void Writer::write(std::string const &path, std::vector<Expr *> const &decls,
+                   std::vector<std::string> const &macros, std::vector<fs::path> const &files) {
+    for (const auto &file : files) {
+        m_files.push_back(FileRecord{
+            .path = string(file.native()),
+            .size = fs::file_size(file),
+            .mtime = fileTime(file),
+        });
+    }
+
+    // typedefs go to the type table, the rest of a declaration stays
+    std::vector<Expr *> roots;
+    std::deque<Expr> rests;
+    for (const auto &decl : decls) {
+        if (decl->is<InitExpr>()) {
+            InitExpr vars;
+            for (const auto &var : decl->as<InitExpr>()) {
+                if (var->as<Variable>().m_storage == StorageSpec::TYPEDEF) {
+                    typedefOf(var->as<Variable>());
+                } else {
+                    vars.push_back(var);
+                }
+            }
+            if (!vars.empty()) roots.push_back(&rests.emplace_back(std::move(vars)));
+        } else if (decl->is<FuncProto>() && decl->as<FuncProto>().m_storage == TYPEDEF) {
+            typedefOf(decl->as<FuncProto>());
+        } else {
+            roots.push_back(decl);
+        }
+    }
+    std::string ast = CompactAST{roots}.serialize();
+    for (const auto &[name, type] : m_typedefs) {
+        TypeRecord record{
+            .function = type.function,
+            .name = string(name),
+            .type = string(type.type),
+            .params = static_cast<uint32_t>(m_params.size()),
+            .n_params = static_cast<uint32_t>(type.params.size()),
+        };
+        for (size_t i = 0; i < type.params.size(); ++i) {
+            m_params.push_back(string(type.params[i]));
+            m_params.push_back(string(type.param_names[i]));
+        }
+        m_types.push_back(record);
+    }
+    for (const auto &macro : macros) m_macros.push_back(string(macro));
+
+    Header header{.magic = pch_magic, .version = pch_version, .counts{}};
+    header.counts[Ast] = ast.size();
+    header.counts[Files] = m_files.size();
+    header.counts[Strings] = m_strings.size();
+    header.counts[Params] = m_params.size();
+    header.counts[Types] = m_types.size();
+    header.counts[Macros] = m_macros.size();
+    header.counts[StringBytes] = m_string_bytes.size();
+
+    // written aside and renamed, so that compilations reading the old file never see half of it
+    std::string tmp_path = path + ".tmp";
+    {
+        std::error_code ec;
+        llvm::raw_fd_ostream out(tmp_path, ec);
+        if (ec) throw_err<std::runtime_error>("cannot write '{}': {}", tmp_path, ec.message());
+        auto section = [&out](const auto &records) {
+            out.write(reinterpret_cast<const char *>(records.data()),
+                      records.size() * sizeof(records[0]));
+        };
+        out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        section(ast);
+        section(m_files);
+        section(m_strings);
+        section(m_params);
+        section(m_types);
+        section(m_macros);
+        section(m_string_bytes);
+        if (out.has_error()) {
+            throw_err<std::runtime_error>("cannot write '{}': {}", tmp_path, out.error().message());
+        }
+    }
+    fs::rename(tmp_path, path);
+}
+
+uint32_t Writer::string(std::string_view text) {
+    if (auto it = m_string_index.find(text); it != m_string_index.end()) return it->second;
+
+    uint32_t index = m_strings.size();
+    m_strings.push_back(StringRecord{.offset = static_cast<uint32_t>(m_string_bytes.size()),
+                                     .size = static_cast<uint32_t>(text.size())});
+    m_string_bytes += text;
+    m_string_index.emplace(m_owned.emplace_back(text), index);
+    return index;
+}
+
+void Writer::typedefOf(Variable const &var) {
+    m_typedefs.insert_or_assign(std::string{var.m_var_name.str()}, resolve(var.m_var_type));
+}
+
+void Writer::typedefOf(FuncProto const &proto) {
+    ResolvedType type{.function = true, .type = {}, .params = {}, .param_names = {}};
+    auto ret = resolve(proto.m_return_type);
+    if (ret.function) {
+        throw_err<std::runtime_error>("function '{}' returns a function", proto.m_name);
+    }
+    type.type = ret.type;
+    for (const auto &param : proto.m_para_list) {
+        auto param_type = resolve(param->as<Variable>().m_var_type);
+        if (param_type.function) {
+            throw_err<std::runtime_error>("parameter of function type in '{}'", proto.m_name);
+        }
+        type.params.push_back(param_type.type);
+        type.param_names.emplace_back(param->as<Variable>().m_var_name.str());
+    }
+    m_typedefs.insert_or_assign(std::string{proto.m_name.str()}, std::move(type));
+}
+
+ResolvedType Writer::resolve(Symbol name) const {
+    if (auto it = m_typedefs.find(name.str()); it != m_typedefs.end()) return it->second;
+    if (std::find(builtin_types.begin(), builtin_types.end(), name) == builtin_types.end()) {
+        throw_err<std::runtime_error>("Unknown type name '{}'", name);
+    }
+    return ResolvedType{
+        .function = false,
+        .type = std::string{name.str()},
+        .params = {},
+        .param_names = {},
+    };
+}
+
+} // namespace
+
+// ------------ Implementation of `PrecompiledHeader` -------------------
+
+PrecompiledHeader::PrecompiledHeader(std::unique_ptr<llvm::MemoryBuffer> buffer)
+    : m_buffer(std::move(buffer)) {}
+
+PrecompiledHeader::~PrecompiledHeader() = default;
+
+std::unique_ptr<PrecompiledHeader> PrecompiledHeader::load(std::string const &path) {
+    auto file = llvm::MemoryBuffer::getFile(path, false, false);
+    if (!file) {
+        throw_err<std::runtime_error>("cannot read precompiled header '{}': {}",
+                                      path,
+                                      file.getError().message());
+    }
+    std::unique_ptr<PrecompiledHeader> pch{new PrecompiledHeader(std::move(*file))};
+    auto bytes = pch->bytes();
+
+    Header header;
+    if (bytes.size() < sizeof(header)) {
+        throw_err<std::runtime_error>("'{}' is not a precompiled header", path);
+    }
+    std::memcpy(&header, bytes.data(), sizeof(header));
+    if (header.magic != pch_magic) {
+        throw_err<std::runtime_error>("'{}' is not a precompiled header", path);
+    }
+    if (header.version != pch_version) {
+        throw_err<std::runtime_error>("precompiled header '{}' is of another version of tinycc",
+                                      path);
+    }
+
+    size_t offset = sizeof(header);
+    for (int section = 0; section < n_sections; ++section) {
+        pch->m_sections.push_back(offset);
+        offset += size_t{header.counts[section]} * record_size[section];
+    }
+    pch->m_sections.push_back(offset);
+    if (offset != bytes.size()) {
+        throw_err<std::runtime_error>("corrupt precompiled header '{}'", path);
+    }
+
+    // like a header that changed, a stale PCH would silently compile old declarations
+    for (uint32_t i = 0; i < header.counts[Files]; ++i) {
+        auto record = pch->record<FileRecord>(Files, i);
+        fs::path source{pch->string(record.path)};
+        std::error_code ec;
+        if (fs::file_size(source, ec) != record.size || ec ||
+            fs::last_write_time(source, ec).time_since_epoch().count() != record.mtime || ec) {
+            throw_err<std::runtime_error>("precompiled header '{}' is out of date, '{}' changed",
+                                          path,
+                                          source.native());
+        }
+    }
+
+    pch->m_ast = CompactAST::view(
+        bytes.substr(pch->m_sections[Ast], pch->m_sections[Ast + 1] - pch->m_sections[Ast]), path);
+    return pch;
+}
+
+void PrecompiledHeader::write(std::string const &path, std::vector<Expr *> const &decls,
+                              std::vector<std::string> const &macros,
+                              std::vector<fs::path> const &files) {
+    Writer{}.write(path, decls, macros, files);
+}
+
+std::string_view PrecompiledHeader::bytes() const {
+    return {m_buffer->getBufferStart(), m_buffer->getBufferSize()};
+}
+
+template <typename T>
+T PrecompiledHeader::record(size_t section, uint32_t index) const {
+    assert(sizeof(T) == record_size[section]);
+    if (index >= (m_sections[section + 1] - m_sections[section]) / sizeof(T)) {
+        throw_err<std::runtime_error>("corrupt precompiled header '{}'",
+                                      m_buffer->getBufferIdentifier().str());
+    }
+    T ret;
+    std::memcpy(&ret, m_buffer->getBufferStart() + m_sections[section] + index * sizeof(T),
+                sizeof(T));
+    return ret;
+}
+
+std::string_view PrecompiledHeader::string(uint32_t index) const {
+    auto str = record<StringRecord>(Strings, index);
+    size_t bytes_size = m_sections[StringBytes + 1] - m_sections[StringBytes];
+    if (str.offset > bytes_size || str.size > bytes_size - str.offset) {
+        throw_err<std::runtime_error>("corrupt precompiled header '{}'",
+                                      m_buffer->getBufferIdentifier().str());
+    }
+    return {m_buffer->getBufferStart() + m_sections[StringBytes] + str.offset, str.size};
+}
+
+std::vector<std::string_view> PrecompiledHeader::macros() const {
+    size_t count = (m_sections[Macros + 1] - m_sections[Macros]) / sizeof(uint32_t);
+    std::vector<std::string_view> ret;
+    ret.reserve(count);
+    for (uint32_t i = 0; i < count; ++i) ret.push_back(string(record<uint32_t>(Macros, i)));
+    return ret;
+}
+
+std::vector<Expr *> PrecompiledHeader::decls(ASTArena &arena) const {
+    auto str = [this](uint32_t index) { return std::string{string(index)}; };
+    std::vector<Expr *> ret;
+
+    // the type table, as typedefs of builtin types
+    InitExpr aliases;
+    size_t n_types = (m_sections[Types + 1] - m_sections[Types]) / sizeof(TypeRecord);
+    for (uint32_t i = 0; i < n_types; ++i) {
+        auto type = record<TypeRecord>(Types, i);
+        if (!type.function) {
+            aliases.push_back(arena.make(Variable{
+                .m_var_type = str(type.type),
+                .m_storage = TYPEDEF,
+                .m_var_name = str(type.name),
+                .m_var_init = nullptr,
+            }));
+            continue;
+        }
+        std::vector<Expr *> params;
+        for (uint32_t k = 0; k < type.n_params; ++k) {
+            params.push_back(arena.make(Variable{
+                .m_var_type = str(record<uint32_t>(Params, type.params + 2 * k)),
+                .m_storage = NONE,
+                .m_var_name = str(record<uint32_t>(Params, type.params + 2 * k + 1)),
+                .m_var_init = nullptr,
+            }));
+        }
+        ret.push_back(arena.make(FuncProto{
+            .m_storage = TYPEDEF,
+            .m_name = str(type.name),
+            .m_para_list = std::move(params),
+            .m_return_type = str(type.type),
+        }));
+    }
+    if (!aliases.empty()) ret.insert(ret.begin(), arena.make(std::move(aliases)));
+
+    auto decls = m_ast.expand(arena);
+    ret.insert(ret.end(), decls.begin(), decls.end());
+    return ret;
+}
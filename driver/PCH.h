@@ -0,0 +1,62 @@
+#pragma once
+
+#include "AST.hpp"
+#include "ASTArena.h"
+#include "CompactAST.h"
+
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace llvm {
+class MemoryBuffer;
+}
+
+/**
+ * Precompiled header: the declarations of a header and the macros it leaves defined, written by
+ * `tinycc --emit-pch common.h` and read back with `-include-pch=common.pch`, so that translation
+ * units don't preprocess and parse the header again.
+ *
+ * The file is a fixed layout of little records, indices instead of pointers, which is mapped and
+ * read in place. The declarations are a `CompactAST`, checked once when the file is loaded and
+ * expanded in full by `decls` for every translation unit. Typedefs aren't stored as nodes but as a table of type names resolved down
+ * to builtin types, which end up in `TypeTable` before any other declaration.
+ *
+ * It also keeps the size and modification time of every header it was built from, loading it
+ * fails once one of them changes.
+ */
+class PrecompiledHeader {
+public:
+    ~PrecompiledHeader();
+
+    /// map the PCH at `path`, throws if it isn't one or is out of date
+    static std::unique_ptr<PrecompiledHeader> load(std::string const &path);
+
+    /// serialize the `decls` of a header and the `macros` defined after it into `path`, `files`
+    /// are the header and those it includes. Throws if a typedef names an unknown type
+    static void write(std::string const &path, std::vector<Expr *> const &decls,
+                      std::vector<std::string> const &macros,
+                      std::vector<fs::path> const &files);
+
+    /// a fresh copy of the declarations in `arena`, typedefs first
+    [[nodiscard]] std::vector<Expr *> decls(ASTArena &arena) const;
+    /// macro definitions, as for `Preprocessor::defineMacro`
+    [[nodiscard]] std::vector<std::string_view> macros() const;
+    /// content of the file, e.g. for cache keys
+    [[nodiscard]] std::string_view bytes() const;
+
+private:
+    explicit PrecompiledHeader(std::unique_ptr<llvm::MemoryBuffer> buffer);
+
+    template <typename T>
+    [[nodiscard]] T record(size_t section, uint32_t index) const;
+    [[nodiscard]] std::string_view string(uint32_t index) const;
+
+    std::unique_ptr<llvm::MemoryBuffer> m_buffer;
+    std::vector<size_t> m_sections; // offsets of the sections in `m_buffer`
+    CompactAST m_ast;               // viewed in `m_buffer`
+};
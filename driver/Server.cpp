@@ -0,0 +1,122 @@
+#include "Server.h"
+#include "utility.hpp"
+
+#include "llvm/Support/Allocator.h"
+#include "llvm/Support/StringSaver.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+
+using namespace llvm;
+
+static bool sendAll(int fd, StringRef data) {
+    while (!data.empty()) {
+        ssize_t n = ::send(fd, data.data(), data.size(), MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        data = data.drop_front(n);
+    }
+    return true;
+}
+
+/// read until `stop_at_newline` finds a line end, or the peer shuts down its write side
+static void recvInto(int fd, std::string &buf, bool stop_at_newline) {
+    char chunk[4096];
+    while (!stop_at_newline || buf.find('\n') == std::string::npos) {
+        ssize_t n = ::recv(fd, chunk, sizeof(chunk), 0);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return;
+        buf.append(chunk, n);
+    }
+}
+
+static void handleJob(int conn, OptHandler &cli, DriverSession &session) {
+    std::string buf;
+    recvInto(conn, buf, true);
+
+    auto newline = buf.find('\n');
+    std::string header = buf.substr(0, newline);
+    std::string source = newline == std::string::npos ? "" : buf.substr(newline + 1);
+
+    std::string diag_buf;
+    raw_string_ostream diag(diag_buf);
+    int exit_code = 1;
+
+    BumpPtrAllocator alloc;
+    StringSaver saver(alloc);
+    SmallVector<const char *> argv{session.exe_path.c_str()};
+    cl::TokenizeGNUCommandLine(header, saver, argv);
+
+    // options are process-wide, reset whatever the previous job has set
+    cl::ResetAllOptionOccurrences();
+    int argc = static_cast<int>(argv.size());
+    bool parsed = cl::ParseCommandLineOptions(argc, argv.data(), "", &diag);
+    if (parsed && (cli.run || cli.tiered)) {
+        // the program would run inside the server, on its stdin and stdout, and an `exit()` or a
+        // crash would take the server down for all later clients
+        diag << "error: --run and --tiered can't be used with a --serve server\n";
+    } else if (parsed) {
+        bool from_stdin = llvm::is_contained(cli.input_filenames, "-");
+        if (from_stdin) recvInto(conn, source, false);
+
+        try {
+            exit_code = runDriver(cli, session, diag, from_stdin ? &source : nullptr);
+        } catch (std::exception const &e) {
+            diag << fmt::format("error: {}\n", e.what());
+        }
+    }
+
+    diag << fmt::format("exit {}\n", exit_code);
+    sendAll(conn, diag.str());
+}
+
+int serve(OptHandler &cli, DriverSession &session) {
+    std::string socket_path = cli.serve_socket;
+
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    if (socket_path.size() >= sizeof(addr.sun_path)) {
+        fmt::print(stderr, "error: socket path '{}' is too long\n", socket_path);
+        return 1;
+    }
+    std::strcpy(addr.sun_path, socket_path.c_str());
+
+    int listen_fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listen_fd < 0) {
+        fmt::print(stderr, "error: failed to create socket: {}\n", std::strerror(errno));
+        return 1;
+    }
+
+    ::unlink(socket_path.c_str()); // stale socket from a previous server
+    if (::bind(listen_fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) < 0 ||
+        ::listen(listen_fd, SOMAXCONN) < 0) {
+        fmt::print(stderr,
+                   "error: failed to listen on '{}': {}\n",
+                   socket_path,
+                   std::strerror(errno));
+        ::close(listen_fd);
+        return 1;
+    }
+
+    dbg_print("[DEBUG] serving on {}\n", socket_path);
+
+    for (;;) {
+        int conn = ::accept(listen_fd, nullptr, nullptr);
+        if (conn < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) continue;
+            fmt::print(stderr, "error: accept failed: {}\n", std::strerror(errno));
+            break;
+        }
+        handleJob(conn, cli, session);
+        ::close(conn);
+    }
+
+    ::close(listen_fd);
+    ::unlink(socket_path.c_str());
+    return 1;
+}
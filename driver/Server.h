@@ -0,0 +1,18 @@
+#pragma once
+
+#include "Driver.h"
+
+/**
+ * Compile server: listen on a Unix socket and run compile jobs in this process, so LLVM targets,
+ * `TargetMachine`s and pass pipelines stay warm across jobs.
+ *
+ * @protocol:
+ * client -> server: one line of command line arguments, e.g. `-O=2 -o=/tmp/a /tmp/a.c`.
+ *                   If one of the inputs is `-`, everything after the line until the client
+ *                   shuts down its write side is the source code of that input.
+ * server -> client: diagnostics, then a last line `exit <code>`.
+ *
+ * Jobs are served one at a time (`-j` still applies inside a job). Relative paths are resolved
+ * against the working directory of the server.
+ */
+int serve(OptHandler &cli, DriverSession &session);
@@ -0,0 +1,204 @@
+// checks of `IncrementalParser` and `EditSession`, run by ctest:
+//   testEditSession <sources...>
+// random edits of each source are parsed incrementally and compared with a parse of the whole
+// source, then scripted edits check the functions `IRGenerator::updateFunctions` regenerates
+// in place against a module generated anew
+
+#include "ASTPrinter.h"
+#include "EditSession.h"
+#include "FastLexer.h"
+#include "FastParser.h"
+#include "IRGenerator.h"
+#include "Trace.h"
+
+#include <algorithm>
+#include <fstream>
+#include <map>
+#include <optional>
+#include <random>
+#include <regex>
+#include <sstream>
+#include <string>
+#include <vector>
+
+/// all of `decls`, as the graphs `--emit-ast` draws
+static std::string dump(std::vector<Expr *> const &decls) {
+    std::string out;
+    for (const auto *decl : decls) out += ASTPrinter{decl}.ToDot();
+    return out;
+}
+
+/// `dump` of `source` parsed as a whole, nothing if it doesn't parse
+static std::optional<std::string> parseWhole(std::string const &source) {
+    try {
+        ASTArena arena;
+        return dump(FastParser{source, FastLexer{source}.lex(), arena}.parse());
+    } catch (std::exception const &) {
+        return std::nullopt;
+    }
+}
+
+/// apply random edits to `source` one by one, the incremental parse must always agree with a
+/// parse of the whole source: same declarations, or an error for both
+static bool randomEdits(std::string const &name, std::string const &source, unsigned seed) {
+    static const std::vector<std::string> pieces{
+        "",  ";", "}", "{", "/*", "*/", "int x;", "a", " ", "\n", "1", "int f(){return 0;}",
+        "(", ")", "=", "\"", "//",
+    };
+    std::mt19937 rng{seed};
+    IncrementalParser parser{source, name};
+    try {
+        parser.parse();
+    } catch (std::exception const &) {
+    }
+
+    for (int i = 0; i < 2000; ++i) {
+        std::string expected = parser.source();
+        size_t offset = rng() % (expected.size() + 1);
+        size_t length = rng() % 3 == 0 ? std::min<size_t>(rng() % 8, expected.size() - offset) : 0;
+        TextEdit edit{offset, length, pieces[rng() % pieces.size()]};
+        expected.replace(offset, length, edit.text);
+
+        auto whole = parseWhole(expected);
+        bool parsed = true;
+        try {
+            parser.edit(edit);
+        } catch (std::exception const &) {
+            parsed = false;
+        }
+        if (parser.source() != expected || parsed != whole.has_value() ||
+            (parsed && dump(parser.decls()) != *whole)) {
+            fmt::print(stderr, "{}: edit {} (seed {}) isn't parsed as the whole source:\n{}\n",
+                       name, i, seed, expected);
+            return false;
+        }
+
+        // keep the source mostly valid
+        if (!parsed && rng() % 2) parser.edit(TextEdit{0, parser.source().size(), source});
+    }
+    return true;
+}
+
+/// `entity` with its local values renamed in order of appearance. a function regenerated in place
+/// keeps counting from the names of its old body, `%x1` may be `%x4`
+static std::string renameLocals(std::string const &entity) {
+    static const std::regex local{R"(%[-a-zA-Z$._0-9]+)"};
+    std::map<std::string, std::string> names;
+    std::string out;
+    auto last = entity.cbegin();
+    for (std::sregex_iterator it{entity.begin(), entity.end(), local}, end; it != end; ++it) {
+        out.append(last, (*it)[0].first);
+        auto [name, inserted] = names.try_emplace(it->str(), fmt::format("%{}", names.size()));
+        out += name->second;
+        last = (*it)[0].second;
+    }
+    out.append(last, entity.cend());
+    return out;
+}
+
+/// top level entities of the IR of `generator`, sorted: functions updated in place may move
+static std::vector<std::string> entities(IRGenerator &generator) {
+    std::vector<std::string> out;
+    std::istringstream ir{generator.dumpIRString()};
+    std::string line, entity;
+    while (std::getline(ir, line)) {
+        if (line.starts_with("; ModuleID")) continue;
+        if (line.empty()) {
+            if (!entity.empty()) out.push_back(renameLocals(entity));
+            entity.clear();
+        } else {
+            entity += line + "\n";
+        }
+    }
+    if (!entity.empty()) out.push_back(renameLocals(entity));
+    std::sort(out.begin(), out.end());
+    return out;
+}
+
+/// apply `edit` to `session`, which must regenerate only the changed functions if `in_place`,
+/// and end up with the module generated anew from its source
+static bool checkEdit(EditSession &session, IRToolchain &toolchain, std::string_view what,
+                      std::string_view from, std::string_view to, bool in_place) {
+    auto offset = session.source().find(from);
+    if (offset == std::string::npos) {
+        fmt::print(stderr, "{}: '{}' isn't in the source\n", what, from);
+        return false;
+    }
+
+    trace::start(false, true);
+    session.edit(TextEdit{offset, from.size(), std::string{to}});
+    bool regenerated = trace::report.entries.count("SimplifyAST") &&
+                       trace::report.entries["SimplifyAST"].count > 0;
+    trace::report.enabled = false;
+
+    if (regenerated == in_place) {
+        fmt::print(stderr, "{}: the module was {}generated anew\n", what, in_place ? "" : "not ");
+        return false;
+    }
+
+    ASTArena arena;
+    auto decls = FastParser{session.source(), FastLexer{session.source()}.lex(), arena}.parse();
+    IRGenerator fresh{ASTSnapshot{{decls.begin(), decls.end()}, {}}, toolchain};
+    fresh.codegen(false);
+    if (entities(*session.ir()) != entities(fresh)) {
+        fmt::print(stderr, "{}: IR differs from a fresh module:\n{}\nexpected:\n{}\n", what,
+                   session.ir()->dumpIRString(), fresh.dumpIRString());
+        return false;
+    }
+    return true;
+}
+
+static bool functionUpdates(IRToolchain &toolchain) {
+    EditSession session{R"(extern void output_int(int num);
+
+int square(int x) {
+    return x * x;
+}
+
+int twice(int x) {
+    return x + x;
+}
+
+int main() {
+    output_int(square(3) + twice(4));
+    return 0;
+}
+)",
+                        "edits.c", toolchain};
+    session.update();
+
+    // a function is renamed or changed before anything calls it, calls of the old one wouldn't build
+    return checkEdit(session, toolchain, "body edit", "return x * x;", "return x * x * x;", true) &&
+           checkEdit(session, toolchain, "argument rename", "int twice(int x) {\n    return x + x;",
+                     "int twice(int y) {\n    return y + y;", true) &&
+           checkEdit(session, toolchain, "new function", "int main() {",
+                     "int half(int x) {\n    return x / 2;\n}\n\nint main() {", true) &&
+           checkEdit(session, toolchain, "function rename", "int half(int x)", "int halve(int x)",
+                     false) &&
+           checkEdit(session, toolchain, "signature change", "int halve(int x)",
+                     "int halve(int x, int y)", false) &&
+           checkEdit(session, toolchain, "new call", "twice(4))", "halve(twice(4), 1))", true);
+}
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        fmt::print(stderr, "usage: testEditSession <sources...>\n");
+        return 1;
+    }
+
+    bool success = true;
+    for (int i = 1; i < argc; ++i) {
+        std::stringstream buffer;
+        buffer << std::ifstream{argv[i]}.rdbuf();
+        for (unsigned seed = 1; seed <= 3; ++seed) {
+            success = randomEdits(argv[i], buffer.str(), seed) && success;
+        }
+    }
+
+    IRToolchain::initializeTargets();
+    IRToolchain toolchain{CompileOptions{}};
+    success = functionUpdates(toolchain) && success;
+
+    fmt::print("{}\n", success ? "passed" : "FAILED");
+    return success ? 0 : 1;
+}
@@ -0,0 +1,13 @@
+#ifndef MYSTDLIB_H
+#define MYSTDLIB_H
+
+/**
+ * declarations of the simple std lib for tinycc, see std.c
+ */
+
+extern int input_int();
+extern void output_int(int num);
+extern void output_char(char ch);
+extern void output_fp(double f);
+
+#endif
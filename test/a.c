@@ -1,4 +1,4 @@
-// #include <stdio.h>
+#include <mystdlib.h>
 
 int x = 3, y = 4;
 
@@ -17,9 +17,6 @@ int fib(int n) {
 
 int gcd(int a, int b);
 
-extern void output_int(int num);
-extern void output_fp(double num);
-
 typedef int aaa;
 
 static int bar(int i, int j);
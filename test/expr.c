@@ -0,0 +1,34 @@
+// expression heavy: precedence, nesting and long operator chains, for the parsers' `--time-report`
+
+extern void output_int(int num);
+
+int poly(int x) {
+    return ((x * x * x + 3 * x * x - 7 * x + 11) % 1000 - (x / 3 + x % 5) * (x - 1)) / 2;
+}
+
+int mix(int a, int b, int c) {
+    int r = 0;
+    r = a * b + b * c - c * a + (a + b) * (b + c) * (c + a) / (1 + a * a + b * b + c * c);
+    r = r + (a - b) * (a - b) + (b - c) * (b - c) - (c - a) * (c - a) % 7;
+    r = r - ((((a + 1) * 2 + 3) * 4 + 5) * 6 + 7) / (((b + 1) * 2 + 3) * 4 + 5);
+    return r;
+}
+
+int cond(int a, int b) {
+    if ((a < b && b < 100) || (a > 1000 && b != 0) || a == b) {
+        return 1;
+    }
+    if (a * 2 + 1 >= b - 3 && a - b <= 10 && a != 0) {
+        return 2;
+    }
+    return 3;
+}
+
+int main() {
+    int acc = 0;
+    for (int i = 0; i < 50; i = i + 1) {
+        acc = acc + poly(i) - mix(i, i + 1, i * 2) + cond(i, 50 - i) * (i % 3 + 1);
+    }
+    output_int(acc); // -80995
+    return 0;
+}
@@ -0,0 +1,21 @@
+// static functions of two units that share names, with each other and with an external one:
+// tinycc --codegen-threads=4 test/static_a.c test/static_b.c must link them all apart
+
+extern void output_int(int num);
+
+int twice(int num); // in static_b.c
+
+static int helper(int num) {
+    return num + 1;
+}
+
+int scale(int num) {
+    return num * 10;
+}
+
+int main() {
+    output_int(helper(1)); // 2
+    output_int(twice(3));  // 10
+    output_int(scale(2));  // 20
+    return 0;
+}
@@ -0,0 +1,13 @@
+// see static_a.c
+
+static int helper(int num) {
+    return num + 2;
+}
+
+static int scale(int num) {
+    return num * 2;
+}
+
+int twice(int num) {
+    return scale(helper(num));
+}
@@ -0,0 +1,145 @@
+#pragma once
+
+#include "Trace.h"
+
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/Support/Program.h"
+
+#include <fmt/core.h>
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * Renders Graphviz graphs to PNG in the background, for `--emit-ast` and `--emit-cfg`.
+ * A few workers take queued graphs in batches and run one `dot` process per batch, callers only
+ * pay for building the DOT text.
+ */
+class GraphRenderer {
+public:
+    static constexpr size_t batch_size = 16;
+    static constexpr unsigned max_workers = 4;
+
+    static GraphRenderer &instance() {
+        static GraphRenderer renderer;
+        return renderer;
+    }
+
+    GraphRenderer(GraphRenderer const &) = delete;
+    GraphRenderer &operator=(GraphRenderer const &) = delete;
+
+    ~GraphRenderer() {
+        {
+            std::lock_guard lock{m_mutex};
+            m_stopping = true;
+        }
+        m_wakeup.notify_all();
+        for (auto &worker : m_workers) worker.join(); // finishes the queue first
+    }
+
+    /// render `dot` into `png_path` some time later
+    void submit(std::string dot, std::filesystem::path png_path) {
+        {
+            std::lock_guard lock{m_mutex};
+            if (m_workers.empty()) {
+                auto n_workers = std::clamp(std::thread::hardware_concurrency(), 1u, max_workers);
+                for (unsigned i = 0; i < n_workers; ++i) m_workers.emplace_back([this] { work(); });
+            }
+            m_queue.push_back(Graph{std::move(dot), std::move(png_path)});
+            ++m_pending;
+        }
+        m_wakeup.notify_one();
+    }
+
+    /// block until everything submitted so far is rendered
+    void wait() {
+        std::unique_lock lock{m_mutex};
+        m_done.wait(lock, [this] { return m_pending == 0; });
+    }
+
+private:
+    struct Graph {
+        std::string dot;
+        std::filesystem::path png_path;
+    };
+
+    GraphRenderer() = default;
+
+    void work() {
+        std::unique_lock lock{m_mutex};
+        while (true) {
+            m_wakeup.wait(lock, [this] { return m_stopping || !m_queue.empty(); });
+            if (m_queue.empty()) return;
+
+            std::vector<Graph> batch;
+            while (!m_queue.empty() && batch.size() < batch_size) {
+                batch.push_back(std::move(m_queue.front()));
+                m_queue.pop_front();
+            }
+
+            lock.unlock();
+            {
+                // a profile per batch: workers outlive `trace::finish`, which only collects the
+                // profiles of threads that are done with them
+                trace::ThreadScope thread_trace;
+                render(batch);
+            }
+            lock.lock();
+
+            m_pending -= batch.size();
+            if (m_pending == 0) m_done.notify_all();
+        }
+    }
+
+    /// `dot -Tpng -O` writes `<input>.png` next to each input, they are moved into place afterwards
+    static void render(std::vector<Graph> const &batch) {
+        trace::Scope span{"RenderGraphs", fmt::format("{} graphs", batch.size())};
+        static const auto dot_exe = llvm::sys::findProgramByName("dot");
+        if (!dot_exe) {
+            fmt::print(stderr, "error: cannot find `dot`, no graph is rendered\n");
+            return;
+        }
+
+        std::vector<std::string> dot_paths;
+        for (const auto &graph : batch) {
+            auto dot_path = std::filesystem::path{graph.png_path}.replace_extension(".dot");
+            std::ofstream{dot_path} << graph.dot;
+            dot_paths.push_back(dot_path.native());
+        }
+
+        llvm::SmallVector<llvm::StringRef, batch_size + 3> args{*dot_exe, "-Tpng", "-O"};
+        args.append(dot_paths.begin(), dot_paths.end());
+        std::string err_msg;
+        if (llvm::sys::ExecuteAndWait(*dot_exe, args, llvm::None, {}, 0, 0, &err_msg) != 0) {
+            fmt::print(stderr, "error: `dot` failed on {}: {}\n", dot_paths.front(), err_msg);
+        }
+
+        for (size_t i = 0; i < batch.size(); ++i) {
+            std::error_code ec;
+            std::filesystem::rename(dot_paths[i] + ".png", batch[i].png_path, ec);
+            if (ec) {
+                fmt::print(stderr,
+                           "error: cannot move the rendering of {} to {}: {}\n",
+                           dot_paths[i],
+                           batch[i].png_path.native(),
+                           ec.message());
+            }
+            std::filesystem::remove(dot_paths[i], ec);
+        }
+    }
+
+    std::mutex m_mutex;
+    std::condition_variable m_wakeup;
+    std::condition_variable m_done;
+    std::deque<Graph> m_queue;
+    size_t m_pending = 0; // queued or being rendered
+    bool m_stopping = false;
+    std::vector<std::thread> m_workers;
+};
@@ -2,6 +2,10 @@
 
 #include "llvm/Support/CommandLine.h"
 
+#include <filesystem>
+#include <string>
+#include <vector>
+
 // hack to shut up unwanted options in --help
 struct SilentDefaultOpts {
     SilentDefaultOpts() {
@@ -10,6 +14,30 @@ struct SilentDefaultOpts {
     }
 };
 
+enum class LTOKind { None, Thin };
+enum class LexerKind { ANTLR, Fast };
+enum class ParserKind { ANTLR, Fast };
+
+// plain snapshot of the options a single compilation depends on,
+// cheap to copy and safe to read from worker threads
+struct CompileOptions {
+    int opt_level = 0;
+    bool emitAST = false;
+    bool emitCFG = false;
+    bool debugSExpr = false;
+    bool thinLTO = false; // emit bitcode with summaries instead of objects, optimized at link time
+    unsigned codegen_threads = 1;
+    LexerKind lexer = LexerKind::ANTLR;
+    ParserKind parser = ParserKind::ANTLR; // `Fast` lexes with `FastLexer` whatever `lexer` is
+    bool verifyLexer = false; // check `FastLexer` tokens against `CLexer`
+    bool sllParse = false;    // `CParser` tries SLL prediction before full LL
+    std::vector<std::string> include_dirs; // searched by `#include`, in order
+    std::vector<std::string> defines;      // `NAME` or `NAME=VALUE`
+    std::string include_pch;               // `.pch` whose declarations come before the source
+    bool fromASTBin = false;               // inputs are ASTs saved by `--emit-ast-bin`
+    std::string pic_outdir = "output";
+};
+
 // you should never alloc this huge object on stack...
 struct OptHandler : SilentDefaultOpts {
     llvm::cl::opt<int> opt_level{
@@ -18,9 +46,9 @@ struct OptHandler : SilentDefaultOpts {
         llvm::cl::init(0),
     };
 
-    llvm::cl::opt<std::string> input_filename{
-        llvm::cl::Positional, llvm::cl::desc("<input file>"),
-        // llvm::cl::init("-"),
+    llvm::cl::list<std::string> input_filenames{
+        llvm::cl::Positional,
+        llvm::cl::desc("<input files>"),
     };
 
     llvm::cl::opt<std::string> output_filename{
@@ -72,4 +100,186 @@ struct OptHandler : SilentDefaultOpts {
         llvm::cl::value_desc("version"),
         llvm::cl::init("12.1.0"),
     };
+
+    llvm::cl::opt<unsigned> jobs{
+        "j",
+        llvm::cl::desc("Number of files compiled in parallel, default to number of cores"),
+        llvm::cl::value_desc("N"),
+        llvm::cl::init(0),
+    };
+
+    llvm::cl::opt<unsigned> codegen_threads{
+        "codegen-threads",
+        llvm::cl::desc("Split each file into N partitions compiled to machine code in parallel"),
+        llvm::cl::value_desc("N"),
+        llvm::cl::init(1),
+    };
+
+    llvm::cl::opt<std::string> serve_socket{
+        "serve",
+        llvm::cl::desc("Run as a compile server listening on the given Unix socket"),
+        llvm::cl::value_desc("socket"),
+    };
+
+    llvm::cl::opt<std::string> cache_dir{
+        "cache-dir",
+        llvm::cl::desc("Reuse `.ll` and `.o` of identical compilations cached in this directory"),
+        llvm::cl::value_desc("dirname"),
+    };
+
+    llvm::cl::opt<unsigned> cache_size{
+        "cache-size",
+        llvm::cl::desc("Size limit of the compile cache in MiB, default to 256"),
+        llvm::cl::value_desc("MiB"),
+        llvm::cl::init(256),
+    };
+
+    llvm::cl::opt<bool> cache_stats{
+        "cache-stats",
+        llvm::cl::desc("Print hit/miss/eviction counters of the compile cache"),
+    };
+
+    llvm::cl::opt<std::string> trace_file{
+        "trace",
+        llvm::cl::desc("Write a Chrome/Perfetto trace of all compilation phases and passes"),
+        llvm::cl::value_desc("filename"),
+    };
+
+    llvm::cl::opt<bool> time_report{
+        "time-report",
+        llvm::cl::desc("Print time spent in each compilation phase and pass"),
+    };
+
+    llvm::cl::opt<LTOKind> lto{
+        "flto",
+        llvm::cl::desc("Enable link time optimization"),
+        llvm::cl::values(clEnumValN(LTOKind::Thin,
+                                    "thin",
+                                    "ThinLTO: bitcode objects, inlined across files when linking")),
+        llvm::cl::init(LTOKind::None),
+    };
+
+    llvm::cl::opt<LexerKind> lexer{
+        "lexer",
+        llvm::cl::desc("Choose the lexer"),
+        llvm::cl::values(
+            clEnumValN(LexerKind::ANTLR, "antlr", "CLexer generated by ANTLR (default)"),
+            clEnumValN(LexerKind::Fast, "fast", "Hand-written SIMD lexer, same tokens as CLexer")),
+        llvm::cl::init(LexerKind::ANTLR),
+    };
+
+    llvm::cl::opt<ParserKind> parser{
+        "parser",
+        llvm::cl::desc("Choose the parser"),
+        llvm::cl::values(
+            clEnumValN(ParserKind::ANTLR, "antlr", "CParser and ASTBuilder (default)"),
+            clEnumValN(ParserKind::Fast, "fast", "Hand-written parser on --lexer=fast tokens")),
+        llvm::cl::init(ParserKind::ANTLR),
+    };
+
+    llvm::cl::opt<bool> sll_parse{
+        "sll",
+        llvm::cl::desc("Parse with SLL prediction first, fall back to full LL on syntax errors"),
+    };
+
+    llvm::cl::list<std::string> parser_warmup{
+        "parser-warmup",
+        llvm::cl::desc("Parse these sources at startup to prime the parser's prediction cache"),
+        llvm::cl::value_desc("files"),
+        llvm::cl::CommaSeparated,
+    };
+
+    llvm::cl::opt<bool> verify_lexer{
+        "verify-lexer",
+        llvm::cl::desc("With --lexer=fast, fail unless CLexer produces the same tokens"),
+    };
+
+    llvm::cl::list<std::string> include_dirs{
+        "I",
+        llvm::cl::desc("Add a directory to search for #include files"),
+        llvm::cl::value_desc("dir"),
+        llvm::cl::Prefix,
+    };
+
+    llvm::cl::list<std::string> defines{
+        "D",
+        llvm::cl::desc("Define a macro, as NAME or NAME=VALUE"),
+        llvm::cl::value_desc("macro"),
+        llvm::cl::Prefix,
+    };
+
+    llvm::cl::opt<bool> emit_pch{
+        "emit-pch",
+        llvm::cl::desc("Precompile the input headers into `.pch` files for -include-pch"),
+    };
+
+    llvm::cl::opt<std::string> include_pch{
+        "include-pch",
+        llvm::cl::desc("Declarations and macros of a header precompiled with --emit-pch"),
+        llvm::cl::value_desc("file"),
+    };
+
+    llvm::cl::opt<bool> emit_ast_bin{
+        "emit-ast-bin",
+        llvm::cl::desc("Save the parsed inputs into `.ast` files for --from-ast-bin"),
+    };
+
+    llvm::cl::opt<bool> from_ast_bin{
+        "from-ast-bin",
+        llvm::cl::desc("Compile ASTs saved with --emit-ast-bin instead of sources"),
+    };
+
+    llvm::cl::opt<std::string> batch_manifest{
+        "batch",
+        llvm::cl::desc("Build every program listed in the manifest into its own executable"),
+        llvm::cl::value_desc("manifest"),
+    };
+
+    llvm::cl::opt<bool> run{
+        "run",
+        llvm::cl::desc("Execute the program in-process with a JIT instead of writing files"),
+    };
+
+    llvm::cl::opt<bool> tiered{
+        "tiered",
+        llvm::cl::desc("With --run, compile functions on first call and recompile hot ones at -O3"),
+    };
+
+    llvm::cl::opt<unsigned> tier_threshold{
+        "tier-threshold",
+        llvm::cl::desc("Calls plus loop iterations that make a function hot, default to 1000"),
+        llvm::cl::value_desc("count"),
+        llvm::cl::init(1000),
+    };
+
+    llvm::cl::opt<std::string> stdlib_path{
+        "stdlib",
+        llvm::cl::desc("Archive of mystdlib linked into programs, default to mystdlib/libmystd.a"),
+        llvm::cl::value_desc("path"),
+        llvm::cl::init("mystdlib/libmystd.a"),
+    };
+
+    [[nodiscard]] CompileOptions compileOptions() const {
+        // `#include <mystdlib.h>` finds the header next to the archive
+        std::vector<std::string> search_dirs{include_dirs.begin(), include_dirs.end()};
+        search_dirs.push_back(std::filesystem::path{stdlib_path.getValue()}.parent_path());
+
+        return CompileOptions{
+            .opt_level = opt_level,
+            .emitAST = emitAST,
+            .emitCFG = emitCFG,
+            .debugSExpr = debugSExpr,
+            .thinLTO = lto == LTOKind::Thin,
+            .codegen_threads = codegen_threads,
+            .lexer = lexer,
+            .parser = parser,
+            .verifyLexer = verify_lexer,
+            .sllParse = sll_parse,
+            .include_dirs = std::move(search_dirs),
+            .defines = {defines.begin(), defines.end()},
+            .include_pch = include_pch,
+            .fromASTBin = from_ast_bin,
+            .pic_outdir = pic_outdir,
+        };
+    }
 };
@@ -0,0 +1,147 @@
+#pragma once
+
+#include "llvm/ADT/StringMap.h"
+#include "llvm/Support/TimeProfiler.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <fmt/core.h>
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/**
+ * Compile time tracing: spans are recorded into a Chrome/Perfetto trace (`--trace`) by LLVM's
+ * time trace profiler, and summed up per span name for a plain text report (`--time-report`).
+ * The report also sums up counters, such as allocations. Both are no-ops unless enabled.
+ */
+namespace trace {
+
+using clock = std::chrono::steady_clock;
+
+struct ReportEntry {
+    uint64_t count = 0;
+    clock::duration total{};
+};
+
+struct Report {
+    std::atomic<bool> enabled = false;
+    std::mutex mutex;
+    llvm::StringMap<ReportEntry> entries;
+    llvm::StringMap<uint64_t> counters;
+
+    void add(llvm::StringRef name, clock::duration elapsed) {
+        std::lock_guard lock{mutex};
+        auto &entry = entries[name];
+        ++entry.count;
+        entry.total += elapsed;
+    }
+
+    void add(llvm::StringRef counter, uint64_t value) {
+        std::lock_guard lock{mutex};
+        counters[counter] += value;
+    }
+
+    void print(llvm::raw_ostream &os) {
+        std::lock_guard lock{mutex};
+        std::vector<std::pair<llvm::StringRef, ReportEntry>> sorted;
+        for (const auto &entry : entries) sorted.emplace_back(entry.getKey(), entry.getValue());
+        std::sort(sorted.begin(), sorted.end(), [](const auto &lhs, const auto &rhs) {
+            return lhs.second.total > rhs.second.total;
+        });
+
+        os << "===------------------- tinycc time report -------------------===\n";
+        os << fmt::format("  {:>12}  {:>7}  {}\n", "Total (ms)", "Count", "Name");
+        for (const auto &[name, entry] : sorted) {
+            double ms = std::chrono::duration<double, std::milli>(entry.total).count();
+            os << fmt::format("  {:>12.3f}  {:>7}  {}\n", ms, entry.count, name.str());
+        }
+
+        if (counters.empty()) return;
+        std::vector<std::pair<llvm::StringRef, uint64_t>> sorted_counters;
+        for (const auto &counter : counters) {
+            sorted_counters.emplace_back(counter.getKey(), counter.getValue());
+        }
+        std::sort(sorted_counters.begin(), sorted_counters.end());
+        os << fmt::format("  {:>21}  {}\n", "Total", "Counter");
+        for (const auto &[name, value] : sorted_counters) {
+            os << fmt::format("  {:>21}  {}\n", value, name.str());
+        }
+    }
+
+    void clear() {
+        std::lock_guard lock{mutex};
+        entries.clear();
+        counters.clear();
+    }
+};
+
+inline Report report;
+inline std::atomic<bool> chrome_enabled = false;
+
+/// RAII span, named after the phase or pass, with an optional detail such as the function name
+class Scope {
+public:
+    explicit Scope(llvm::StringRef name, llvm::StringRef detail = {})
+        : m_name(report.enabled ? name.str() : std::string{}), m_start(clock::now()) {
+        llvm::timeTraceProfilerBegin(name, detail); // no-op on threads not being profiled
+    }
+    ~Scope() {
+        llvm::timeTraceProfilerEnd();
+        if (!m_name.empty()) report.add(m_name, clock::now() - m_start);
+    }
+
+    Scope(Scope const &) = delete;
+    Scope &operator=(Scope const &) = delete;
+
+private:
+    std::string m_name;
+    clock::time_point m_start;
+};
+
+/// add `value` to `counter` of the report, if `--time-report` is on
+inline void count(llvm::StringRef counter, uint64_t value) {
+    if (report.enabled) report.add(counter, value);
+}
+
+/// RAII: profile the current thread for its lifetime, if `--trace` is on
+class ThreadScope {
+public:
+    ThreadScope() : m_enabled(chrome_enabled) {
+        if (m_enabled) llvm::timeTraceProfilerInitialize(0, "tinycc");
+    }
+    ~ThreadScope() {
+        if (m_enabled) llvm::timeTraceProfilerFinishThread();
+    }
+
+    ThreadScope(ThreadScope const &) = delete;
+    ThreadScope &operator=(ThreadScope const &) = delete;
+
+private:
+    bool m_enabled;
+};
+
+/// start tracing on the calling thread, which must outlive the worker threads
+inline void start(bool chrome, bool time_report) {
+    chrome_enabled = chrome;
+    report.enabled = time_report;
+    report.clear();
+    if (chrome) llvm::timeTraceProfilerInitialize(0, "tinycc");
+}
+
+/// stop tracing, write the trace to `trace_path` and the report to `os`
+inline void finish(llvm::StringRef trace_path, llvm::raw_ostream &os) {
+    if (chrome_enabled) {
+        if (auto err = llvm::timeTraceProfilerWrite(trace_path, "tinycc")) {
+            os << fmt::format("error: failed to write trace: {}\n", llvm::toString(std::move(err)));
+        }
+        llvm::timeTraceProfilerCleanup();
+    }
+    if (report.enabled) report.print(os);
+    chrome_enabled = false;
+    report.enabled = false;
+}
+
+} // namespace trace
@@ -1,5 +1,8 @@
 #pragma once
+#include <algorithm>
+#include <array>
 #include <cassert>
+#include <cstdint>
 #include <type_traits>
 #include <variant>
 
@@ -48,4 +51,19 @@ R match(const std::variant<Ts...> &u, Fs... arms) {
 template <typename R = void, typename... Ts, typename... Fs>
 R match(std::variant<Ts...> &&u, Fs... arms) {
     return impl::match_impl<R, Ts &&...>(std::move(u), arms...);
-}
\ No newline at end of file
+}
+
+/// index of the alternative `T` of `Variant`, e.g. to store it as a tag
+template <typename T, typename Variant>
+struct VariantIndex;
+
+template <typename T, typename... Ts>
+struct VariantIndex<T, std::variant<Ts...>> {
+    static constexpr uint8_t value = [] {
+        constexpr std::array same{std::is_same_v<T, Ts>...};
+        return std::find(same.begin(), same.end(), true) - same.begin();
+    }();
+};
+
+template <typename T, typename Variant>
+constexpr uint8_t variant_index = VariantIndex<T, Variant>::value;